@@ -3,13 +3,43 @@
 #include <iostream>
 #include <string>
 #include <vector>
-#include <stack>
 #include <cctype>
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <fstream>
+#include <algorithm>
 #include <filesystem>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "wumbo/engine.h"
+#include "wumbo/batch.h"
+#include "wumbo/script.h"
+#include "wumbo/fileio.h"
+#include "wumbo/compress.h"
+#include "wumbo/topology.h"
 
 namespace fs = std::filesystem;
 
+// Plugins come from $WUMBO_PLUGIN_DIR, or ~/.local/share/wumbocalculator/plugins.
+std::string pluginDir() {
+    if (const char* dir = std::getenv("WUMBO_PLUGIN_DIR")) return dir;
+    return std::string(std::getenv("HOME") ? std::getenv("HOME") : "") + "/.local/share/wumbocalculator/plugins";
+}
+
 std::string findSystemFont() {
     const std::string fontDirs[] = {
         "/usr/share/fonts",
@@ -27,103 +57,451 @@ std::string findSystemFont() {
     return "";
 }
 
-enum TokenType { NUMBER, OPERATOR, LPAREN, RPAREN };
-struct Token {
-    TokenType type;
-    double value;
-    char op;
-};
 
-std::vector<Token> tokenize(const std::string& expr) {
-    std::vector<Token> tokens;
-    size_t i = 0;
-    while (i < expr.size()) {
-        if (isspace(expr[i])) { i++; continue; }
-        if (isdigit(expr[i]) || expr[i] == '.') {
-            size_t len = 0;
-            double val = std::stod(expr.substr(i), &len);
-            tokens.push_back({NUMBER, val, 0});
-            i += len;
-        } else {
-            char c = expr[i];
-            if (c == '+' || c == '-' || c == '*' || c == '/' || c == '^') tokens.push_back({OPERATOR, 0, c});
-            else if (c == '(') tokens.push_back({LPAREN, 0, 0});
-            else if (c == ')') tokens.push_back({RPAREN, 0, 0});
-            i++;
-        }
+// Evaluates a file of expressions, one per line, on background threads and
+// streams the results to <file>.out in input order. A reader thread cuts the
+// input into line-aligned chunks, workers evaluate whole chunks, and a writer
+// thread appends finished chunks in sequence; at most maxInFlight chunks are
+// held in memory, so arbitrarily large files run in bounded space.
+// gzip or zstd input is decompressed as it is read, and a file named .gz or
+// .zst gets its results compressed the same way into <file>.out.gz or
+// <file>.out.zst, each chunk compressed by the worker that evaluated it.
+// Lines estimateCost puts over slowCost are set aside for a smaller pool of
+// low-priority threads, so a worker never sits on one while other chunks
+// wait. Given cpus, worker i is pinned to cpus[i % cpus.size()].
+class BatchJob {
+public:
+    BatchJob(const std::string& path, const wumbo::SymbolTable* symbols, unsigned workers = defaultWorkers(),
+             std::vector<int> cpus = {})
+        : inPath(path), outCodec(wumbo::codecForName(path)), symbols(symbols), cpus(std::move(cpus)) {
+        std::string ext = wumbo::codecExtension(outCodec);
+        outPath = path.substr(0, path.size() - ext.size()) + ".out" + ext;
+        std::string probe;
+        if (!wumbo::compressFrame(outCodec, "", probe)) problem = std::string("cannot write ") + wumbo::codecExtension(outCodec) + " files without its library";
+        // The output is only created, or truncated, once the input is open.
+        if (problem.empty()) in = ::open(inPath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (in >= 0) out = ::open(outPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (in < 0 || out < 0) { finished_ = true; failed_ = true; return; }
+        std::error_code ec;
+        bytesTotal = fs::file_size(inPath, ec);
+        threads.emplace_back(&BatchJob::readLoop, this);
+        threads.emplace_back(&BatchJob::writeLoop, this);
+        for (unsigned i = 0; i < workers; ++i) threads.emplace_back(&BatchJob::workLoop, this, i);
+        for (unsigned i = 0; i < std::max(1u, workers / 4); ++i) threads.emplace_back(&BatchJob::slowLoop, this);
     }
-    return tokens;
-}
 
-int precedence(char op) {
-    switch (op) {
-        case '^': return 4;
-        case '*': case '/': return 3;
-        case '+': case '-': return 2;
-        default: return 0;
+    ~BatchJob() {
+        cancel();
+        for (auto& t : threads) t.join();
+        if (in >= 0) ::close(in);
+        if (out >= 0) ::close(out);
     }
-}
 
-double applyOp(double a, double b, char op) {
-    switch (op) {
-        case '+': return a + b;
-        case '-': return a - b;
-        case '*': return a * b;
-        case '/': return b != 0 ? a / b : NAN;
-        case '^': return pow(a, b);
-        default: return NAN;
+    static unsigned defaultWorkers() {
+        unsigned n = std::thread::hardware_concurrency();
+        return n > 1 ? n - 1 : 1;
+    }
+
+    void cancel() {
+        std::lock_guard<std::mutex> lock(m);
+        cancelled = true;
+        cv.notify_all();
+    }
+
+    float progress() const { return bytesTotal ? std::min(1.0f, (float)bytesDone / bytesTotal) : (finished_ ? 1.0f : 0.0f); }
+    bool finished() const { return finished_; }
+    bool failed() const { return failed_; }
+    size_t lines() const { return linesDone; }
+    const std::string& input() const { return inPath; }
+    const std::string& output() const { return outPath; }
+    // Why a failed job failed, when known.
+    const std::string& error() const { return problem; }
+
+private:
+    static constexpr size_t chunkBytes = 1 << 20;
+    static constexpr size_t maxInFlight = 64;
+
+    // inputBytes is what the chunk took from the file, which for compressed
+    // input is not the size of its text.
+    struct Chunk {
+        size_t seq;
+        std::string text;
+        size_t inputBytes = 0;
+    };
+
+    // A chunk's lines and values; slowLeft counts lines still with the slow
+    // pool.
+    struct Evaluated {
+        size_t inputBytes = 0, slowLeft = 0;
+        std::vector<std::string> exprs;
+        std::vector<double> re, im;
+    };
+
+    struct DoneChunk {
+        size_t inputBytes = 0, lines = 0;
+        std::string text;
+    };
+
+    // The reader keeps the next chunks' reads in flight while this thread
+    // splits the last one and waits for room in the pipeline.
+    void readLoop() {
+        wumbo::DecompressingReader reader(in, chunkBytes);
+        std::string carry;
+        std::string_view block;
+        size_t seq = 0;
+        uint64_t consumed = 0;
+        while (!cancelled) {
+            if (!reader.next(block)) {
+                problem = reader.error();
+                failed_ = true;
+            }
+            if (block.empty() && carry.empty()) break;
+            std::string text = std::move(carry);
+            text.append(block);
+            carry.clear();
+            if (!block.empty()) {
+                size_t cut = text.rfind('\n');
+                if (cut == std::string::npos) { carry = std::move(text); continue; }
+                carry.assign(text, cut + 1, std::string::npos);
+                text.resize(cut + 1);
+            }
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [&] { return inFlight < maxInFlight || cancelled; });
+            pending.push_back({seq++, std::move(text), (size_t)(reader.consumed() - consumed)});
+            consumed = reader.consumed();
+            inFlight++;
+            cv.notify_all();
+        }
+        std::lock_guard<std::mutex> lock(m);
+        chunksRead = seq;
+        readDone = true;
+        cv.notify_all();
     }
-}
 
-std::vector<Token> infixToPostfix(const std::vector<Token>& tokens) {
-    std::vector<Token> output;
-    std::stack<Token> ops;
-    for (auto& t : tokens) {
-        if (t.type == NUMBER) output.push_back(t);
-        else if (t.type == OPERATOR) {
-            while (!ops.empty() && ops.top().type == OPERATOR) {
-                if ((precedence(ops.top().op) > precedence(t.op)) ||
-                    (precedence(ops.top().op) == precedence(t.op) && t.op != '^')) {
-                    output.push_back(ops.top());
-                    ops.pop();
-                } else break;
+    // Pinning only keeps a worker on its CPU; memory is not placed by NUMA
+    // node. The chunk text comes from the unpinned reader thread, and costly
+    // lines are evaluated by the unpinned slow pool, so either may be on
+    // another node than the worker.
+    void workLoop(unsigned index) {
+        if (!cpus.empty()) wumbo::pinThread(cpus[index % cpus.size()]);
+        for (;;) {
+            Chunk chunk;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                cv.wait(lock, [&] { return !pending.empty() || readDone || cancelled; });
+                if (cancelled || pending.empty()) return;
+                chunk = std::move(pending.front());
+                pending.pop_front();
+            }
+            Evaluated e;
+            e.inputBytes = chunk.inputBytes;
+            size_t pos = 0;
+            while (pos < chunk.text.size()) {
+                size_t end = chunk.text.find('\n', pos);
+                if (end == std::string::npos) end = chunk.text.size();
+                e.exprs.emplace_back(chunk.text, pos, end - pos);
+                if (!e.exprs.back().empty() && e.exprs.back().back() == '\r') e.exprs.back().pop_back();
+                pos = end + 1;
+            }
+            e.re.resize(e.exprs.size());
+            e.im.resize(e.exprs.size());
+            std::vector<size_t> slow;
+            for (size_t i = 0; i < e.exprs.size(); ++i)
+                if (wumbo::estimateCost(e.exprs[i]) > wumbo::slowCost) slow.push_back(i);
+            if (slow.empty()) wumbo::evaluateMany(e.exprs, e.re.data(), symbols, e.im.data());
+            else {
+                // The rest of the chunk is evaluated now, the costly lines
+                // by the slow pool, and the chunk finished by whichever
+                // thread evaluates its last line.
+                std::vector<size_t> fastAt;
+                std::vector<std::string> fast;
+                for (size_t i = 0, k = 0; i < e.exprs.size(); ++i) {
+                    if (k < slow.size() && slow[k] == i) k++;
+                    else {
+                        fastAt.push_back(i);
+                        fast.push_back(e.exprs[i]);
+                    }
+                }
+                std::vector<double> re(fast.size()), im(fast.size());
+                wumbo::evaluateMany(fast, re.data(), symbols, im.data());
+                for (size_t k = 0; k < fastAt.size(); ++k) {
+                    e.re[fastAt[k]] = re[k];
+                    e.im[fastAt[k]] = im[k];
+                }
+                std::lock_guard<std::mutex> lock(m);
+                e.slowLeft = slow.size();
+                waiting[chunk.seq] = std::move(e);
+                for (size_t i : slow) slowLines.push_back({chunk.seq, i});
+                cv.notify_all();
+                continue;
             }
-            ops.push(t);
-        } else if (t.type == LPAREN) ops.push(t);
-        else if (t.type == RPAREN) {
-            while (!ops.empty() && ops.top().type != LPAREN) {
-                output.push_back(ops.top());
-                ops.pop();
+            finish(chunk.seq, e);
+        }
+    }
+
+    // Evaluates the costly lines one at a time at a lower priority, so the
+    // kernel runs the workers first; chunks they finish go to the writer.
+    void slowLoop() {
+        wumbo::lowerThreadPriority();
+        wumbo::EvalBudget budget;
+        budget.progress = [this](const char*, size_t, size_t) { return !cancelled; };
+        for (;;) {
+            std::pair<size_t, size_t> line;
+            std::vector<std::string> expr;
+            Evaluated* e;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                cv.wait(lock, [&] { return !slowLines.empty() || finished_ || cancelled; });
+                if (cancelled || slowLines.empty()) return;
+                line = slowLines.front();
+                slowLines.pop_front();
+                e = &waiting[line.first];
+                expr.push_back(e->exprs[line.second]);
             }
-            if (!ops.empty() && ops.top().type == LPAREN) ops.pop();
+            wumbo::EvalResult result;
+            wumbo::BudgetGuard guard(budget, result);
+            wumbo::evaluateMany(expr, &e->re[line.second], symbols, &e->im[line.second], &guard);
+            std::unique_lock<std::mutex> lock(m);
+            if (--e->slowLeft) continue;
+            Evaluated ready = std::move(*e);
+            waiting.erase(line.first);
+            lock.unlock();
+            finish(line.first, ready);
+        }
+    }
+
+    // Formats and, for compressed output, compresses an evaluated chunk and
+    // hands it to the writer.
+    void finish(size_t seq, const Evaluated& e) {
+        std::string result;
+        size_t lines = e.exprs.size();
+        for (size_t i = 0; i < lines; ++i) {
+            wumbo::Value v(std::complex<double>(e.re[i], e.im[i]));
+            if (v.isError()) {
+                if (!e.exprs[i].empty()) result += "error";
+            } else result += wumbo::formatValue(v, 17);
+            result += '\n';
         }
+        if (outCodec != wumbo::CODEC_NONE) {
+            std::string packed;
+            if (!wumbo::compressFrame(outCodec, result, packed)) failed_ = true;
+            result = std::move(packed);
+        }
+        std::lock_guard<std::mutex> lock(m);
+        done[seq] = {e.inputBytes, lines, std::move(result)};
+        cv.notify_all();
     }
-    while (!ops.empty()) {
-        output.push_back(ops.top());
-        ops.pop();
+
+    void writeLoop() {
+        wumbo::BlockWriter writer(out);
+        for (size_t next = 0;; ++next) {
+            DoneChunk chunk;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                cv.wait(lock, [&] { return done.count(next) || (readDone && next == chunksRead) || cancelled; });
+                if (cancelled || !done.count(next)) break;
+                chunk = std::move(done[next]);
+                done.erase(next);
+            }
+            writer.write(std::move(chunk.text));
+            bytesDone += chunk.inputBytes;
+            linesDone += chunk.lines;
+            std::lock_guard<std::mutex> lock(m);
+            inFlight--;
+            cv.notify_all();
+        }
+        if (!writer.flush()) failed_ = true;
+        std::lock_guard<std::mutex> lock(m);
+        finished_ = true;
+        cv.notify_all();
     }
-    return output;
+
+    std::string inPath, outPath, problem;
+    wumbo::Codec outCodec;
+    const wumbo::SymbolTable* symbols;
+    std::vector<int> cpus;
+    int in = -1, out = -1;
+    uintmax_t bytesTotal = 0;
+    std::atomic<uintmax_t> bytesDone{0};
+    std::atomic<size_t> linesDone{0};
+    std::atomic<bool> finished_{false}, failed_{false};
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<Chunk> pending;
+    std::map<size_t, Evaluated> waiting;
+    std::deque<std::pair<size_t, size_t>> slowLines;
+    std::map<size_t, DoneChunk> done;
+    size_t inFlight = 0, chunksRead = 0;
+    bool readDone = false;
+    std::atomic<bool> cancelled{false};
+    std::vector<std::thread> threads;
+};
+
+void reportBatch(const BatchJob& job) {
+    if (!job.failed()) fprintf(stderr, "batch %s: %zu lines -> %s\n", job.input().c_str(), job.lines(), job.output().c_str());
+    else if (job.error().empty()) fprintf(stderr, "batch %s failed\n", job.input().c_str());
+    else fprintf(stderr, "batch %s failed: %s\n", job.input().c_str(), job.error().c_str());
 }
 
-double evalPostfix(const std::vector<Token>& postfix) {
-    std::stack<double> st;
-    for (auto& t : postfix) {
-        if (t.type == NUMBER) st.push(t.value);
-        else if (t.type == OPERATOR) {
-            if (st.size() < 2) return NAN;
-            double b = st.top(); st.pop();
-            double a = st.top(); st.pop();
-            st.push(applyOp(a, b, t.op));
+// Works out more and more digits of an exact result on a background thread,
+// 17 first and then twice as many each time up to target, so digits show at
+// once and the rest fill in behind them. Dropping the refiner stops the work
+// at the next approximation.
+class Refiner {
+public:
+    Refiner(wumbo::ExactReal x, int target) : x(std::move(x)), target(target), thread(&Refiner::run, this) {}
+
+    ~Refiner() {
+        stop = true;
+        thread.join();
+    }
+
+    // Sets text to the latest digits if they are new since the last call;
+    // empty text means the value could not be approximated at all.
+    bool poll(std::string& text) {
+        std::lock_guard<std::mutex> lock(m);
+        if (!fresh) return false;
+        text = latest;
+        fresh = false;
+        return true;
+    }
+
+    bool finished() const { return finished_; }
+
+private:
+    void run() {
+        bool shown = false;
+        for (int digits = std::min(17, target);; digits = std::min(2 * digits, target)) {
+            std::string text;
+            bool ok = x.format(digits, text, &stop);
+            if (stop) break;
+            if (ok || !shown) {
+                std::lock_guard<std::mutex> lock(m);
+                latest = ok ? text : "";
+                fresh = shown = true;
+            }
+            if (!ok || digits == target) break;
         }
+        finished_ = true;
     }
-    if (st.size() != 1) return NAN;
-    return st.top();
+
+    wumbo::ExactReal x;
+    int target;
+    std::atomic<bool> stop{false}, finished_{false};
+    std::mutex m;
+    std::string latest;
+    bool fresh = false;
+    std::thread thread;
+};
+
+// Recorded input: an 8-byte "WUMBOREC" magic, then per event a u32 millisecond
+// timestamp, a u8 kind and a kind-specific payload, all little-endian. Keys
+// pressed with Ctrl, the tab shortcuts, also carry their u16 modifiers.
+enum RecordKind : uint8_t { REC_MOUSE = 1, REC_KEY = 2, REC_TEXT = 3, REC_KEY_MOD = 4 };
+const char recordMagic[8] = {'W', 'U', 'M', 'B', 'O', 'R', 'E', 'C'};
+
+struct RecordedEvent {
+    uint32_t time;
+    SDL_Event event;
+};
+
+void putU32(std::ofstream& out, uint32_t v) {
+    unsigned char b[4] = {(unsigned char)v, (unsigned char)(v >> 8), (unsigned char)(v >> 16), (unsigned char)(v >> 24)};
+    out.write((const char*)b, 4);
 }
 
-double evaluate(const std::string& expr) {
-    auto tokens = tokenize(expr);
-    auto postfix = infixToPostfix(tokens);
-    return evalPostfix(postfix);
+bool getU32(std::ifstream& in, uint32_t& v) {
+    unsigned char b[4];
+    if (!in.read((char*)b, 4)) return false;
+    v = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+    return true;
+}
+
+struct EventRecorder {
+    std::ofstream out;
+    uint32_t start = 0;
+
+    bool open(const std::string& path) {
+        out.open(path, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(recordMagic, sizeof(recordMagic));
+        start = SDL_GetTicks();
+        return true;
+    }
+
+    void record(const SDL_Event& e) {
+        if (!out.is_open()) return;
+        uint32_t t = SDL_GetTicks() - start;
+        if (e.type == SDL_MOUSEBUTTONDOWN) {
+            putU32(out, t);
+            out.put(REC_MOUSE);
+            out.put((char)e.button.button);
+            putU32(out, (uint32_t)e.button.x);
+            putU32(out, (uint32_t)e.button.y);
+        } else if (e.type == SDL_KEYDOWN) {
+            bool mod = e.key.keysym.mod & KMOD_CTRL;
+            putU32(out, t);
+            out.put(mod ? REC_KEY_MOD : REC_KEY);
+            putU32(out, (uint32_t)e.key.keysym.sym);
+            if (mod) {
+                out.put((char)(e.key.keysym.mod & 0xff));
+                out.put((char)(e.key.keysym.mod >> 8));
+            }
+        } else if (e.type == SDL_TEXTINPUT) {
+            size_t len = strnlen(e.text.text, sizeof(e.text.text) - 1);
+            putU32(out, t);
+            out.put(REC_TEXT);
+            out.put((char)len);
+            out.write(e.text.text, len);
+        }
+    }
+};
+
+std::vector<RecordedEvent> loadRecording(const std::string& path) {
+    std::vector<RecordedEvent> events;
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(recordMagic)];
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, recordMagic, sizeof(magic)) != 0) return events;
+    RecordedEvent r;
+    while (getU32(in, r.time)) {
+        memset(&r.event, 0, sizeof(r.event));
+        int kind = in.get();
+        uint32_t a, b;
+        if (kind == REC_MOUSE) {
+            int button = in.get();
+            if (!getU32(in, a) || !getU32(in, b)) break;
+            r.event.type = SDL_MOUSEBUTTONDOWN;
+            r.event.button.button = (Uint8)button;
+            r.event.button.x = (Sint32)a;
+            r.event.button.y = (Sint32)b;
+        } else if (kind == REC_KEY || kind == REC_KEY_MOD) {
+            if (!getU32(in, a)) break;
+            r.event.type = SDL_KEYDOWN;
+            r.event.key.keysym.sym = (SDL_Keycode)a;
+            if (kind == REC_KEY_MOD) {
+                int lo = in.get(), hi = in.get();
+                if (hi < 0) break;
+                r.event.key.keysym.mod = (Uint16)(lo | hi << 8);
+            }
+        } else if (kind == REC_TEXT) {
+            int len = in.get();
+            if (len < 0 || len >= (int)sizeof(r.event.text.text) || !in.read(r.event.text.text, len)) break;
+            r.event.type = SDL_TEXTINPUT;
+        } else break;
+        events.push_back(r);
+    }
+    return events;
+}
+
+void printFrameStats(std::vector<double> frameMs) {
+    if (frameMs.empty()) return;
+    double total = 0;
+    for (double ms : frameMs) total += ms;
+    std::sort(frameMs.begin(), frameMs.end());
+    auto pct = [&](double p) { return frameMs[std::min(frameMs.size() - 1, (size_t)(p * frameMs.size()))]; };
+    printf("frames: %zu  total: %.1f ms  mean: %.3f ms  p50: %.3f ms  p99: %.3f ms  max: %.3f ms\n",
+           frameMs.size(), total, total / frameMs.size(), pct(0.50), pct(0.99), frameMs.back());
 }
 
 struct Button {
@@ -132,14 +510,174 @@ struct Button {
     char inputChar;
 };
 
+// The printable ASCII glyphs of a font, rasterized once into one texture, so
+// a line of text costs a copy per visible glyph each frame instead of
+// rasterizing the whole string. Kerning is not applied.
+struct GlyphAtlas {
+    SDL_Texture* texture = nullptr;
+    SDL_Rect glyphs[128] = {};
+    int advances[128] = {};
+    int height = 0;
+
+    ~GlyphAtlas() {
+        if (texture) SDL_DestroyTexture(texture);
+    }
+
+    bool build(SDL_Renderer* renderer, TTF_Font* font) {
+        SDL_Color white = {255, 255, 255, 255};
+        std::vector<SDL_Surface*> surfs(128, nullptr);
+        int sheetW = 0;
+        height = TTF_FontHeight(font);
+        for (int c = ' '; c < 127; ++c) {
+            TTF_GlyphMetrics(font, (Uint16)c, nullptr, nullptr, nullptr, nullptr, &advances[c]);
+            surfs[c] = TTF_RenderGlyph_Blended(font, (Uint16)c, white);
+            if (!surfs[c]) continue;
+            glyphs[c] = {sheetW, 0, surfs[c]->w, surfs[c]->h};
+            sheetW += surfs[c]->w + 1;
+            height = std::max(height, surfs[c]->h);
+        }
+        SDL_Surface* sheet = SDL_CreateRGBSurfaceWithFormat(0, std::max(sheetW, 1), std::max(height, 1), 32, SDL_PIXELFORMAT_RGBA32);
+        for (int c = ' '; c < 127; ++c) {
+            if (!surfs[c]) continue;
+            if (sheet) {
+                SDL_SetSurfaceBlendMode(surfs[c], SDL_BLENDMODE_NONE);
+                SDL_BlitSurface(surfs[c], nullptr, sheet, &glyphs[c]);
+            }
+            SDL_FreeSurface(surfs[c]);
+        }
+        if (!sheet) return false;
+        texture = SDL_CreateTextureFromSurface(renderer, sheet);
+        SDL_FreeSurface(sheet);
+        return texture != nullptr;
+    }
+
+    int advance(char c) const { return advances[(unsigned char)c & 127]; }
+
+    int width(const std::string& text) const {
+        int w = 0;
+        for (char c : text) w += advance(c);
+        return w;
+    }
+
+    // Draws text with its first glyph at x, copying only the glyphs that
+    // fall inside clip.
+    void draw(SDL_Renderer* renderer, const std::string& text, int x, int y, const SDL_Rect& clip) const {
+        SDL_RenderSetClipRect(renderer, &clip);
+        for (char c : text) {
+            if (x >= clip.x + clip.w) break;
+            const SDL_Rect& src = glyphs[(unsigned char)c & 127];
+            if (x + src.w > clip.x && src.w > 0) {
+                SDL_Rect dst = {x, y, src.w, src.h};
+                SDL_RenderCopy(renderer, texture, &src, &dst);
+            }
+            x += advance(c);
+        }
+        SDL_RenderSetClipRect(renderer, nullptr);
+    }
+};
+
+// One calculator, shown as a tab. Tabs share the window, renderer, font,
+// glyph atlas, symbol table and batch workers, so each costs only its own
+// input and results; ans is rebound to the selected tab's last result.
+// Exact results are refined in the background up to the digits asked for;
+// the expression stays on screen until their first digits are ready.
+struct Calculator {
+    std::string input;
+    wumbo::BigInt bigResult;
+    bool bigShown = false;
+    std::unique_ptr<Refiner> refiner;
+    bool refinerFirst = false;
+    // While a result is shown, an operator typed next applies to ans, the
+    // result as computed, rather than to the digits on screen.
+    bool showingResult = false;
+    int inputScrollX = 0;
+    wumbo::Value ans;
+};
+
+// Reads the value of --threads: a count from 1 to 1024, whose workers are
+// pinned across all CPUs, or auto for one worker per physical core.
+static bool parseWorkers(const std::string& n, unsigned& workers, std::vector<int>& cpus) {
+    if (n == "auto") {
+        cpus = wumbo::workerCpus(true);
+        workers = (unsigned)cpus.size();
+        return workers > 0;
+    }
+    if (n.empty() || !isdigit((unsigned char)n[0])) return false;
+    char* end = nullptr;
+    errno = 0;
+    long count = strtol(n.c_str(), &end, 10);
+    if (*end || errno || count <= 0 || count > 1024) return false;
+    cpus = wumbo::workerCpus(false);
+    workers = (unsigned)count;
+    return true;
+}
+
 int main(int argc, char* argv[]) {
+    std::string recordPath, replayPath;
+    std::vector<std::string> batchPaths;
+    // Batch workers: by default one fewer than the hardware threads, left to
+    // the scheduler; with --threads, that many pinned across cores and NUMA
+    // nodes, or with auto one per physical core.
+    unsigned batchWorkers = BatchJob::defaultWorkers();
+    std::vector<int> batchCpus;
+    bool replayFast = false, headless = false;
+    int resultDigits = 1000;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--record" && i + 1 < argc) recordPath = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc) replayPath = argv[++i];
+        else if (arg == "--replay-fast") replayFast = true;
+        else if (arg == "--headless") headless = true;
+        else if (arg == "--digits" && i + 1 < argc && atoi(argv[i + 1]) > 0) resultDigits = atoi(argv[++i]);
+        else if (arg == "--batch" && i + 1 < argc) batchPaths.push_back(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc && parseWorkers(argv[i + 1], batchWorkers, batchCpus)) ++i;
+        else if (arg.compare(0, 10, "--threads=") == 0 && parseWorkers(arg.substr(10), batchWorkers, batchCpus)) {}
+        else { fprintf(stderr, "usage: %s [--record FILE] [--replay FILE [--replay-fast]] [--headless] [--digits N] [--batch FILE]... [--threads N|auto]\n", argv[0]); return 1; }
+    }
+
+    // Batch jobs share a table of their own. ans is bound there once and never
+    // rebound, so a file's output does not depend on what the calculator, or
+    // whichever tab is selected, last computed while the job ran.
+    wumbo::SymbolTable batchSymbols;
+    std::vector<std::string> pluginErrors;
+    batchSymbols.loadPlugins(pluginDir(), &pluginErrors);
+    for (auto& err : pluginErrors) fprintf(stderr, "plugin: %s\n", err.c_str());
+    batchSymbols.setValue("ans", wumbo::Value());
+
+    // Files given with --batch run one after another without a window.
+    if (!batchPaths.empty()) {
+        bool ok = true;
+        for (auto& path : batchPaths) {
+            BatchJob job(path, &batchSymbols, batchWorkers, batchCpus);
+            while (!job.finished()) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            reportBatch(job);
+            ok = ok && !job.failed();
+        }
+        return ok ? 0 : 1;
+    }
+
+    // The calculator's table, where ans follows the selected tab. It loads
+    // the same plugins; any failure was reported above.
+    wumbo::SymbolTable symbols;
+    symbols.loadPlugins(pluginDir());
+    symbols.setValue("ans", wumbo::Value());
+
+    std::vector<RecordedEvent> replay;
+    if (!replayPath.empty()) {
+        replay = loadRecording(replayPath);
+        if (replay.empty()) { fprintf(stderr, "no events in recording %s\n", replayPath.c_str()); return 1; }
+    }
+
+    if (headless) SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
     if (SDL_Init(SDL_INIT_VIDEO) != 0) return 1;
     if (TTF_Init() != 0) { SDL_Quit(); return 1; }
 
     const int winW = 400, winH = 500;
-    SDL_Window* window = SDL_CreateWindow("Wumbo Calculator", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, winW, winH, 0);
+    SDL_Window* window = SDL_CreateWindow("Wumbo Calculator", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, winW, winH, headless ? SDL_WINDOW_HIDDEN : 0);
     if (!window) { TTF_Quit(); SDL_Quit(); return 1; }
-    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    Uint32 rendererFlags = headless ? SDL_RENDERER_SOFTWARE : SDL_RENDERER_ACCELERATED;
+    if (!replayFast) rendererFlags |= SDL_RENDERER_PRESENTVSYNC;
+    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, rendererFlags);
     if (!renderer) { SDL_DestroyWindow(window); TTF_Quit(); SDL_Quit(); return 1; }
 
     std::string fontPath = findSystemFont();
@@ -147,6 +685,9 @@ int main(int argc, char* argv[]) {
     TTF_Font* font = TTF_OpenFont(fontPath.c_str(), 28);
     if (!font) { SDL_DestroyRenderer(renderer); SDL_DestroyWindow(window); TTF_Quit(); SDL_Quit(); return 1; }
 
+    GlyphAtlas atlas;
+    if (!atlas.build(renderer, font)) { TTF_CloseFont(font); SDL_DestroyRenderer(renderer); SDL_DestroyWindow(window); TTF_Quit(); SDL_Quit(); return 1; }
+
     const int btnCols = 4, btnRows = 5, btnW = 80, btnH = 60, btnMargin = 10, startX = 20, startY = 150;
 
     std::vector<Button> buttons = {
@@ -163,86 +704,250 @@ int main(int argc, char* argv[]) {
         buttons[i].rect.y = startY + row * (btnH + btnMargin);
     }
 
-    std::string input;
+    // An integer result longer than windowedDigits is shown from its limbs,
+    // a window of digits at a time, and only turned into text when edited.
+    // Digits are laid out on one advance, as nearly every font has them.
+    const size_t windowedDigits = 4096;
+    const int scrollEnd = INT_MAX;
     bool quit = false;
-    int inputScrollX = 0;
     SDL_StartTextInput();
 
+    // Tabs run along the top, the slot after the last opening a new one
+    // while there is room. Ctrl+T opens a tab, Ctrl+W closes one and
+    // Ctrl+Tab moves between them.
+    const size_t maxTabs = 20;
+    const int tabY = 8, tabH = 34, tabGap = 4;
+    std::vector<std::unique_ptr<Calculator>> tabs;
+    tabs.push_back(std::make_unique<Calculator>());
+    size_t current = 0;
+    auto tabSlots = [&]() { return std::min(tabs.size() + 1, maxTabs); };
+    auto tabRect = [&](size_t i) {
+        int slots = (int)tabSlots();
+        int w = std::min(60, ((winW - 40) - (slots - 1) * tabGap) / slots);
+        return SDL_Rect{20 + (int)i * (w + tabGap), tabY, w, tabH};
+    };
+    auto selectTab = [&](size_t i) {
+        current = i;
+        symbols.setValue("ans", tabs[current]->ans);
+    };
+    auto openTab = [&]() {
+        if (tabs.size() == maxTabs) return;
+        tabs.push_back(std::make_unique<Calculator>());
+        selectTab(tabs.size() - 1);
+    };
+    auto closeTab = [&]() {
+        if (tabs.size() == 1) return;
+        tabs.erase(tabs.begin() + current);
+        selectTab(std::min(current, tabs.size() - 1));
+    };
+
+    SDL_EventState(SDL_DROPFILE, SDL_ENABLE);
+    std::deque<std::string> droppedFiles;
+    std::unique_ptr<BatchJob> batch;
+
+    EventRecorder recorder;
+    if (!recordPath.empty() && !recorder.open(recordPath)) fprintf(stderr, "cannot record to %s\n", recordPath.c_str());
+
+    wumbo::EvalBudget guiBudget;
+    guiBudget.maxSeconds = 2;
+    guiBudget.maxBytes = 256 << 20;
+
+    auto evaluateInput = [&]() {
+        Calculator& t = *tabs[current];
+        t.refiner.reset();
+        std::string error;
+        wumbo::EvalResult r = wumbo::isScript(t.input) ? wumbo::evaluateScript(t.input, guiBudget, &symbols, &error)
+                                                       : wumbo::evaluate(t.input, guiBudget, &symbols);
+        if (!error.empty()) fprintf(stderr, "%s\n", error.c_str());
+        if (r.status != wumbo::EVAL_OK && r.status != wumbo::EVAL_ERROR)
+            fprintf(stderr, "evaluation stopped: %s during %s (%zu/%zu)\n", wumbo::evalStatusName(r.status), r.stage, r.done, r.total);
+        // Whether an exact result fails is only known once it is refined.
+        t.showingResult = r.value.isExact() || !r.value.isError();
+        if (t.showingResult) {
+            t.ans = r.value;
+            symbols.setValue("ans", r.value);
+        }
+        if (r.value.isExact()) {
+            t.refiner = std::make_unique<Refiner>(r.value.exact(), resultDigits);
+            t.refinerFirst = true;
+            t.bigShown = false;
+            return;
+        }
+        t.bigResult = r.value.isInteger() ? r.value.bigInt() : wumbo::BigInt();
+        t.bigShown = t.bigResult.digits() > windowedDigits;
+        if (t.bigShown) t.input.clear();
+        else if (r.value.isError()) t.input = "";
+        else t.input = wumbo::formatValue(r.value);
+    };
+
+    auto editInput = [&](char next) {
+        Calculator& t = *tabs[current];
+        t.refiner.reset();
+        bool chained = t.showingResult && next && strchr("+-*/^!", next);
+        t.showingResult = false;
+        if (chained) {
+            t.input = "ans";
+            t.bigResult = wumbo::BigInt();
+            t.bigShown = false;
+            return;
+        }
+        if (!t.bigShown) return;
+        t.input = t.bigResult.toString();
+        t.bigResult = wumbo::BigInt();
+        t.bigShown = false;
+    };
+
+    auto inside = [](const SDL_Rect& r, int x, int y) { return x >= r.x && x <= r.x + r.w && y >= r.y && y <= r.y + r.h; };
+
+    auto handleEvent = [&](const SDL_Event& e) {
+        Calculator& t = *tabs[current];
+        if (e.type == SDL_QUIT) quit = true;
+        else if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT) {
+            int mx = e.button.x, my = e.button.y;
+            for (size_t i = 0; i < tabSlots(); ++i) {
+                if (!inside(tabRect(i), mx, my)) continue;
+                if (i < tabs.size()) selectTab(i);
+                else openTab();
+                return;
+            }
+            for (auto& btn : buttons) {
+                if (inside(btn.rect, mx, my)) {
+                    if (btn.label == "C") {
+                        t.refiner.reset();
+                        t.input.clear();
+                        t.bigShown = t.showingResult = false;
+                    } else if (btn.label == "=") {
+                        evaluateInput();
+                    } else {
+                        editInput(btn.inputChar);
+                        t.input += btn.inputChar;
+                    }
+                    t.inputScrollX = scrollEnd;
+                }
+            }
+        } else if (e.type == SDL_KEYDOWN) {
+            SDL_Keycode k = e.key.keysym.sym;
+            bool ctrl = e.key.keysym.mod & KMOD_CTRL;
+            if (ctrl && k == SDLK_t) openTab();
+            else if (ctrl && k == SDLK_w) closeTab();
+            else if (ctrl && k == SDLK_TAB) selectTab((current + (e.key.keysym.mod & KMOD_SHIFT ? tabs.size() - 1 : 1)) % tabs.size());
+            else if (k == SDLK_BACKSPACE) {
+                editInput(0);
+                if (!t.input.empty()) t.input.pop_back();
+            } else if (k == SDLK_RETURN || k == SDLK_KP_ENTER) {
+                evaluateInput();
+                t.inputScrollX = scrollEnd;
+            } else if (k == SDLK_ESCAPE) quit = true;
+            else if (k == SDLK_LEFT) t.inputScrollX -= 15;
+            else if (k == SDLK_RIGHT) t.inputScrollX += 15;
+            else if (k == SDLK_HOME) t.inputScrollX = 0;
+            else if (k == SDLK_END) t.inputScrollX = scrollEnd;
+        } else if (e.type == SDL_DROPFILE) {
+            droppedFiles.push_back(e.drop.file);
+            SDL_free(e.drop.file);
+        } else if (e.type == SDL_TEXTINPUT) {
+            char c = e.text.text[0];
+            if (c && (isalnum(c) || strchr("_,+-*/.()[]^! ;={}<>", c))) {
+                editInput(c);
+                t.input += c;
+                t.inputScrollX = scrollEnd;
+            }
+        }
+    };
+
+    // While replaying, live input other than quitting is ignored so runs stay
+    // deterministic. Fast replay feeds one recorded event per frame with no
+    // vsync; otherwise events are fed at their recorded times.
+    size_t replayPos = 0;
+    uint32_t replayStart = SDL_GetTicks();
+    std::vector<double> frameMs;
+    Uint64 perfFreq = SDL_GetPerformanceFrequency();
+
     while (!quit) {
+        Uint64 frameStart = SDL_GetPerformanceCounter();
         SDL_Event e;
         while (SDL_PollEvent(&e)) {
-            if (e.type == SDL_QUIT) quit = true;
-            else if (e.type == SDL_MOUSEBUTTONDOWN && e.button.button == SDL_BUTTON_LEFT) {
-                int mx = e.button.x, my = e.button.y;
-                for (auto& btn : buttons) {
-                    if (mx >= btn.rect.x && mx <= btn.rect.x + btn.rect.w && my >= btn.rect.y && my <= btn.rect.y + btn.rect.h) {
-                        if (btn.label == "C") {
-                            input.clear();
-                        } else if (btn.label == "=") {
-                            double res = evaluate(input);
-                            if (std::isnan(res)) input = "";
-                            else {
-                                char buf[64];
-                                snprintf(buf, sizeof(buf), "%.6g", res);
-                                input = buf;
-                            }
-                        } else input += btn.inputChar;
-                        inputScrollX = 1000000;
-                    }
-                }
-            } else if (e.type == SDL_KEYDOWN) {
-                SDL_Keycode k = e.key.keysym.sym;
-                if (k == SDLK_BACKSPACE && !input.empty()) input.pop_back();
-                else if (k == SDLK_RETURN || k == SDLK_KP_ENTER) {
-                    double res = evaluate(input);
-                    if (std::isnan(res)) input = "";
-                    else {
-                        char buf[64];
-                        snprintf(buf, sizeof(buf), "%.6g", res);
-                        input = buf;
-                    }
-                    inputScrollX = 1000000;
-                } else if (k == SDLK_ESCAPE) quit = true;
-                else if (k == SDLK_LEFT) inputScrollX -= 15;
-                else if (k == SDLK_RIGHT) inputScrollX += 15;
-            } else if (e.type == SDL_TEXTINPUT) {
-                char c = e.text.text[0];
-                if ((isdigit(c) || c == '+' || c == '-' || c == '*' || c == '/' || c == '.' || c == '(' || c == ')' || c == '^')) {
-                    input += c;
-                    inputScrollX = 1000000;
-                }
+            if (!replay.empty() && e.type != SDL_QUIT) {
+                if (e.type == SDL_DROPFILE) SDL_free(e.drop.file);
+                continue;
+            }
+            recorder.record(e);
+            handleEvent(e);
+        }
+        if (!replay.empty()) {
+            if (replayFast) {
+                if (replayPos < replay.size()) handleEvent(replay[replayPos++].event);
+            } else {
+                uint32_t now = SDL_GetTicks() - replayStart;
+                while (replayPos < replay.size() && replay[replayPos].time <= now) handleEvent(replay[replayPos++].event);
             }
         }
 
+        // Results go on refining in tabs not shown.
+        for (auto& tab : tabs) {
+            Calculator& t = *tab;
+            if (!t.refiner) continue;
+            bool done = t.refiner->finished();
+            std::string refined;
+            if (t.refiner->poll(refined)) {
+                if (t.input != refined && t.refinerFirst) t.inputScrollX = 0;
+                t.input = refined;
+                t.refinerFirst = false;
+            }
+            if (done) t.refiner.reset();
+        }
+
+        if (batch && batch->finished()) {
+            reportBatch(*batch);
+            batch.reset();
+        }
+        if (!batch && !droppedFiles.empty()) {
+            batch = std::make_unique<BatchJob>(droppedFiles.front(), &batchSymbols, batchWorkers, batchCpus);
+            droppedFiles.pop_front();
+        }
+
         SDL_SetRenderDrawColor(renderer, 30, 30, 30, 255);
         SDL_RenderClear(renderer);
 
+        if (batch) {
+            SDL_Rect barRect = {20, 120, 360, 12};
+            SDL_SetRenderDrawColor(renderer, 50, 50, 50, 255);
+            SDL_RenderFillRect(renderer, &barRect);
+            SDL_Rect fillRect = {barRect.x, barRect.y, (int)(barRect.w * batch->progress()), barRect.h};
+            SDL_SetRenderDrawColor(renderer, 90, 160, 90, 255);
+            SDL_RenderFillRect(renderer, &fillRect);
+        }
+
+        for (size_t i = 0; i < tabSlots(); ++i) {
+            SDL_Rect r = tabRect(i);
+            int shade = i == current ? 90 : 55;
+            SDL_SetRenderDrawColor(renderer, shade, shade, shade, 255);
+            SDL_RenderFillRect(renderer, &r);
+            std::string label = i < tabs.size() ? std::to_string(i + 1) : "+";
+            atlas.draw(renderer, label, r.x + std::max(2, (r.w - atlas.width(label)) / 2), r.y + (r.h - atlas.height) / 2, r);
+        }
+
+        Calculator& t = *tabs[current];
         SDL_Rect inputRect = {20, 50, 360, 60};
         SDL_SetRenderDrawColor(renderer, 50, 50, 50, 255);
         SDL_RenderFillRect(renderer, &inputRect);
 
-        if (!input.empty()) {
-            SDL_Color white = {255, 255, 255, 255};
-            SDL_Surface* surf = TTF_RenderUTF8_Blended(font, input.c_str(), white);
-            if (surf) {
-                SDL_Texture* tex = SDL_CreateTextureFromSurface(renderer, surf);
-                int textW = surf->w, textH = surf->h;
-
-                if (inputScrollX > textW - inputRect.w + 10) inputScrollX = std::max(0, textW - inputRect.w + 10);
-                if (inputScrollX < 0) inputScrollX = 0;
+        int signW = t.bigShown && t.bigResult.negative() ? atlas.advance('-') : 0, digitW = std::max(1, atlas.advance('0'));
+        int textW = t.bigShown ? signW + (int)t.bigResult.digits() * digitW : atlas.width(t.input);
+        if (textW > 0) {
+            int viewW = inputRect.w - 10;
+            if (t.inputScrollX > textW - viewW) t.inputScrollX = std::max(0, textW - viewW);
+            if (t.inputScrollX < 0) t.inputScrollX = 0;
 
-                SDL_Rect srcRect, dstRect;
-                if (textW <= inputRect.w) {
-                    srcRect = {0, 0, textW, textH};
-                    dstRect = {inputRect.x + 5, inputRect.y + (inputRect.h - textH) / 2, textW, textH};
-                } else {
-                    srcRect = {inputScrollX, 0, inputRect.w - 10, textH};
-                    dstRect = {inputRect.x + 5, inputRect.y + (inputRect.h - textH) / 2, inputRect.w - 10, textH};
-                }
-                SDL_RenderCopy(renderer, tex, &srcRect, &dstRect);
-                SDL_DestroyTexture(tex);
-                SDL_FreeSurface(surf);
-            }
+            SDL_Rect clip = {inputRect.x + 5, inputRect.y, viewW, inputRect.h};
+            int x = clip.x - t.inputScrollX, y = inputRect.y + (inputRect.h - atlas.height) / 2;
+            if (t.bigShown) {
+                size_t first = t.inputScrollX > signW ? (t.inputScrollX - signW) / digitW : 0;
+                std::string window = t.bigResult.digitWindow(first, viewW / digitW + 2);
+                if (first == 0 && signW) window.insert(0, "-");
+                else x += signW + (int)first * digitW;
+                atlas.draw(renderer, window, x, y, clip);
+            } else atlas.draw(renderer, t.input, x, y, clip);
         }
 
         for (auto& btn : buttons) {
@@ -263,8 +968,15 @@ int main(int argc, char* argv[]) {
         }
 
         SDL_RenderPresent(renderer);
+
+        if (!replay.empty()) {
+            frameMs.push_back((SDL_GetPerformanceCounter() - frameStart) * 1000.0 / perfFreq);
+            if (replayPos == replay.size()) quit = true;
+        }
     }
 
+    printFrameStats(frameMs);
+
     SDL_StopTextInput();
     TTF_CloseFont(font);
     SDL_DestroyRenderer(renderer);
@@ -0,0 +1,78 @@
+// The C ABI (user-079): statuses, compiled programs shared between
+// threads, arrays, text and scripts.
+
+#include "wumbo/wumbo.h"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+
+int main() {
+    CHECK(wumbo_abi_version() == WUMBO_ABI_VERSION);
+
+    int status = -1;
+    CHECK(same(wumbo_evaluate("1+2*3", &status), 7) && status == WUMBO_OK);
+    CHECK(std::isnan(wumbo_evaluate("1/0", &status)) && status == WUMBO_ERROR);
+    CHECK(std::isnan(wumbo_evaluate("(1+", &status)) && status == WUMBO_ERROR);
+    CHECK(same(wumbo_evaluate("2^10", nullptr), 1024));
+
+    CHECK(wumbo_compile("1+") == nullptr);
+    CHECK(wumbo_compile("*") == nullptr);
+    wumbo_program* p = wumbo_compile("sqrt(2)^2 + 3!");
+    CHECK(p != nullptr);
+    if (p) {
+        std::vector<std::thread> threads;
+        std::vector<int> bad(8, 0);
+        for (int t = 0; t < 8; ++t)
+            threads.emplace_back([&, t] {
+                for (int k = 0; k < 1000; ++k) {
+                    int s = -1;
+                    double v = wumbo_run(p, &s);
+                    if (s != WUMBO_OK || std::fabs(v - 8) > 1e-12) bad[t]++;
+                }
+            });
+        for (auto& t : threads) t.join();
+        for (int b : bad) CHECK(b == 0);
+        wumbo_free(p);
+    }
+    wumbo_free(nullptr);
+
+    const char* exprs[] = {"1+1", "0/0", "2^0.5", "", "(1+i)^2", "3*(4"};
+    double results[6], imag[6];
+    int statuses[6];
+    wumbo_evaluate_array(exprs, 6, results, statuses);
+    CHECK(same(results[0], 2) && statuses[0] == WUMBO_OK);
+    CHECK(std::isnan(results[1]) && statuses[1] == WUMBO_ERROR);
+    CHECK(same(results[2], std::sqrt(2.0)));
+    CHECK(std::isnan(results[4]) && statuses[4] == WUMBO_ERROR);
+    CHECK(same(results[5], 12));
+    wumbo_evaluate_array(exprs, 6, results, nullptr);
+    CHECK(same(results[0], 2));
+    wumbo_evaluate_array_complex(exprs, 6, results, imag, statuses, nullptr);
+    CHECK(same(results[4], 0) && same(imag[4], 2) && statuses[4] == WUMBO_OK);
+    CHECK(same(imag[0], 0));
+
+    char buf[64];
+    size_t n = wumbo_evaluate_text("2^100", 40, buf, sizeof buf, &status);
+    CHECK(status == WUMBO_OK && std::strcmp(buf, "1267650600228229401496703205376") == 0 && n == std::strlen(buf));
+    n = wumbo_evaluate_text("exact(sqrt(2))", 30, buf, 8, &status);
+    CHECK(std::strlen(buf) == 7 && n > 7);
+    wumbo_evaluate_text("1/0", 10, buf, sizeof buf, &status);
+    CHECK(status == WUMBO_ERROR);
+
+    CHECK(same(wumbo_evaluate_script("s = 0; for k = 1, 10 { s = s + k }; s", nullptr, &status), 55) &&
+          status == WUMBO_OK);
+    CHECK(std::isnan(wumbo_evaluate_script("for k = 1 { }", nullptr, &status)) && status == WUMBO_ERROR);
+
+    wumbo_symbols* symbols = wumbo_symbols_new();
+    CHECK(symbols != nullptr);
+    CHECK(wumbo_symbols_load_plugins(symbols, "/nonexistent") == 0);
+    CHECK(wumbo_compile_with("hypot2(3, 4)", symbols) == nullptr);
+    wumbo_program* q = wumbo_compile_with("sqrt(16)", symbols);
+    CHECK(q && same(wumbo_run(q, &status), 4));
+    wumbo_free(q);
+    wumbo_symbols_free(symbols);
+    return checkResult();
+}
@@ -0,0 +1,72 @@
+// Named values (user-093): ans keeps a result exactly as computed, programs
+// read whatever is bound when they run, and rebinding is safe while other
+// threads evaluate against the same table.
+
+#include "wumbo/batch.h"
+#include "wumbo/engine.h"
+
+#include <atomic>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+
+using namespace wumbo;
+
+static std::string text(const std::string& expr, const SymbolTable& symbols) {
+    EvalResult r = evaluate(expr, EvalBudget(), &symbols);
+    return r.status == EVAL_OK ? formatValue(r.value, 30) : "error";
+}
+
+// Binds ans to the value of expr, as the calculator does after =.
+static bool chain(const std::string& expr, SymbolTable& symbols) {
+    EvalResult r = evaluate(expr, EvalBudget(), &symbols);
+    return r.status == EVAL_OK && symbols.setValue("ans", r.value);
+}
+
+int main() {
+    SymbolTable symbols;
+    CHECK(text("ans", symbols) == "error");
+    CHECK(symbols.setValue("ans", Value(2.5)) && symbols.findValue("ans"));
+    CHECK(text("ans*2", symbols) == "5" && evaluate("ans + 1", &symbols) == 3.5);
+    CHECK(!symbols.setValue("sqrt", Value(1)) && !symbols.setValue("i", Value(1)) &&
+          !symbols.setValue("x", Value(1)) && !symbols.setValue("2a", Value(1)));
+
+    // Each step picks up the exact value, not the text shown for it.
+    CHECK(chain("exact(1)/3", symbols) && chain("ans*3", symbols) && text("ans", symbols) == "1");
+    CHECK(chain("30!", symbols) && chain("ans+1", symbols) && text("ans-30!", symbols) == "1");
+    CHECK(chain("(1+i)^2", symbols) && text("ans*ans", symbols) == "-4");
+    CHECK(chain("[1, 2, 3]", symbols) && text("sum(ans)", symbols) == "6");
+
+    // A compiled program reads the binding when it runs.
+    CHECK(symbols.setValue("ans", Value(1.0)));
+    Program program = compile("ans*10", &symbols);
+    CHECK(run(program) == 10);
+    CHECK(symbols.setValue("ans", Value(4.0)) && run(program) == 40);
+
+    // Batch lines naming a value leave the lanes for the general evaluator.
+    std::vector<std::string> lines = {"ans+1", "2*3", "sqrt(ans)", "ans/0 + nope"};
+    std::vector<double> out(lines.size());
+    evaluateMany(lines, out.data(), &symbols);
+    CHECK(out[0] == 5 && out[1] == 6 && out[2] == 2 && std::isnan(out[3]));
+
+    // Readers see one whole value or the next, never a torn one.
+    symbols.setValue("big", Value::integer(BigInt(1)));
+    std::atomic<bool> done{false};
+    std::atomic<int> bad{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t)
+        readers.emplace_back([&] {
+            while (!done) {
+                double v = evaluate("big*2", &symbols);
+                if (!(v == 2 || v == 4)) ++bad;
+            }
+        });
+    for (int k = 0; k < 2000; ++k) symbols.setValue("big", Value::integer(BigInt(k % 2 + 1)));
+    done = true;
+    for (auto& t : readers) t.join();
+    CHECK(bad == 0);
+    return checkResult();
+}
@@ -0,0 +1,103 @@
+// Awaiting evaluations from coroutines (user-099), resumed through an event
+// loop on this thread and, without an executor, on the pool.
+
+#include "wumbo/async.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+
+// A coroutine nobody waits on: it runs until its first suspension when
+// called, and its frame is freed when it finishes.
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() { return {}; }
+        std::suspend_never initial_suspend() { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// Tasks posted from any thread, run on the one that calls run().
+class Loop {
+public:
+    void post(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            tasks.push_back(std::move(task));
+        }
+        cv.notify_one();
+    }
+
+    // Runs tasks until done() holds, or gives up after a minute.
+    template <typename Done> bool run(Done done) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(1);
+        while (!done()) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                if (!cv.wait_until(lock, deadline, [&] { return !tasks.empty(); })) return false;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+        return true;
+    }
+
+private:
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> tasks;
+};
+
+std::atomic<int> finished{0}, wrong{0};
+
+// The executor reads its own capture after posting, by which time the loop
+// may already have resumed the coroutine and destroyed the awaitable that
+// held it.
+wumbo::Executor onLoop(Loop& loop) {
+    return [&loop, name = std::string(100, 'l')](std::function<void()> task) {
+        loop.post(std::move(task));
+        if (name.size() != 100) wrong++;
+    };
+}
+
+Detached chain(int i, wumbo::Executor executor, std::thread::id expected) {
+    wumbo::EvalResult r = co_await wumbo::evaluateAsync(std::to_string(i) + "*2", nullptr, executor);
+    if (r.status != wumbo::EVAL_OK || r.value.toDouble() != 2.0 * i) wrong++;
+    if (expected != std::thread::id() && std::this_thread::get_id() != expected) wrong++;
+    std::vector<std::string> lines{"1+1", std::to_string(i), "1/0"};
+    std::vector<double> v = co_await wumbo::evaluateManyAsync(lines, nullptr, executor);
+    if (v.size() != 3 || v[0] != 2 || v[1] != i || !std::isnan(v[2])) wrong++;
+    if (expected != std::thread::id() && std::this_thread::get_id() != expected) wrong++;
+    finished++;
+}
+
+int main() {
+    const int n = 2000;
+    Loop loop;
+    for (int i = 0; i < n; ++i) chain(i, onLoop(loop), std::this_thread::get_id());
+    CHECK(loop.run([&] { return finished == n; }));
+    CHECK(wrong == 0);
+
+    // Without an executor each coroutine carries on on the pool.
+    finished = 0;
+    for (int i = 0; i < n; ++i) chain(i, {}, std::thread::id());
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::minutes(1);
+    while (finished < n && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    CHECK(finished == n);
+    CHECK(wrong == 0);
+    return checkResult();
+}
@@ -0,0 +1,34 @@
+#!/bin/sh
+# Batch mode (user-097 and earlier): results in input order with any number
+# of pinned workers, costly lines included, and malformed --threads refused.
+# Usage: batch_test.sh CALCULATOR
+
+calc=$1
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+fail=0
+
+i=0
+while [ $i -lt 20000 ]; do
+    echo "$i*2"
+    [ $((i % 5000)) -eq 0 ] && echo "len(range(100000))"
+    i=$((i + 1))
+done > "$dir/in.txt"
+echo "1/0" >> "$dir/in.txt"
+
+for threads in 1 3 auto; do
+    "$calc" --batch "$dir/in.txt" --threads $threads 2>/dev/null || { echo "--threads $threads failed"; fail=1; }
+    [ "$(sed -n 2p "$dir/in.txt.out")" = 100000 ] || { echo "--threads $threads: costly line 2 is wrong"; fail=1; }
+    [ "$(sed -n 20004p "$dir/in.txt.out")" = 39998 ] || { echo "--threads $threads: out of order"; fail=1; }
+    [ "$(tail -n 1 "$dir/in.txt.out")" = error ] || { echo "--threads $threads: 1/0 is not an error"; fail=1; }
+    [ "$(wc -l < "$dir/in.txt.out")" -eq 20005 ] || { echo "--threads $threads: wrong line count"; fail=1; }
+done
+
+for threads in 0 -1 foo 4x 99999 ""; do
+    if "$calc" --batch "$dir/in.txt" --threads "$threads" 2>/dev/null; then
+        echo "--threads '$threads' was accepted"
+        fail=1
+    fi
+done
+
+exit $fail
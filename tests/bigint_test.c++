@@ -0,0 +1,59 @@
+// Exact factorials and binomials (user-088) against products built up one
+// factor at a time, and the arithmetic of the big integers behind them.
+
+#include "wumbo/bigint.h"
+#include "wumbo/engine.h"
+
+#include <string>
+
+#include "check.h"
+
+using namespace wumbo;
+
+static std::string text(const std::string& expr) {
+    EvalResult r = evaluate(expr, EvalBudget());
+    return r.status == EVAL_OK ? formatValue(r.value, 100000) : "error";
+}
+
+int main() {
+    BigInt f(1);
+    for (uint64_t n = 1; n <= 400; ++n) {
+        f = f * BigInt(n);
+        if (n % 7 == 0 || n == 400) {
+            CHECK(text(std::to_string(n) + "!") == f.toString());
+            BigInt g;
+            CHECK(factorial(n, g) && g.toString() == f.toString());
+        }
+    }
+    // Prime-swing factorials of large n against the product directly.
+    BigInt big(1);
+    for (uint64_t n = 2; n <= 5000; ++n) big = big * BigInt(n);
+    BigInt g;
+    CHECK(factorial(5000, g) && g.toString() == big.toString());
+
+    // C(n, k) = n! / (k! (n - k)!), here with exact division.
+    for (uint64_t n : {10, 63, 64, 100, 257, 1000}) {
+        BigInt fn, fk, fnk, c;
+        for (uint64_t k : {0ul, 1ul, n / 3, n / 2, n - 1, n}) {
+            CHECK(factorial(n, fn) && factorial(k, fk) && factorial(n - k, fnk) && binomial(n, k, c));
+            CHECK(c.toString() == (fn / (fk * fnk)).toString());
+        }
+    }
+    CHECK(text("binom(100, 50)") == "100891344545564193334812497256");
+    CHECK(text("binom(5, 7)") == "0");
+    CHECK(text("binom(10^9, 3)") == "166666666166666667000000000");
+    CHECK(text("factorial(3.5)") == "error");
+    CHECK(text("(0-1)!") == "error");
+    CHECK(same(evaluate("170!"), 7.257415615307999e306));
+    CHECK(same(evaluate("171!"), INFINITY));
+
+    // Signs, carries and division across limbs.
+    BigInt a = BigInt::fromDouble(1e30), b(123456789);
+    CHECK(((a * b) / b).toString() == a.toString());
+    CHECK((a - a).isZero() && (b - a).negative() && (-(b - a)).toString() == (a - b).toString());
+    CHECK((BigInt(999999999) + BigInt(1)).toString() == "1000000000");
+    CHECK(a.digits() == 31 && BigInt().digits() == 1);
+    CHECK(a.scaleDecimal(-29).toString() == "10" && BigInt(15).scaleDecimal(-1).toString() == "2");
+    CHECK(BigInt(123456789).digitWindow(2, 3) == "345");
+    return checkResult();
+}
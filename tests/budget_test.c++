@@ -0,0 +1,36 @@
+// Budgets reaching the built-ins that allocate (user-077): large products,
+// lists and factorials are refused or stopped instead of running unchecked.
+
+#include "wumbo/engine.h"
+
+#include <string>
+
+#include "check.h"
+
+using namespace wumbo;
+
+static EvalResult run(const std::string& expr, double seconds, size_t bytes) {
+    EvalBudget budget;
+    budget.maxSeconds = seconds;
+    budget.maxBytes = bytes;
+    return evaluate(expr, budget);
+}
+
+int main() {
+    // 700000! has 3.7 million digits, about 1.6 MB of limbs.
+    CHECK(run("700000!", 0, 1 << 20).status == EVAL_OUT_OF_MEMORY);
+    CHECK(run("factorial(700000)", 0, 1 << 20).status == EVAL_OUT_OF_MEMORY);
+    CHECK(run("factorial(range(3) * 300000)", 0, 1 << 20).status == EVAL_OUT_OF_MEMORY);
+    EvalResult slow = run("700000!", 0.05, 0);
+    CHECK(slow.status == EVAL_TIMEOUT);
+    CHECK(slow.seconds < 1);
+    EvalResult small = run("30!", 1, 1 << 20);
+    CHECK(small.status == EVAL_OK && formatValue(small.value, 40) == "265252859812191058636308480000000");
+
+    // Lists and polynomial products are charged before they are allocated.
+    CHECK(run("len(range(10000000))", 0, 1 << 20).status == EVAL_OUT_OF_MEMORY);
+    CHECK(run("len(primes(1, 100000000))", 0, 1 << 20).status == EVAL_OUT_OF_MEMORY);
+    CHECK(run("coeffs(poly_mul(x^1000000 + 1, x^1000000 + 1))", 0, 1 << 20).status == EVAL_OUT_OF_MEMORY);
+    CHECK(run("len(range(1000))", 0, 1 << 20).status == EVAL_OK);
+    return checkResult();
+}
@@ -0,0 +1,58 @@
+// Compile-time evaluation (user-080) against the run-time engine, including
+// literals that need exact rounding and results that overflow or underflow.
+
+#include "wumbo/ceval.h"
+#include "wumbo/engine.h"
+
+#include <limits>
+
+#include "check.h"
+
+using namespace wumbo::literals;
+
+constexpr double inf = std::numeric_limits<double>::infinity();
+
+static_assert("1+2*3"_wumbo == 7);
+static_assert("2^3^2"_wumbo == 512);
+static_assert("0.1+0.2"_wumbo == 0.1 + 0.2);
+static_assert("(1+2"_wumbo == 3);
+static_assert("2*(3+(4"_wumbo == 14);
+static_assert("2^(0-1074)"_wumbo == 4.9406564584124654e-324);
+static_assert("2^(0-1075)"_wumbo == 0);
+static_assert("2^1100"_wumbo == inf);
+static_assert("(0-2)^1025"_wumbo == -inf);
+static_assert("0.5^2000"_wumbo == 0);
+static_assert("1e308*10"_wumbo == inf);
+static_assert("1e308+1e308"_wumbo == inf);
+static_assert("0-1e308-1e308"_wumbo == -inf);
+static_assert("1e308/0.1"_wumbo == inf);
+static_assert("1e308*10-1e308*10"_wumbo != "1e308*10-1e308*10"_wumbo);
+static_assert("0^(0-1)"_wumbo == inf);
+static_assert("1/0"_wumbo != "1/0"_wumbo);
+static_assert("10^1.5"_wumbo > 31.62 && "10^1.5"_wumbo < 31.63);
+static_assert("1e300^2"_wumbo == inf);
+
+template <wumbo::fixed_string S>
+void matches(const char* expr) {
+    double compiled = wumbo::eval<S>(), run = wumbo::evaluate(expr);
+    if (!same(compiled, run)) std::fprintf(stderr, "%s: %.17g at compile time, %.17g at run time\n", expr, compiled, run);
+    CHECK(same(compiled, run));
+}
+
+int main() {
+    matches<"0.3">("0.3");
+    matches<"1+2*3-4/5">("1+2*3-4/5");
+    matches<"(1+2">("(1+2");
+    matches<"((2+3)*4">("((2+3)*4");
+    matches<"2^10">("2^10");
+    matches<"2^(0-1074)">("2^(0-1074)");
+    matches<"2^1100">("2^1100");
+    matches<"1e308*10">("1e308*10");
+    matches<"1e308+1e308">("1e308+1e308");
+    matches<"1e308/0.001">("1e308/0.001");
+    matches<"1e-300*1e-20">("1e-300*1e-20");
+    matches<"1/0">("1/0");
+    matches<"2.2250738585072011e-308">("2.2250738585072011e-308");
+    matches<"1e400">("1e400");
+    return checkResult();
+}
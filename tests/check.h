@@ -0,0 +1,27 @@
+#pragma once
+
+// The few checks the regression tests need. A failed CHECK reports where and
+// what, and the test carries on; main returns checkResult().
+
+#include <cstdio>
+#include <cmath>
+
+inline int checkFailures = 0;
+
+#define CHECK(cond)                                                                       \
+    do {                                                                                  \
+        if (!(cond)) {                                                                    \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++checkFailures;                                                              \
+        }                                                                                 \
+    } while (0)
+
+// Bit-for-bit equal doubles, so NaN equals NaN and 0 differs from -0.
+inline bool same(double a, double b) {
+    return std::isnan(a) ? std::isnan(b) : a == b && std::signbit(a) == std::signbit(b);
+}
+
+inline int checkResult() {
+    if (checkFailures) std::fprintf(stderr, "%d checks failed\n", checkFailures);
+    return checkFailures ? 1 : 0;
+}
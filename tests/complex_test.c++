@@ -0,0 +1,52 @@
+// Complex mode (user-084): expressions using i are evaluated over complex
+// numbers, one at a time and on split real/imaginary lanes alike.
+
+#include "wumbo/batch.h"
+#include "wumbo/engine.h"
+
+#include <string>
+#include <vector>
+
+#include "check.h"
+
+using namespace wumbo;
+
+static bool is(const std::string& expr, double re, double im) {
+    EvalResult r = evaluate(expr, EvalBudget());
+    return r.status == EVAL_OK && same(r.value.real(), re) && same(r.value.imag(), im);
+}
+
+int main() {
+    CHECK(is("i^2", -1, 0));
+    CHECK(is("(2+i)^3", 2, 11));
+    CHECK(is("(1+i)/(1-i)", 0, 1));
+    CHECK(is("sqrt(0-4+0*i)", 0, 2));
+    CHECK(is("log(0-1+0*i)", 0, std::acos(-1.0)));
+    CHECK(is("abs(3+4*i)", 5, 0));
+    CHECK(is("conj(1+2*i)", 1, -2));
+    CHECK(is("re(3+4*i) + im(3+4*i)", 7, 0));
+    CHECK(is("arg(i)", std::acos(-1.0) / 2, 0));
+    // Without i the same functions stay real.
+    CHECK(std::isnan(evaluate("sqrt(0-4)")));
+    CHECK(evaluate("1/(0*i)", EvalBudget()).status == EVAL_ERROR);
+
+    // The lanes must agree with evaluate(), and give NaN for a result off
+    // the real axis when no imaginary column is asked for.
+    std::vector<std::string> lines;
+    for (int k = 0; k < 50; ++k) {
+        std::string n = std::to_string(k);
+        lines.push_back("(" + n + "+i)^2");
+        lines.push_back("sqrt(" + n + "-25+0*i)");
+        lines.push_back("exp(i*" + n + ")/(1+" + n + "*i)");
+        lines.push_back(n + "*2");
+    }
+    std::vector<double> re(lines.size()), im(lines.size()), realOnly(lines.size());
+    evaluateMany(lines, re.data(), nullptr, im.data());
+    evaluateMany(lines, realOnly.data());
+    for (size_t k = 0; k < lines.size(); ++k) {
+        EvalResult r = evaluate(lines[k], EvalBudget());
+        CHECK(same(re[k], r.value.real()) && same(im[k], r.value.imag()));
+        CHECK(same(realOnly[k], r.value.imag() == 0 ? r.value.real() : NAN));
+    }
+    return checkResult();
+}
@@ -0,0 +1,100 @@
+// Compressed batch files (user-096): frames compressed apart concatenate
+// into a file that reads back whole, with one thread or several, and
+// damaged input is an error rather than wrong text.
+
+#include "wumbo/compress.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "check.h"
+
+using namespace wumbo;
+
+static std::string lines(size_t n) {
+    std::string s;
+    for (size_t i = 0; i < n; ++i) s += std::to_string(i * 7919 % 10007) + " * (2 + " + std::to_string(i) + ")\n";
+    return s;
+}
+
+// A file holding data that is removed once opened.
+static int fileOf(const std::string& data) {
+    char path[] = "/tmp/wumbo_compress_XXXXXX";
+    int fd = mkstemp(path);
+    unlink(path);
+    if (fd < 0 || write(fd, data.data(), data.size()) != (ssize_t)data.size()) return -1;
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+// Reads the file back through a DecompressingReader; false with why set on
+// an error.
+static bool readBack(const std::string& file, size_t blockBytes, unsigned threads, std::string& all,
+                     std::string* why = nullptr, Codec* codec = nullptr) {
+    int fd = fileOf(file);
+    all.clear();
+    bool ok;
+    {
+        DecompressingReader reader(fd, blockBytes, threads);
+        std::string_view block;
+        while ((ok = reader.next(block)) && !block.empty()) all.append(block);
+        if (why) *why = reader.error();
+        if (codec) *codec = reader.codec();
+        if (ok && reader.consumed() != file.size()) ok = false;
+    }
+    close(fd);
+    return ok;
+}
+
+int main() {
+    CHECK(codecForName("in.txt.gz") == CODEC_GZIP && codecForName("in.zst") == CODEC_ZSTD &&
+          codecForName("in.txt") == CODEC_NONE && codecForName("gz") == CODEC_NONE);
+    CHECK(std::string(codecExtension(CODEC_GZIP)) == ".gz" && std::string(codecExtension(CODEC_ZSTD)) == ".zst");
+
+    std::string text = lines(200000), all;
+    CHECK(readBack(text, 4096, 4, all) && all == text);
+    CHECK(readBack("", 4096, 4, all) && all.empty());
+
+    for (Codec codec : {CODEC_GZIP, CODEC_ZSTD}) {
+        // Frames of uneven sizes, as the batch writer makes them.
+        std::string file;
+        for (size_t at = 0, step = 1; at < text.size(); at += step, step = step * 3 + 1000)
+            CHECK(compressFrame(codec, std::string_view(text).substr(at, step), file));
+        CHECK(file.size() < text.size() / 2);
+        Codec seen = CODEC_NONE;
+        for (unsigned threads : {1u, 2u, 8u})
+            for (size_t blockBytes : {(size_t)1000, (size_t)1 << 20}) {
+                CHECK(readBack(file, blockBytes, threads, all, nullptr, &seen) && all == text);
+                CHECK(seen == codec);
+            }
+        std::string empty;
+        CHECK(compressFrame(codec, "", empty) && readBack(empty, 4096, 2, all) && all.empty());
+
+        // A damaged frame, or a file cut short, is reported.
+        std::string why, damaged = file;
+        for (size_t i = damaged.size() / 2; i < damaged.size() / 2 + 64; ++i) damaged[i] ^= 0x5a;
+        CHECK(!readBack(damaged, 4096, 4, all, &why) && !why.empty());
+        CHECK(!readBack(file.substr(0, file.size() - 5), 4096, 4, all, &why) && !why.empty());
+    }
+
+    // A gzip stream from elsewhere has no BGZF lengths and is inflated as it
+    // arrives.
+    char path[] = "/tmp/wumbo_gzip_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0 && write(fd, text.data(), text.size()) == (ssize_t)text.size() &&
+        system(("gzip -c " + std::string(path) + " > " + path + ".gz 2>/dev/null").c_str()) == 0) {
+        int gz = open((std::string(path) + ".gz").c_str(), O_RDONLY);
+        std::string file(lseek(gz, 0, SEEK_END), 0);
+        CHECK(pread(gz, file.data(), file.size(), 0) == (ssize_t)file.size());
+        close(gz);
+        CHECK(readBack(file, 1000, 4, all) && all == text);
+        CHECK(!readBack(file.substr(0, file.size() / 2), 1000, 4, all));
+    }
+    if (fd >= 0) close(fd);
+    unlink(path);
+    unlink((std::string(path) + ".gz").c_str());
+    return checkResult();
+}
@@ -0,0 +1,48 @@
+// Digit windows of huge integers (user-091): every window read off the limbs
+// against the same digits cut from the whole decimal string.
+
+#include "wumbo/bigint.h"
+
+#include <string>
+
+#include "check.h"
+
+using namespace wumbo;
+
+// Whether every window of x, at a spread of offsets and lengths, matches the
+// magnitude's decimal string.
+static bool windowsMatch(const BigInt& x) {
+    std::string all = x.abs().toString();
+    size_t n = all.size();
+    if (x.digits() != n) return false;
+    for (size_t count : {1ul, 8ul, 9ul, 10ul, 100ul, n}) {
+        for (size_t from = 0; from < n + 2; from += from < 40 ? 1 : n / 17 + 1) {
+            std::string want = from < n ? all.substr(from, count) : "";
+            if (x.digitWindow(from, count) != want) return false;
+        }
+        if (x.digitWindow(n - 1, count) != all.substr(n - 1)) return false;
+    }
+    return true;
+}
+
+int main() {
+    CHECK(BigInt().digits() == 1 && BigInt().digitWindow(0, 5) == "0" && BigInt().digitWindow(1, 5) == "");
+    CHECK(windowsMatch(BigInt(7)));
+    CHECK(windowsMatch(BigInt(123456789, true)));
+    CHECK(windowsMatch(BigInt(1000000000)));
+    CHECK(windowsMatch(BigInt((unsigned __int128)1 << 127)));
+
+    // Powers of ten put the zeros, and the leading limb, on either side of
+    // every limb boundary.
+    BigInt p(1);
+    for (int k = 0; k < 40; ++k, p = p * BigInt(10)) CHECK(windowsMatch(p) && p.digits() == (size_t)k + 1);
+
+    // A number too long to format for display, read from both ends.
+    BigInt huge(1);
+    for (int k = 0; k < 20; ++k) huge = huge * huge * BigInt(3);
+    CHECK(huge.digits() > 400000);
+    CHECK(windowsMatch(huge));
+    CHECK(windowsMatch(-huge));
+    CHECK(huge.digitWindow(0, 0) == "" && huge.digitWindow(huge.digits(), 10) == "");
+    return checkResult();
+}
@@ -0,0 +1,49 @@
+#!/bin/sh
+# Expression files (user-078), through the batch job a dropped file starts:
+# a file of several chunks comes out line for line in input order, blank
+# and CRLF lines included, files queue one after another, and a missing
+# file is reported.
+# Usage: dropped_test.sh CALCULATOR
+
+calc=$1
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+fail=0
+
+# About 5 MiB, so lines straddle the 1 MiB chunk boundaries.
+awk 'BEGIN {
+    for (i = 0; i < 400000; i++) {
+        if (i % 1000 == 0) print "";
+        else if (i % 777 == 0) printf "%d - 1\r\n", i;
+        else print i " * 2";
+    }
+    printf "6*7";
+}' > "$dir/big.txt"
+awk 'BEGIN {
+    for (i = 0; i < 400000; i++) {
+        if (i % 1000 == 0) print "";
+        else if (i % 777 == 0) print i - 1;
+        else print i * 2;
+    }
+    print 42;
+}' > "$dir/want"
+printf '1/0\nnope(\n2^0.5\n' > "$dir/small.txt"
+: > "$dir/empty.txt"
+
+"$calc" --batch "$dir/big.txt" --batch "$dir/small.txt" --batch "$dir/empty.txt" 2> "$dir/log" ||
+    { echo "batch run failed"; cat "$dir/log"; fail=1; }
+cmp -s "$dir/big.txt.out" "$dir/want" || { echo "big.txt.out differs"; fail=1; }
+[ "$(cat "$dir/small.txt.out")" = "$(printf 'error\nerror\n1.4142135623730951')" ] ||
+    { echo "small.txt.out is wrong"; fail=1; }
+[ -e "$dir/empty.txt.out" ] && [ ! -s "$dir/empty.txt.out" ] || { echo "empty.txt.out is missing or not empty"; fail=1; }
+grep -q "big.txt: 400001 lines -> $dir/big.txt.out" "$dir/log" || { echo "no report for big.txt"; fail=1; }
+grep -q "empty.txt: 0 lines" "$dir/log" || { echo "no report for empty.txt"; fail=1; }
+
+if "$calc" --batch "$dir/missing.txt" 2> "$dir/log"; then
+    echo "a missing file was accepted"
+    fail=1
+fi
+grep -q "missing.txt failed" "$dir/log" || { echo "no failure reported for a missing file"; fail=1; }
+[ -e "$dir/missing.txt.out" ] && { echo "output created for a missing file"; fail=1; }
+
+exit $fail
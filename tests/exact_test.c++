@@ -0,0 +1,66 @@
+// Exact reals (user-090): digits on demand against known expansions, exact
+// decimal literals, and failures where a value cannot be decided.
+
+#include "wumbo/engine.h"
+#include "wumbo/exact.h"
+
+#include <cmath>
+#include <string>
+
+#include "check.h"
+
+using namespace wumbo;
+
+static const char* const sqrt2 =
+    "1.414213562373095048801688724209698078569671875376948073176679737990732478462107038850387534327641572";
+static const char* const e =
+    "2.718281828459045235360287471352662497757247093699959574966967627724076630353547594571382178525166427";
+
+// Whether x to digits significant digits is within a unit in the last place
+// of expected, which holds the digits truncated. Trailing zeros are dropped
+// when formatting, so they are put back here.
+static bool digitsOf(const ExactReal& x, int digits, const std::string& expected) {
+    std::string s;
+    if (!x.format(digits, s) || s.size() > expected.size()) return false;
+    s.resize(expected.size(), '0');
+    size_t n = s.size() - 6;
+    return s.compare(0, n, expected, 0, n) == 0 &&
+           std::abs(std::stol(s.substr(n)) - std::stol(expected.substr(n))) <= 1;
+}
+
+static std::string text(const std::string& expr) {
+    EvalResult r = evaluate(expr, EvalBudget());
+    return r.status == EVAL_OK ? formatValue(r.value, 30) : "error";
+}
+
+int main() {
+    ExactReal two = ExactReal::fromDouble(2), one = ExactReal::fromDouble(1);
+    for (int d : {17, 40, 100}) {
+        CHECK(digitsOf(exactSqrt(two), d, std::string(sqrt2, d + 1)));
+        CHECK(digitsOf(exactExp(one), d, std::string(e, d + 1)));
+    }
+    // Asking for fewer digits after more, and more again, refines the same
+    // value.
+    ExactReal r = exactSqrt(two) * exactExp(one);
+    std::string a, b, c;
+    CHECK(r.format(80, a) && r.format(20, b) && r.format(120, c));
+    CHECK(a.compare(0, 70, c, 0, 70) == 0 && b.compare(0, 19, a, 0, 19) == 0);
+
+    std::string s;
+    CHECK((ExactReal::fromDouble(0.1) * ExactReal::fromDouble(3)).format(30, s) && s == "0.3");
+    CHECK((one / ExactReal::fromDouble(3)).format(10, s) && s == "0.3333333333");
+    CHECK(exactPow(two, -10).format(20, s) && s == "0.0009765625");
+    CHECK(exactLog(ExactReal::fromDouble(1e-300)).format(12, s) && s == "-690.775527898");
+    CHECK(!exactLog(-two).format(10, s));
+    CHECK(!exactSqrt(-two).format(10, s));
+    CHECK(!(one / (exactSqrt(two) * exactSqrt(two) - two)).format(10, s));
+    CHECK(std::isnan((one / (exactSqrt(two) * exactSqrt(two) - two)).toDouble()));
+    long n = 0;
+    CHECK(ExactReal(BigInt(42), 3).wholeConstant(n) && n == 42000);
+
+    CHECK(text("exact(0.1) + exact(0.2) - exact(0.3)") == "0");
+    CHECK(text("exact(sqrt(2))^2") == "2");
+    CHECK(text("exact(1)/3*3") == "1");
+    CHECK(text("log(exact(0) - 1)") == "error");
+    return checkResult();
+}
@@ -0,0 +1,11 @@
+/* A plugin for plugin_test whose init fails after registering a function,
+ * which stays usable. */
+
+#include "wumbo/plugin.h"
+
+static double half(double x) { return x / 2; }
+
+int wumbo_plugin_init(const wumbo_plugin_api* api) {
+    api->register_function(api->context, "half", 1, (wumbo_fn)half, 0);
+    return 1;
+}
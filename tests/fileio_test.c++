@@ -0,0 +1,84 @@
+// Block reads and writes with requests in flight (user-095): files come
+// back as written, and readers and writers dropped with requests still
+// outstanding wait for them rather than leaving the kernel their buffers.
+
+#include "wumbo/fileio.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "check.h"
+
+using namespace wumbo;
+
+static std::string pattern(size_t n) {
+    std::string s(n, 0);
+    for (size_t i = 0; i < n; ++i) s[i] = (char)('a' + i * 7 % 26);
+    return s;
+}
+
+static std::string readAll(int fd, size_t blockBytes) {
+    BlockReader reader(fd, blockBytes);
+    std::string all;
+    std::string_view block;
+    while (reader.next(block) && !block.empty()) all.append(block);
+    return all;
+}
+
+int main() {
+    // Gives up instead of hanging if a cancelled read is never completed.
+    alarm(60);
+    char path[] = "/tmp/wumbo_fileio_XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    unlink(path);
+
+    std::string text = pattern(5 * 1000 * 1000 + 17);
+    {
+        BlockWriter writer(fd, 4);
+        for (size_t at = 0; at < text.size(); at += 65537) CHECK(writer.write(text.substr(at, 65537)));
+        CHECK(writer.flush());
+    }
+    CHECK(lseek(fd, 0, SEEK_CUR) == (off_t)text.size());
+    lseek(fd, 0, SEEK_SET);
+    CHECK(readAll(fd, 1 << 16) == text);
+    lseek(fd, 0, SEEK_SET);
+    CHECK(readAll(fd, 1000) == text);
+
+    // Dropped after one block, with the next ones still being read.
+    for (int i = 0; i < 100; ++i) {
+        lseek(fd, 0, SEEK_SET);
+        BlockReader reader(fd, 4096, 8);
+        std::string_view block;
+        CHECK(reader.next(block) && block == std::string_view(text).substr(0, 4096));
+    }
+
+    // A pipe with nothing more to read leaves a read blocked in the kernel,
+    // which the reader has to cancel before it can go.
+    int p[2];
+    CHECK(pipe(p) == 0);
+    CHECK(write(p[1], "1+1\n", 4) == 4);
+    {
+        BlockReader reader(p[0], 4096);
+        std::string_view block;
+        CHECK(reader.next(block) && block == "1+1\n");
+    }
+    close(p[0]);
+    close(p[1]);
+
+    // Writes to a pipe nobody reads fail, and flush reports it.
+    CHECK(pipe(p) == 0);
+    close(p[0]);
+    signal(SIGPIPE, SIG_IGN);
+    {
+        BlockWriter writer(p[1]);
+        writer.write("2+2\n");
+        CHECK(!writer.flush());
+    }
+    close(p[1]);
+    close(fd);
+    return checkResult();
+}
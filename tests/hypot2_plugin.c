@@ -0,0 +1,27 @@
+/* A plugin for plugin_test: hypot2 with a batch entry point that counts its
+ * calls, which batchcalls() returns, and cube with only a scalar one. */
+
+#include "wumbo/plugin.h"
+
+static long batchCalls = 0;
+
+static double hypot2(double a, double b) { return a * a + b * b; }
+
+static void hypot2_n(const double* a, const double* b, double* out, size_t n) {
+    __atomic_add_fetch(&batchCalls, 1, __ATOMIC_RELAXED);
+    for (size_t i = 0; i < n; ++i) out[i] = a[i] * a[i] + b[i] * b[i];
+}
+
+static double batchcalls(void) { return (double)__atomic_load_n(&batchCalls, __ATOMIC_RELAXED); }
+
+static double cube(double x) { return x * x * x; }
+
+int wumbo_plugin_init(const wumbo_plugin_api* api) {
+    if (api->abi_version != WUMBO_PLUGIN_ABI_VERSION) return 1;
+    /* Built-ins cannot be replaced. */
+    if (api->register_function(api->context, "sqrt", 1, (wumbo_fn)cube, 0) == 0) return 1;
+    if (api->register_function(api->context, "toomany", WUMBO_MAX_ARITY + 1, (wumbo_fn)cube, 0) == 0) return 1;
+    return api->register_function(api->context, "hypot2", 2, (wumbo_fn)hypot2, (wumbo_fn)hypot2_n) ||
+           api->register_function(api->context, "batchcalls", 0, (wumbo_fn)batchcalls, 0) ||
+           api->register_function(api->context, "cube", 1, (wumbo_fn)cube, 0);
+}
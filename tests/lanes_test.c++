@@ -0,0 +1,59 @@
+// evaluateMany (user-081) against evaluate() one line at a time: the lane
+// interpreter, and the literals taken from each line's text, must give the
+// same bits for every line, whatever it is grouped with.
+
+#include "wumbo/batch.h"
+#include "wumbo/engine.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "check.h"
+
+using namespace wumbo;
+
+// A random expression over a few shapes, so that lanes fill up.
+static std::string randomExpr(std::mt19937& rng, int depth) {
+    static const char* const numbers[] = {"0", "1", "2", "3.5", "0.1", "10", "1e300", "7"};
+    static const char* const ops[] = {"+", "-", "*", "/", "^"};
+    static const char* const functions[] = {"sqrt", "exp", "log", "abs"};
+    int pick = depth > 0 ? (int)(rng() % 4) : 0;
+    if (pick == 0) return numbers[rng() % 8];
+    if (pick == 1) return std::string(functions[rng() % 4]) + "(" + randomExpr(rng, depth - 1) + ")";
+    if (pick == 2) return "(" + randomExpr(rng, depth - 1) + ")";
+    return randomExpr(rng, depth - 1) + ops[rng() % 5] + randomExpr(rng, depth - 1);
+}
+
+static void matchesOneByOne(const std::vector<std::string>& lines) {
+    std::vector<double> out(lines.size());
+    evaluateMany(lines, out.data());
+    for (size_t i = 0; i < lines.size(); ++i) {
+        double one = evaluate(lines[i]);
+        if (!same(out[i], one)) std::fprintf(stderr, "%s: %.17g in a batch, %.17g alone\n", lines[i].c_str(), out[i], one);
+        CHECK(same(out[i], one));
+    }
+}
+
+int main() {
+    std::mt19937 rng(81);
+    std::vector<std::string> lines;
+    for (int i = 0; i < 5000; ++i) lines.push_back(randomExpr(rng, 3));
+    matchesOneByOne(lines);
+
+    // Groups that are not a multiple of the lane width, and lines in error
+    // among good ones.
+    matchesOneByOne({"1+2", "3+4", "5+6", "1/0", "(1+", "", "2^0.5", "sqrt(0-1)", "1+2*3", "9+9", "7+"});
+    std::vector<std::string> one{"40+2"};
+    matchesOneByOne(one);
+    matchesOneByOne({});
+
+    // Lines of one shape with their literals written every way (user-082):
+    // integers past 2^53 and 2^64 must round as strtod does, and redundant
+    // parentheses or spacing must not change a line's value.
+    matchesOneByOne({"1+2", "1.5+2", ".5+2", "1.+2", "1e3+2", "1E-3+2", "0.1+0.2", "9007199254740993+0",
+                     "18446744073709551615+0", "18446744073709551617+0", "99999999999999999999999+1",
+                     "000000000000000000000000012+1", "1e400+1", "1e-400+1", "2.5e+2+1"});
+    matchesOneByOne({"(1)+2", "((3))+4", "(5+6)", " 7 +  8 ", "((9+10))", "1+(2)", "1-(2-3)", "1-2-3"});
+    return checkResult();
+}
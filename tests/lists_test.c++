@@ -0,0 +1,63 @@
+// List values (user-085): element-wise arithmetic, fft and ifft, and conv,
+// which must stay exact for integer lists.
+
+#include "wumbo/engine.h"
+
+#include <string>
+#include <vector>
+
+#include "check.h"
+
+using namespace wumbo;
+
+static Value value(const std::string& expr) {
+    EvalResult r = evaluate(expr, EvalBudget());
+    CHECK(r.status == EVAL_OK);
+    return r.value;
+}
+
+static std::string text(const std::string& expr) {
+    return formatValue(value(expr), 17);
+}
+
+int main() {
+    CHECK(text("[1,2]+[3,4]") == "[4, 6]");
+    CHECK(text("[1,2]*2") == "[2, 4]");
+    CHECK(text("[1,[2,3]]") == "[1, [2, 3]]");
+    CHECK(text("[]") == "[]");
+    CHECK(text("len([]) + len(range(7))") == "7");
+    CHECK(text("sum(range(101))") == "5050");
+    CHECK(text("conv([1,2],[1,3])") == "[1, 5, 6]");
+    CHECK(text("fft([1,0,0,0])") == "[1, 1, 1, 1]");
+    CHECK(text("ifft(fft([1,2,3,4]))") == "[1, 2, 3, 4]");
+
+    // A round trip through fft of a length that is not a power of two.
+    Value back = value("ifft(fft(range(1000)))");
+    CHECK(back.isList() && back.items().size() == 1000);
+    if (back.isList())
+        for (size_t k = 0; k < back.items().size(); ++k) CHECK(std::fabs(back.items()[k].real() - (double)k) < 1e-9);
+
+    // conv of integer lists, long enough to go through transforms, against
+    // the schoolbook sum: products below 2^40 come out exact.
+    const size_t n = 3000;
+    std::string a = "[", b = "[";
+    std::vector<double> x(n), y(n);
+    for (size_t k = 0; k < n; ++k) {
+        x[k] = (double)((k * 7919) % 1009);
+        y[k] = (double)((k * 104729) % 997);
+        a += (k ? "," : "") + std::to_string((long)x[k]);
+        b += (k ? "," : "") + std::to_string((long)y[k]);
+    }
+    Value c = value("conv(" + a + "]," + b + "])");
+    CHECK(c.isList() && c.items().size() == 2 * n - 1);
+    if (c.isList() && c.items().size() == 2 * n - 1)
+        for (size_t k = 0; k < 2 * n - 1; k += 97) {
+            double direct = 0;
+            for (size_t j = k >= n ? k - n + 1 : 0; j <= k && j < n; ++j) direct += x[j] * y[k - j];
+            CHECK(same(c.items()[k].real(), direct));
+        }
+
+    CHECK(evaluate("[1,2]+[1,2,3]", EvalBudget()).status == EVAL_ERROR);
+    CHECK(evaluate("len(5)", EvalBudget()).status == EVAL_ERROR);
+    return checkResult();
+}
@@ -0,0 +1,61 @@
+// Number theory (user-087): isprime, nextprime, primepi, factor and primes
+// against a plain sieve and known values.
+
+#include "wumbo/engine.h"
+
+#include <string>
+#include <vector>
+
+#include "check.h"
+
+using namespace wumbo;
+
+static std::string text(const std::string& expr) {
+    EvalResult r = evaluate(expr, EvalBudget());
+    return r.status == EVAL_OK ? formatValue(r.value, 20) : "error";
+}
+
+int main() {
+    const size_t n = 100000;
+    std::vector<bool> composite(n + 1);
+    composite[0] = composite[1] = true;
+    for (size_t p = 2; p * p <= n; ++p)
+        if (!composite[p])
+            for (size_t q = p * p; q <= n; q += p) composite[q] = true;
+    size_t count = 0;
+    for (size_t k = 0; k <= n; k += 1) {
+        count += !composite[k];
+        if (k % 1009 == 0 || k < 200) {
+            CHECK(same(evaluate("isprime(" + std::to_string(k) + ")"), composite[k] ? 0 : 1));
+            CHECK(same(evaluate("primepi(" + std::to_string(k) + ")"), (double)count));
+        }
+    }
+    CHECK(text("len(primes(1, 100000))") == std::to_string(count));
+
+    CHECK(text("isprime(1000000007)") == "1");
+    CHECK(text("isprime(9007199254740881)") == "1");
+    CHECK(text("isprime(9007199254740881 - 2)") == "0");
+    CHECK(text("isprime(2.5)") == "0");
+    CHECK(text("nextprime(1000000)") == "1000003");
+    CHECK(text("primepi(10^10)") == "455052511");
+    CHECK(text("factor(360)") == "[2, 2, 2, 3, 3, 5]");
+    CHECK(text("factor(600851475143)") == "[71, 839, 1471, 6857]");
+    CHECK(text("primes(10, 30)") == "[11, 13, 17, 19, 23, 29]");
+    CHECK(text("len(primes(1, 10^7))") == "664579");
+    CHECK(text("factor(0)") == "error");
+    CHECK(text("primepi(0-1)") == "0");
+    // Past 2^53 integers are not exact, and past 10^12 primepi is refused.
+    CHECK(text("isprime(2^60)") == "error");
+    CHECK(text("primepi(10^13)") == "error");
+
+    // Every factorisation multiplies back to its number.
+    for (unsigned long long k = 1000000000000ULL; k < 1000000000000ULL + 2000; k += 37) {
+        EvalResult r = evaluate("factor(" + std::to_string(k) + ")", EvalBudget());
+        CHECK(r.value.isList());
+        if (!r.value.isList()) continue;
+        unsigned long long product = 1;
+        for (auto& f : r.value.items()) product *= (unsigned long long)f.real();
+        CHECK(product == k);
+    }
+    return checkResult();
+}
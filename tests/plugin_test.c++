@@ -0,0 +1,44 @@
+// Plugin libraries (user-083): loading a directory of them, calls through
+// scalar and batch entry points, and names a plugin may not take.
+
+#include "wumbo/batch.h"
+#include "wumbo/engine.h"
+#include "wumbo/symbols.h"
+
+#include <string>
+#include <vector>
+
+#include "check.h"
+
+using namespace wumbo;
+
+int main() {
+    SymbolTable symbols;
+    std::vector<std::string> errors;
+    CHECK(symbols.loadPlugins(PLUGIN_DIR, &errors) == 1);
+    CHECK(errors.size() == 1 && errors[0].find("failing_plugin") != std::string::npos);
+    CHECK(symbols.loadPlugins("/nonexistent") == 0);
+    std::string error;
+    CHECK(!symbols.loadPlugin(PLUGIN_DIR "/missing.so", &error) && !error.empty());
+
+    CHECK(same(evaluate("hypot2(3, 4)", &symbols), 25));
+    CHECK(same(evaluate("cube(2) + half(10)", &symbols), 13));
+    CHECK(same(evaluate("sqrt(16)", &symbols), 4));
+    CHECK(std::isnan(evaluate("toomany(1)", &symbols)));
+    CHECK(std::isnan(evaluate("hypot2(3, 4)")));
+    CHECK(symbols.findFunction("hypot2") && !symbols.findFunction("toomany"));
+
+    // Many calls in a batch go through the batch entry point, with the same
+    // results as the scalar one.
+    std::vector<std::string> lines;
+    for (int k = 0; k < 100; ++k) lines.push_back("hypot2(" + std::to_string(k) + ", 0.5) + cube(" + std::to_string(k) + ")");
+    std::vector<double> out(lines.size());
+    evaluateMany(lines, out.data(), &symbols);
+    for (size_t k = 0; k < lines.size(); ++k) CHECK(same(out[k], evaluate(lines[k], &symbols)));
+    CHECK(evaluate("batchcalls()", &symbols) > 0);
+
+    // A function's name cannot be given to a value, nor taken twice.
+    CHECK(!symbols.setValue("cube", Value(1.0)));
+    CHECK(!symbols.addFunction("hypot2", 1, (void (*)(void))+[](double x) { return x; }));
+    return checkResult();
+}
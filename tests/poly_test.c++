@@ -0,0 +1,36 @@
+// Polynomial products that are exact or refused (user-086), and refusals
+// reaching the caller as errors rather than NaN coefficients.
+
+#include "wumbo/engine.h"
+
+#include <string>
+
+#include "check.h"
+
+using namespace wumbo;
+
+static EvalResult run(const std::string& expr) {
+    EvalBudget budget;
+    budget.maxSeconds = 20;
+    budget.maxBytes = 1 << 30;
+    return evaluate(expr, budget);
+}
+
+int main() {
+    // Integer coefficients below 2^53 come out exact, so the second product,
+    // (x^2-1)^20, sums to exactly zero.
+    CHECK(same(run("sum(coeffs((x+1)^40))").value.real(), 1099511627776.0));
+    CHECK(same(run("sum(coeffs(poly_mul((x+1)^20, (x-1)^20)))").value.real(), 0.0));
+
+    // Past the range of doubles the product is refused, not cancelled.
+    CHECK(run("coeffs((x+1)^1100)").status == EVAL_ERROR);
+    CHECK(run("coeffs((x+1)^5000)").status == EVAL_ERROR);
+    CHECK(run("coeffs((x+1)^4000000)").status == EVAL_ERROR);
+
+    // A NaN where a polynomial belongs is an error, not a constant.
+    CHECK(run("coeffs(0/0)").status == EVAL_ERROR);
+    CHECK(run("poly_mul(x+1, 1/0)").status == EVAL_ERROR);
+    CHECK(run("poly_gcd(x^2-1, 0/0)").status == EVAL_ERROR);
+    CHECK(run("coeffs(3)").status == EVAL_OK);
+    return checkResult();
+}
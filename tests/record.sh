@@ -0,0 +1,27 @@
+# Writes recordings for --replay (see EventRecorder in main.c++) to stdout,
+# every event at time 0. Sourced by the *_test.sh scripts.
+
+u32() {
+    printf "$(printf '\\%03o\\%03o\\%03o\\%03o' $(($1 & 255)) $(($1 >> 8 & 255)) $(($1 >> 16 & 255)) $(($1 >> 24 & 255)))"
+}
+
+magic() { printf WUMBOREC; }
+
+# One text event per character, as typing gives.
+type_text() {
+    s=$1
+    while [ -n "$s" ]; do
+        rest=${s#?}
+        u32 0; printf '\003\001%s' "${s%"$rest"}"
+        s=$rest
+    done
+}
+
+key() { u32 0; printf '\002'; u32 "$1"; }
+# A key with Ctrl held, or with the modifiers given (KMOD_LCTRL is 64,
+# KMOD_LSHIFT 1).
+ctrl_key() { u32 0; printf '\004'; u32 "$1"; printf "$(printf '\\%03o' "${2:-64}")\\000"; }
+click() { u32 0; printf '\001\001'; u32 "$1"; u32 "$2"; }
+
+enter() { key 13; }
+clear_input() { click 150 460; }
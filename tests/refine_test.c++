@@ -0,0 +1,61 @@
+// Refining exact results (user-092): doubling the digits keeps the ones
+// already shown, a stop flag abandons a long format from another thread,
+// and the leading digits of huge values come without their integer part.
+
+#include "wumbo/exact.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "check.h"
+
+using namespace wumbo;
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+    ExactReal two = ExactReal::fromDouble(2), three = ExactReal::fromDouble(3);
+
+    // The refiner's steps: each longer text starts with the shorter one, but
+    // for the last digit, which may be one off.
+    ExactReal x = exactLog(three) / exactSqrt(two) + exactExp(two);
+    std::string shown;
+    for (int digits = 17; digits <= 1088; digits *= 2) {
+        std::string s;
+        CHECK(x.format(digits, s));
+        if (!shown.empty()) CHECK(s.compare(0, shown.size() - 1, shown, 0, shown.size() - 1) == 0);
+        shown = s;
+    }
+
+    // Digits already worked out are given back even once stopped; new ones
+    // are not.
+    std::atomic<bool> stop{true};
+    std::string s;
+    CHECK(x.format(17, s, &stop) && s.compare(0, 16, shown, 0, 16) == 0);
+    CHECK(!exactLog(two + three).format(17, s, &stop));
+
+    // Twenty thousand digits of this take many seconds; setting the flag
+    // gives up within moments.
+    stop = false;
+    auto start = std::chrono::steady_clock::now();
+    std::thread setter([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        stop = true;
+    });
+    CHECK(!exactExp(exactSqrt(two)).format(20000, s, &stop));
+    setter.join();
+    CHECK(secondsSince(start) < 5);
+
+    // Leading digits found from magnitude bounds, not from the whole value.
+    start = std::chrono::steady_clock::now();
+    CHECK(exactPow(three, 2000000).format(17, s) && s.compare(0, 16, "3.23176166359831") == 0 &&
+          s.substr(s.find('e')) == "e+954242");
+    CHECK(exactExp(exactPow(ExactReal::fromDouble(10), 3)).format(20, s) &&
+          s.compare(0, 19, "1.97007111401704699") == 0 && s.substr(s.find('e')) == "e+434");
+    CHECK(secondsSince(start) < 10);
+    return checkResult();
+}
@@ -0,0 +1,36 @@
+#!/bin/sh
+# Record and replay (user-076): a headless fast replay feeds one recorded
+# event per frame and reports the frame times, a timed one plays them as
+# recorded, and a file that is not a recording is refused.
+# Usage: replay_test.sh CALCULATOR
+
+calc=$1
+. "$(dirname "$0")/record.sh"
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+fail=0
+
+# 2+3*4, =, a click on C, then the buttons 7 and ^, and Backspace.
+{ magic; type_text "2+3*4"; enter; clear_input; click 50 310; click 330 450; key 8; } > "$dir/rec"
+events=10
+
+out=$("$calc" --headless --replay "$dir/rec" --replay-fast) || { echo "fast replay failed"; fail=1; }
+echo "$out" | grep -q "^frames: $events " || { echo "fast replay: expected $events frames: $out"; fail=1; }
+out=$("$calc" --headless --replay "$dir/rec") || { echo "timed replay failed"; fail=1; }
+echo "$out" | grep -q "^frames: [0-9]" || { echo "timed replay: no frame stats: $out"; fail=1; }
+
+# A recording cut off inside an event replays the events before it.
+head -c $(($(wc -c < "$dir/rec") - 3)) "$dir/rec" > "$dir/cut"
+out=$("$calc" --headless --replay "$dir/cut" --replay-fast) || { echo "cut replay failed"; fail=1; }
+echo "$out" | grep -q "^frames: $((events - 1)) " || { echo "cut replay: expected $((events - 1)) frames: $out"; fail=1; }
+
+for bad in "" "WUMBOREC" "not a recording"; do
+    printf '%s' "$bad" > "$dir/bad"
+    if "$calc" --headless --replay "$dir/bad" --replay-fast > /dev/null 2>&1; then
+        echo "replaying '$bad' was accepted"
+        fail=1
+    fi
+done
+"$calc" --replay > /dev/null 2>&1 && { echo "--replay without a file was accepted"; fail=1; }
+
+exit $fail
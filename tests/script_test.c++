@@ -0,0 +1,59 @@
+// Scripts (user-094): loops, functions and their values, and every failed
+// compilation coming with a message.
+
+#include "wumbo/script.h"
+
+#include <string>
+
+#include "check.h"
+
+using namespace wumbo;
+
+static double value(const std::string& source) {
+    std::string error;
+    EvalResult r = evaluateScript(source, EvalBudget(), nullptr, &error);
+    if (!error.empty()) std::fprintf(stderr, "%s: %s\n", source.c_str(), error.c_str());
+    return r.status == EVAL_OK ? r.value.real() : NAN;
+}
+
+// The message a script that does not compile gives, or "" if it does.
+static std::string problem(const std::string& source) {
+    Script script;
+    std::string error;
+    bool ok = compileScript(source, script, nullptr, &error);
+    CHECK(ok == error.empty());
+    return error;
+}
+
+int main() {
+    CHECK(same(value("s = 0\nfor k = 1, 1000 { s = s + k }\ns"), 500500));
+    CHECK(same(value("s = 0; for k = 10, 1, -3 { s = s + k }; s"), 22));
+    CHECK(same(value("def f(n) { if n < 2 { return n } return f(n - 1) + f(n - 2) }\nf(20)"), 6765));
+    CHECK(same(value("s = 1; while s < 1000 { s = s * 2 }"), 1024));
+    CHECK(same(value("if 0 { 1 } else if 1 { 2 } else { 3 }"), 2));
+    CHECK(same(value("x = 3; i = 4; sqrt(x^2 + i^2)"), 5));
+    CHECK(same(value("a = 1 < 2 and not 3 < 2; a"), 1));
+
+    // Loops with nothing in them run, and a script needs something to give
+    // its value.
+    CHECK(same(value("for k = 1, 3 { }; k"), 4));
+    CHECK(same(value("while 0 { }\n7"), 7));
+    CHECK(problem("for k = 1, 3 { }") != "");
+    CHECK(problem("while 0 { }") != "");
+    CHECK(problem("def f(n) { return n }") != "");
+
+    CHECK(problem("for k = 1 { }") != "");
+    CHECK(problem("s = (1 + 2") != "");
+    CHECK(problem("else { 1 }") != "");
+    CHECK(problem("1 < 2 < 3") != "");
+    CHECK(problem("def f(a, a) { a }\nf(1, 2)") != "");
+    CHECK(problem("undefined + 1") != "");
+    CHECK(problem("sqrt(1, 2)") != "");
+
+    // A loop that never ends is stopped by the budget.
+    EvalBudget budget;
+    budget.maxSeconds = 0.1;
+    EvalResult r = evaluateScript("s = 0; while 1 { s = s + 1 }", budget);
+    CHECK(r.status == EVAL_TIMEOUT);
+    return checkResult();
+}
@@ -0,0 +1,59 @@
+// Costly batch lines (user-098): estimateCost tells ordinary lines from ones
+// that could hold up a chunk, evaluateMany stops those when its guard says
+// so, and the slow pool's threads can be deprioritized on their own.
+
+#include "wumbo/batch.h"
+#include "wumbo/engine.h"
+#include "wumbo/topology.h"
+
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+#include "check.h"
+
+using namespace wumbo;
+
+int main() {
+    for (const char* line : {"1+2*3", "sqrt(2)^2 + sin(1)", "((((((1))))))", "2^1000000", "20!", "exact(10)^10",
+                             "exact(1.23456789012345678901234567)", "sum(range(100))", "factor(1e6)"})
+        CHECK(estimateCost(line) < slowCost);
+    for (const char* line : {"100000!", "x!", "len(range(1e7))", "sum(primes(1e6))", "factor(1e20)",
+                             "exact(3)^100000", "exact(2)^(2^20)", "exact(2)^3^4"})
+        CHECK(estimateCost(line) > slowCost);
+    // Longer and deeper lines cost more.
+    CHECK(estimateCost("1+1") < estimateCost("1+1+1+1") && estimateCost("1+1") < estimateCost("((1+1))"));
+    CHECK(estimateCost("20!") < estimateCost("2000!"));
+
+    // A guard stops the lines evaluated one at a time; lanes finish anyway.
+    std::vector<std::string> lines = {"1+2", "len(range(1e7))", "3*4", "sum([1, 2])"};
+    std::vector<double> out(lines.size());
+    EvalResult result;
+    EvalBudget budget;
+    budget.progress = [](const char*, size_t, size_t) { return false; };
+    BudgetGuard guard(budget, result);
+    evaluateMany(lines, out.data(), nullptr, nullptr, &guard);
+    CHECK(out[0] == 3 && std::isnan(out[1]) && out[2] == 12);
+    evaluateMany(lines, out.data());
+    CHECK(out[0] == 3 && out[1] == 1e7 && out[2] == 12 && out[3] == 3);
+
+#ifdef __linux__
+    // Only the thread that asks is deprioritized.
+    int before = getpriority(PRIO_PROCESS, 0), lowered = before;
+    bool ok = false;
+    std::thread slow([&] {
+        ok = lowerThreadPriority();
+        lowered = getpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid));
+    });
+    slow.join();
+    CHECK(ok && lowered > before && getpriority(PRIO_PROCESS, 0) == before);
+#endif
+    return checkResult();
+}
@@ -0,0 +1,40 @@
+#!/bin/sh
+# Tabs (user-100), driven by a replayed recording: each tab keeps its own
+# result, ans follows the selected tab, and opening past the limit or
+# closing the last tab does nothing. fft(range(ans)) is over the
+# calculator's budget for ans = 16000000, which it reports, and costs
+# nothing for ans = 1, so the report count shows which ans was used.
+# Usage: tabs_test.sh CALCULATOR
+
+calc=$1
+. "$(dirname "$0")/record.sh"
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+fail=0
+
+probe() { clear_input; type_text "fft(range(ans))"; enter; }
+
+{
+    magic
+    type_text 16000000; enter
+    ctrl_key 116; type_text 1; enter
+    ctrl_key 9; probe # tab 1
+    ctrl_key 9; probe # tab 2
+    ctrl_key 9 65; probe # tab 1, by Ctrl+Shift+Tab
+    ctrl_key 119; probe # tab 1 closed, so tab 2
+    i=0
+    while [ $i -lt 25 ]; do ctrl_key 116; i=$((i + 1)); done
+    click 300 20; probe # one of the new tabs, with no result yet
+    i=0
+    while [ $i -lt 25 ]; do ctrl_key 119; i=$((i + 1)); done
+    probe # tab 2, the only one left
+    click 100 20; probe # the + slot
+    click 40 20; probe # back to tab 2
+} > "$dir/rec"
+
+"$calc" --headless --replay "$dir/rec" --replay-fast > "$dir/out" 2> "$dir/log" || { echo "replay failed"; fail=1; }
+grep -q "^frames: " "$dir/out" || { echo "replay did not finish"; fail=1; }
+n=$(grep -c "evaluation stopped" "$dir/log")
+[ "$n" -eq 2 ] || { echo "expected 2 evaluations over budget, got $n"; cat "$dir/log"; fail=1; }
+
+exit $fail
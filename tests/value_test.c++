@@ -0,0 +1,58 @@
+// The packed Value (user-089): sixteen bytes, integers inline below 2^111,
+// every kind telling itself apart from the others, and shared blocks
+// counted correctly across copies and threads.
+
+#include "wumbo/value.h"
+
+#include <thread>
+#include <vector>
+
+#include "check.h"
+
+using namespace wumbo;
+
+static_assert(sizeof(Value) == 16);
+
+int main() {
+    CHECK(Value(2.5).isReal() && same(Value(2.5).real(), 2.5) && same(Value(2.5).imag(), 0));
+    CHECK(Value(-0.0).isReal() && same(Value(-0.0).real(), -0.0));
+    CHECK(Value(INFINITY).isReal() && !Value(INFINITY).isError());
+    CHECK(Value().isError() && Value(NAN).isReal());
+    Value z(std::complex<double>(1, -2));
+    CHECK(z.isComplex() && same(z.real(), 1) && same(z.imag(), -2) && std::isnan(z.toDouble()));
+    CHECK(Value(std::complex<double>(1, NAN)).isError());
+    CHECK(Value(std::complex<double>(-NAN, -NAN)).isError() && !Value(std::complex<double>(-NAN, -NAN)).isList());
+
+    // Integers: exact doubles stay doubles, then inline up to 2^111, then on
+    // the heap.
+    __int128 two53 = (__int128)1 << 53, two111 = (__int128)1 << 111;
+    CHECK(Value::integer(two53 - 1).isReal());
+    for (__int128 n : {two53 + 1, -(two53 + 1), two111 - 1, -(two111 - 1), two111, -two111, two111 * 4 + 3}) {
+        Value v = Value::integer(n);
+        __int128 back = 0;
+        CHECK(v.isInteger() && v.smallInteger(back) == (n < two111 && n > -two111));
+        if (n < two111 && n > -two111) CHECK(back == n && v.heapBytes() == 0);
+        else CHECK(v.heapBytes() > 0);
+        CHECK(same(v.real(), (double)n) && v.bigInt().negative() == (n < 0));
+        Value copy = v;
+        CHECK(copy.bigInt().toString() == v.bigInt().toString());
+    }
+
+    // Lists, polynomials and exact reals shared between copies; every copy
+    // released on other threads at once.
+    Value list(std::vector<Value>{1.0, Value::integer(two111), Value::poly({1, 2, 3}), std::vector<Value>{}});
+    CHECK(list.isList() && list.items().size() == 4 && list.items()[2].isPoly() && list.items()[3].isList());
+    CHECK(std::isnan(list.real()) && !list.isError());
+    CHECK(Value::poly({5}).isReal() && same(Value::poly({5}).real(), 5));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t)
+        threads.emplace_back([list] {
+            for (int k = 0; k < 10000; ++k) {
+                Value a = list, b = std::move(a);
+                a = b;
+            }
+        });
+    for (auto& t : threads) t.join();
+    CHECK(list.items().size() == 4 && list.items()[1].bigInt().toString() == "2596148429267413814265248164610048");
+    return checkResult();
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+// Awaitable evaluation for C++20 callers:
+//
+//   EvalResult r = co_await wumbo::evaluateAsync("2^64", &symbols);
+//   std::vector<double> v = co_await wumbo::evaluateManyAsync(lines, &symbols, post);
+//
+// co_await queues the work on the shared WorkerPool and suspends the
+// coroutine, so a caller can have any number of evaluations outstanding
+// without a thread blocked on each. When the work is done the coroutine is
+// resumed through the executor given, which should hand the task to the
+// caller's thread or event loop; without one it resumes on the pool thread.
+// The engine itself stays C++17, and this header is empty where coroutines
+// are not available.
+
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "engine.h"
+#include "batch.h"
+#include "pool.h"
+
+namespace wumbo {
+
+// Runs the task it is given where the awaiting coroutine should continue.
+using Executor = std::function<void(std::function<void()>)>;
+
+// Awaiting an Evaluation runs work on the pool once and gives back its
+// result, or rethrows what it threw.
+template <typename T>
+class Evaluation {
+public:
+    Evaluation(std::function<T()> work, Executor executor)
+        : work(std::move(work)), executor(std::move(executor)) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    // The awaitable lives in the suspended coroutine's frame, so the pool
+    // thread can fill it in before resuming. Once the resume is handed off
+    // the coroutine may run on, and destroy the awaitable, at any moment, so
+    // the executor is moved out first and nothing of this is touched after.
+    void await_suspend(std::coroutine_handle<> caller) {
+        WorkerPool::shared().submit([this, caller] {
+            try {
+                result = work();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            Executor resumeOn = std::move(executor);
+            if (resumeOn) resumeOn([caller] { caller.resume(); });
+            else caller.resume();
+        });
+    }
+
+    T await_resume() {
+        if (error) std::rethrow_exception(error);
+        return std::move(result);
+    }
+
+private:
+    std::function<T()> work;
+    Executor executor;
+    T result{};
+    std::exception_ptr error;
+};
+
+// evaluate() with a budget, which may stop the work early.
+inline Evaluation<EvalResult> evaluateAsync(std::string expr, const SymbolTable* symbols = nullptr,
+                                            Executor executor = {}, EvalBudget budget = {}) {
+    return Evaluation<EvalResult>(
+        [expr = std::move(expr), symbols, budget = std::move(budget)] { return evaluate(expr, budget, symbols); },
+        std::move(executor));
+}
+
+// evaluateMany() over any range of strings, whose values are copied when
+// the call is made; NaN marks a line in error.
+template <typename Range>
+Evaluation<std::vector<double>> evaluateManyAsync(const Range& exprs, const SymbolTable* symbols = nullptr,
+                                                  Executor executor = {}) {
+    std::vector<std::string> lines;
+    for (const auto& e : exprs) lines.emplace_back(e);
+    return Evaluation<std::vector<double>>(
+        [lines = std::move(lines), symbols] {
+            std::vector<double> out(lines.size());
+            evaluateMany(lines, out.data(), symbols);
+            return out;
+        },
+        std::move(executor));
+}
+
+}
+
+#endif
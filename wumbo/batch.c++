@@ -0,0 +1,339 @@
+#include "batch.h"
+#include "engine.h"
+
+#include <cmath>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+
+namespace wumbo {
+
+namespace {
+
+struct LaneOp {
+    char op;  // 'n' push, 'j' imaginary push, 'f' call, otherwise the operator
+    const Function* fn;
+};
+
+// Expressions of one signature with their literals in reading order. Before
+// running they are transposed push-major with the expression count padded to a
+// multiple of laneWidth: literal k of expression j lands at
+// literals[k * stride + j], so each push loads laneWidth contiguous doubles.
+struct LaneGroup {
+    std::vector<LaneOp> code;
+    size_t pushes = 0, depth = 0;
+    bool complex = false;
+    std::vector<size_t> exprs;
+    std::vector<double> gathered;
+};
+
+// The opcode signature of a postfix program: its pushes, operators and calls
+// without the literal values. key identifies it for grouping: 'n' per push
+// ('j' if imaginary), the operator character, or "f<name>(" per call. Returns false if the
+// program is not wellFormed() or uses lists, polynomials or named values,
+// which lanes cannot hold.
+bool signature(const std::vector<Token>& postfix, std::string& key, LaneGroup& g) {
+    if (!wellFormed(postfix)) return false;
+    size_t sp = 0;
+    for (auto& t : postfix) {
+        if (t.type == LIST || (t.type == NUMBER && (t.op == 'x' || t.op == 'v')) || (t.type == FUNCTION && !t.fn->scalar)) return false;
+        if (t.type == NUMBER) {
+            char op = t.op == 'i' ? 'j' : 'n';
+            key += op;
+            g.code.push_back({op, nullptr});
+            g.complex |= op == 'j';
+            g.pushes++;
+            g.depth = std::max(g.depth, ++sp);
+        } else if (t.type == OPERATOR) {
+            key += t.op;
+            g.code.push_back({t.op, nullptr});
+            sp--;
+        } else if (t.type == FUNCTION) {
+            key += 'f';
+            key += t.fn->name;
+            key += '(';
+            g.code.push_back({'f', t.fn});
+            sp = sp - t.argc + 1;
+            g.depth = std::max(g.depth, sp);
+        }
+    }
+    return true;
+}
+
+// A line's shape is its token stream with every number replaced by '#' (or
+// "#i" for an imaginary literal, "i" alone counting as 1i) and every other
+// identifier followed by a space, read exactly as tokenize() reads it; the numbers go to literals in order. Since
+// shunting-yard emits numbers in input order, the literals are also the push
+// order of the line's postfix program.
+void scanShape(const std::string& expr, std::string& shape, std::vector<double>& literals) {
+    const char* s = expr.c_str();
+    size_t i = 0, n = expr.size();
+    while (i < n) {
+        char c = s[i];
+        if (isdigit((unsigned char)c) || c == '.') {
+            // Plain integers of up to 15 digits are exact in a double and
+            // common enough to skip strtod for.
+            size_t j = i;
+            uint64_t v = 0;
+            while (j < n && j - i < 15 && isdigit((unsigned char)s[j])) v = v * 10 + (s[j++] - '0');
+            char next = j < n ? s[j] : 0;
+            double val;
+            if (j > i && !isdigit((unsigned char)next) && next != '.' && next != 'e' && next != 'E' && next != 'x' && next != 'X') {
+                val = (double)v;
+                i = j;
+            } else {
+                char* end = nullptr;
+                val = strtod(s + i, &end);
+                if (end == s + i) { i++; continue; }
+                i = end - s;
+            }
+            literals.push_back(val);
+            shape += '#';
+            if (i < n && s[i] == 'i' && !(i + 1 < n && (isalnum((unsigned char)s[i + 1]) || s[i + 1] == '_'))) {
+                shape += 'i';
+                i++;
+            }
+        } else if (isalpha((unsigned char)c) || c == '_') {
+            size_t start = i;
+            while (i < n && (isalnum((unsigned char)s[i]) || s[i] == '_')) i++;
+            if (i - start == 1 && c == 'i') {
+                literals.push_back(1);
+                shape += "#i";
+            } else {
+                shape.append(s + start, i - start);
+                shape += ' ';
+            }
+        } else {
+            if (strchr("+-*/^()[],!", c)) shape += c;
+            i++;
+        }
+    }
+}
+
+void runRealLanes(const LaneGroup& g, const double* literals, size_t stride, double* out, double* outImag) {
+    constexpr size_t W = laneWidth;
+    std::vector<double> stack(g.depth * W);
+    for (size_t base = 0; base < g.exprs.size(); base += W) {
+        double* st = stack.data();
+        size_t sp = 0, k = 0;
+        for (auto& [op, fn] : g.code) {
+            if (op == 'n') {
+                const double* src = literals + k++ * stride + base;
+                double* dst = st + sp++ * W;
+                for (size_t l = 0; l < W; ++l) dst[l] = src[l];
+                continue;
+            }
+            if (op == 'f') {
+                const double* args[maxArity];
+                sp -= fn->arity;
+                for (int j = 0; j < fn->arity; ++j) args[j] = st + (sp + j) * W;
+                double result[W];
+                fn->callBatch(args, result, W);
+                double* dst = st + sp++ * W;
+                for (size_t l = 0; l < W; ++l) dst[l] = result[l];
+                continue;
+            }
+            double* a = st + (sp - 2) * W;
+            const double* b = st + (sp - 1) * W;
+            sp--;
+            switch (op) {
+                case '+': for (size_t l = 0; l < W; ++l) a[l] = a[l] + b[l]; break;
+                case '-': for (size_t l = 0; l < W; ++l) a[l] = a[l] - b[l]; break;
+                case '*': for (size_t l = 0; l < W; ++l) a[l] = a[l] * b[l]; break;
+                case '/': for (size_t l = 0; l < W; ++l) a[l] = b[l] != 0 ? a[l] / b[l] : NAN; break;
+                case '^': for (size_t l = 0; l < W; ++l) a[l] = pow(a[l], b[l]); break;
+                default: for (size_t l = 0; l < W; ++l) a[l] = NAN; break;
+            }
+        }
+        size_t n = std::min(W, g.exprs.size() - base);
+        for (size_t l = 0; l < n; ++l) {
+            out[g.exprs[base + l]] = st[l];
+            if (outImag) outImag[g.exprs[base + l]] = 0;
+        }
+    }
+}
+
+// Complex-mode groups keep the stack as separate real and imaginary columns,
+// so + - * / stay elementwise over contiguous doubles and vectorize the same
+// way the real kernels do.
+void runComplexLanes(const LaneGroup& g, const double* literals, size_t stride, double* out, double* outImag) {
+    constexpr size_t W = laneWidth;
+    std::vector<double> reStack(g.depth * W), imStack(g.depth * W);
+    for (size_t base = 0; base < g.exprs.size(); base += W) {
+        double* re = reStack.data();
+        double* im = imStack.data();
+        size_t sp = 0, k = 0;
+        for (auto& [op, fn] : g.code) {
+            if (op == 'n' || op == 'j') {
+                const double* src = literals + k++ * stride + base;
+                double* dr = re + sp * W;
+                double* di = im + sp++ * W;
+                if (op == 'n') for (size_t l = 0; l < W; ++l) { dr[l] = src[l]; di[l] = 0; }
+                else for (size_t l = 0; l < W; ++l) { dr[l] = 0; di[l] = src[l]; }
+                continue;
+            }
+            if (op == 'f') {
+                sp -= fn->arity;
+                Value args[maxArity];
+                for (size_t l = 0; l < W; ++l) {
+                    for (int j = 0; j < fn->arity; ++j)
+                        args[j] = std::complex<double>(re[(sp + j) * W + l], im[(sp + j) * W + l]);
+                    Value r = fn->callValues(args);
+                    re[sp * W + l] = r.real();
+                    im[sp * W + l] = r.imag();
+                }
+                sp++;
+                continue;
+            }
+            double* ar = re + (sp - 2) * W;
+            double* ai = im + (sp - 2) * W;
+            const double* br = re + (sp - 1) * W;
+            const double* bi = im + (sp - 1) * W;
+            sp--;
+            switch (op) {
+                case '+': for (size_t l = 0; l < W; ++l) { ar[l] += br[l]; ai[l] += bi[l]; } break;
+                case '-': for (size_t l = 0; l < W; ++l) { ar[l] -= br[l]; ai[l] -= bi[l]; } break;
+                case '*': for (size_t l = 0; l < W; ++l) complexMul(ar[l], ai[l], br[l], bi[l], ar[l], ai[l]); break;
+                case '/': for (size_t l = 0; l < W; ++l) complexDiv(ar[l], ai[l], br[l], bi[l], ar[l], ai[l]); break;
+                case '^':
+                    for (size_t l = 0; l < W; ++l) {
+                        auto z = complexPow({ar[l], ai[l]}, {br[l], bi[l]});
+                        ar[l] = z.real();
+                        ai[l] = z.imag();
+                    }
+                    break;
+                default: for (size_t l = 0; l < W; ++l) ar[l] = ai[l] = NAN; break;
+            }
+        }
+        size_t n = std::min(W, g.exprs.size() - base);
+        for (size_t l = 0; l < n; ++l) {
+            size_t e = g.exprs[base + l];
+            if (outImag) {
+                out[e] = re[l];
+                outImag[e] = im[l];
+            } else out[e] = im[l] == 0 ? re[l] : NAN;
+        }
+    }
+}
+
+}
+
+double estimateCost(const std::string& expr) {
+    const char* s = expr.c_str();
+    size_t i = 0, n = expr.size();
+    bool exact = expr.find("exact") != std::string::npos;
+    double cost = 0, base = 10;
+    // literal is the value of the token just read, -1 if it was no literal;
+    // power means an exponent comes next and chained that one just came.
+    double literal = -1;
+    bool power = false, chained = false;
+    enum { PLAIN, LINEAR, ROOT } sized = PLAIN;
+    int depth = 0, maxDepth = 0;
+    while (i < n) {
+        char c = s[i];
+        if (isspace((unsigned char)c)) {
+            i++;
+            continue;
+        }
+        cost++;
+        double value = -1;
+        if (isdigit((unsigned char)c) || c == '.') {
+            char* end = nullptr;
+            value = strtod(s + i, &end);
+            if (end == s + i) end++;
+            // Long literals are bignums in exact mode.
+            if (end - (s + i) > 15) cost += end - (s + i);
+            i = end - s;
+        } else if (isalpha((unsigned char)c) || c == '_') {
+            size_t start = i;
+            while (i < n && (isalnum((unsigned char)s[i]) || s[i] == '_')) i++;
+            std::string name(s + start, i - start);
+            sized = name == "range" || name == "primes" ? LINEAR : name == "factor" ? ROOT : PLAIN;
+            literal = -1;
+            continue;
+        } else {
+            i++;
+            if (c == '(' || c == '[') maxDepth = std::max(maxDepth, ++depth);
+            if (c == ')' || c == ']') depth--;
+        }
+        bool exponent = false;
+        if (power) {
+            // An exact power has about exponent * log2(base) bits; one whose
+            // exponent is not a plain number may have any number.
+            if (exact) cost += value >= 0 ? value * std::log2(std::max(base, 2.0)) / 8 : slowCost;
+            power = false;
+            exponent = value >= 0;
+        } else if (c == '^') {
+            if (exact && chained) cost += slowCost;
+            base = literal >= 0 ? literal : 10;
+            power = true;
+        } else if (c == '!') {
+            // Factorials are built up from a table as long as the operand.
+            cost += literal >= 0 ? literal : slowCost;
+        } else if (value >= 0 && sized != PLAIN) {
+            cost += sized == LINEAR ? value : std::sqrt(value);
+            sized = PLAIN;
+        }
+        chained = exponent;
+        literal = value;
+    }
+    return cost + 2 * maxDepth;
+}
+
+void evaluateMany(const std::vector<std::string>& exprs, double* out, const SymbolTable* symbols, double* outImag,
+                  BudgetGuard* guard) {
+    // Lines are first keyed by shape, so only the first line of each shape is
+    // parsed; distinct shapes with the same signature, such as "#+#" and
+    // "(#)+#", then share a lane group. Shapes of well-formed programs the
+    // lanes cannot run map to single, and their lines go through evalValues.
+    constexpr long malformed = -1, single = -2;
+    std::unordered_map<std::string, long> groupOfShape;
+    std::unordered_map<std::string, size_t> bySignature;
+    std::vector<LaneGroup> groups;
+    std::string shape, key;
+    std::vector<double> lineLiterals;
+    for (size_t i = 0; i < exprs.size(); ++i) {
+        shape.clear();
+        lineLiterals.clear();
+        scanShape(exprs[i], shape, lineLiterals);
+        auto [known, isNew] = groupOfShape.try_emplace(shape, malformed);
+        if (isNew) {
+            LaneGroup g;
+            key.clear();
+            auto postfix = infixToPostfix(tokenize(exprs[i], symbols));
+            if (signature(postfix, key, g)) {
+                auto [it, inserted] = bySignature.try_emplace(key, groups.size());
+                if (inserted) groups.push_back(std::move(g));
+                known->second = it->second;
+            } else if (wellFormed(postfix)) known->second = single;
+        }
+        if (known->second == single) {
+            Value v = evalValues(infixToPostfix(tokenize(exprs[i], symbols)), guard);
+            out[i] = outImag ? v.real() : v.toDouble();
+            if (outImag) outImag[i] = v.imag();
+            continue;
+        }
+        if (known->second < 0) {
+            out[i] = NAN;
+            if (outImag) outImag[i] = NAN;
+            continue;
+        }
+        LaneGroup& g = groups[known->second];
+        g.exprs.push_back(i);
+        g.gathered.insert(g.gathered.end(), lineLiterals.begin(), lineLiterals.end());
+    }
+
+    std::vector<double> literals;
+    for (auto& g : groups) {
+        size_t stride = (g.exprs.size() + laneWidth - 1) / laneWidth * laneWidth;
+        literals.assign(g.pushes * stride, 1.0);
+        for (size_t j = 0; j < g.exprs.size(); ++j)
+            for (size_t k = 0; k < g.pushes; ++k) literals[k * stride + j] = g.gathered[j * g.pushes + k];
+        if (g.complex) runComplexLanes(g, literals.data(), stride, out, outImag);
+        else runRealLanes(g, literals.data(), stride, out, outImag);
+    }
+}
+
+}
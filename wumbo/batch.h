@@ -0,0 +1,42 @@
+#pragma once
+
+// Evaluation of many independent expressions at once.
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "symbols.h"
+
+namespace wumbo {
+
+class BudgetGuard;
+
+// Evaluates exprs[i] into out[i], NaN marking an error, exactly as evaluate()
+// would one at a time. Each distinct shape (the token stream with the numbers
+// blanked out) is parsed once and every line of that shape only has its
+// literals extracted. Expressions are grouped by the opcode signature of
+// their postfix programs (the sequence of pushes and operators, ignoring the
+// literal values), and each group runs through a lane interpreter that
+// advances laneWidth expressions per instruction dispatch, every instruction
+// being a fixed-width loop the compiler vectorizes.
+// Calls to functions with a batch entry point go through it, laneWidth calls
+// at a time. Complex-mode groups run on split real/imaginary columns; their
+// imaginary parts go to outImag if given, otherwise a result off the real
+// axis is NaN like in evalPostfix. Lines using lists are evaluated one at a
+// time, and a line whose result is a list gives NaN; guard, if given, is
+// ticked by those lines only, as lane groups always finish quickly.
+void evaluateMany(const std::vector<std::string>& exprs, double* out, const SymbolTable* symbols = nullptr,
+                  double* outImag = nullptr, BudgetGuard* guard = nullptr);
+
+// A rough guess at the work evaluating expr takes, in units of about one
+// token of an ordinary line, read off its text without parsing it: its
+// length and nesting, the size of factorials, of range, primes and factor
+// arguments, and in exact mode of powers and long literals. A line costing
+// more than slowCost can hold up everything evaluated alongside it.
+double estimateCost(const std::string& expr);
+constexpr double slowCost = 10000;
+
+constexpr size_t laneWidth = 8;
+
+}
@@ -0,0 +1,452 @@
+#include "bigint.h"
+#include "ntt.h"
+#include "numtheory.h"
+#include "parallel.h"
+#include "engine.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+namespace wumbo {
+
+namespace {
+
+typedef std::vector<uint32_t> Limbs;
+
+// Operands this short are multiplied directly.
+constexpr size_t schoolbookMax = 256;
+// Transforms this long run one prime per thread.
+constexpr size_t parallelMin = 1 << 15;
+// binomial() sieves the primes up to n up to this, and beyond it builds
+// products of at most multiplicativeMax factors.
+constexpr uint64_t binomialSieveMax = 1 << 26;
+constexpr uint64_t multiplicativeMax = 4096;
+
+void trim(Limbs& a) {
+    while (!a.empty() && a.back() == 0) a.pop_back();
+}
+
+int compareMagnitude(const Limbs& a, const Limbs& b) {
+    if (a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+    for (size_t i = a.size(); i-- > 0;)
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+    return 0;
+}
+
+Limbs addMagnitude(const Limbs& a, const Limbs& b) {
+    const Limbs& longer = a.size() >= b.size() ? a : b;
+    const Limbs& shorter = a.size() >= b.size() ? b : a;
+    Limbs out(longer.size() + 1);
+    uint32_t carry = 0;
+    for (size_t i = 0; i < longer.size(); ++i) {
+        uint32_t s = longer[i] + (i < shorter.size() ? shorter[i] : 0) + carry;
+        carry = s >= BigInt::base;
+        out[i] = carry ? s - BigInt::base : s;
+    }
+    out.back() = carry;
+    trim(out);
+    return out;
+}
+
+// a - b for |a| >= |b|.
+Limbs subMagnitude(const Limbs& a, const Limbs& b) {
+    Limbs out(a.size());
+    int64_t borrow = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        int64_t d = (int64_t)a[i] - (i < b.size() ? b[i] : 0) - borrow;
+        borrow = d < 0;
+        out[i] = (uint32_t)(borrow ? d + BigInt::base : d);
+    }
+    trim(out);
+    return out;
+}
+
+Limbs schoolbook(const Limbs& a, const Limbs& b) {
+    Limbs out(a.size() + b.size());
+    for (size_t i = 0; i < a.size(); ++i) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < b.size(); ++j) {
+            uint64_t t = out[i + j] + (uint64_t)a[i] * b[j] + carry;
+            out[i + j] = (uint32_t)(t % BigInt::base);
+            carry = t / BigInt::base;
+        }
+        out[i + b.size()] = (uint32_t)carry;
+    }
+    trim(out);
+    return out;
+}
+
+// Limbs are already residues of the three primes, all above 2^30, and each
+// coefficient of the product is below n base^2, so it is exact modulo their
+// product for fewer than a billion limbs. Squares transform once.
+Limbs transformMul(const Limbs& a, const Limbs& b) {
+    size_t n = a.size() + b.size() - 1;
+    unsigned logLen = log2Ceil(n);
+    size_t len = (size_t)1 << logLen;
+    std::vector<NttPrime> primes = nttPrimes(logLen, 3);
+    if (primes.size() < 3) return schoolbook(a, b);
+    bool square = &a == &b;
+    std::vector<Residues> r(3);
+    parallelFor(3, len >= parallelMin ? hardwareThreads() : 1, [&](size_t begin, size_t end) {
+        for (size_t j = begin; j < end; ++j) {
+            const NttPrime& prime = primes[j];
+            Residues x(len), y;
+            std::copy(a.begin(), a.end(), x.begin());
+            ntt(x, prime, false);
+            if (!square) {
+                y.resize(len);
+                std::copy(b.begin(), b.end(), y.begin());
+                ntt(y, prime, false);
+            }
+            const Residues& z = square ? x : y;
+            for (size_t k = 0; k < len; ++k) x[k] = (uint32_t)((uint64_t)x[k] * z[k] % prime.p);
+            ntt(x, prime, true);
+            r[j] = std::move(x);
+        }
+    });
+    // Garner: X = r0 + p0 t1 + p0 p1 t2, then carried into base 10^9.
+    uint64_t p0 = primes[0].p, p1 = primes[1].p, p2 = primes[2].p;
+    uint64_t inv01 = powMod(p0, p1 - 2, p1), inv012 = powMod(p0 * p1 % p2, p2 - 2, p2);
+    Limbs out(n);
+    unsigned __int128 carry = 0;
+    for (size_t k = 0; k < n; ++k) {
+        uint64_t r0 = r[0][k], r1 = r[1][k], r2 = r[2][k];
+        uint64_t t1 = (r1 + p1 - r0 % p1) % p1 * inv01 % p1;
+        uint64_t x01 = r0 + p0 * t1;
+        uint64_t t2 = (r2 + p2 - x01 % p2) % p2 * inv012 % p2;
+        carry += x01 + (unsigned __int128)(p0 * p1) * t2;
+        out[k] = (uint32_t)(carry % BigInt::base);
+        carry /= BigInt::base;
+    }
+    for (; carry; carry /= BigInt::base) out.push_back((uint32_t)(carry % BigInt::base));
+    trim(out);
+    return out;
+}
+
+Limbs mulMagnitude(const Limbs& a, const Limbs& b) {
+    if (a.empty() || b.empty()) return {};
+    if (std::min(a.size(), b.size()) <= schoolbookMax) return schoolbook(a, b);
+    return transformMul(a, b);
+}
+
+// a / d in place, returning the remainder.
+uint32_t divideSmall(Limbs& a, uint32_t d) {
+    uint64_t rem = 0;
+    for (size_t i = a.size(); i-- > 0;) {
+        uint64_t cur = rem * BigInt::base + a[i];
+        a[i] = (uint32_t)(cur / d);
+        rem = cur % d;
+    }
+    trim(a);
+    return (uint32_t)rem;
+}
+
+Limbs mulSmall(const Limbs& a, uint32_t d) {
+    Limbs out(a.size() + 1);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        carry += (uint64_t)a[i] * d;
+        out[i] = (uint32_t)(carry % BigInt::base);
+        carry /= BigInt::base;
+    }
+    out.back() = (uint32_t)carry;
+    trim(out);
+    return out;
+}
+
+// floor(a / b) for b > 0 by Knuth's algorithm D: both are scaled so the
+// divisor's top limb is at least base / 2, which makes the quotient digit
+// estimated from the top two limbs at most two too large.
+Limbs divMagnitude(const Limbs& a, const Limbs& b) {
+    if (compareMagnitude(a, b) < 0) return {};
+    if (b.size() == 1) {
+        Limbs q = a;
+        divideSmall(q, b[0]);
+        return q;
+    }
+    uint32_t scale = BigInt::base / (b.back() + 1);
+    Limbs u = mulSmall(a, scale), v = mulSmall(b, scale);
+    u.resize(a.size() + 1);
+    size_t n = v.size(), m = u.size() - n;
+    Limbs q(m);
+    for (size_t j = m; j-- > 0;) {
+        uint64_t top = (uint64_t)u[j + n] * BigInt::base + u[j + n - 1];
+        uint64_t qhat = top / v[n - 1], rhat = top % v[n - 1];
+        while (qhat >= BigInt::base || qhat * v[n - 2] > rhat * BigInt::base + u[j + n - 2]) {
+            qhat--;
+            rhat += v[n - 1];
+            if (rhat >= BigInt::base) break;
+        }
+        int64_t borrow = 0;
+        uint64_t carry = 0;
+        for (size_t i = 0; i <= n; ++i) {
+            uint64_t p = (i < n ? qhat * v[i] : 0) + carry;
+            carry = p / BigInt::base;
+            int64_t d = (int64_t)u[i + j] - (int64_t)(p % BigInt::base) - borrow;
+            borrow = d < 0;
+            u[i + j] = (uint32_t)(borrow ? d + BigInt::base : d);
+        }
+        // Still one too large: add the divisor back, dropping the carry out
+        // of the top limb, which cancels the borrow.
+        if (borrow) {
+            qhat--;
+            uint32_t c = 0;
+            for (size_t i = 0; i <= n; ++i) {
+                uint32_t s = u[i + j] + (i < n ? v[i] : 0) + c;
+                c = s >= BigInt::base;
+                u[i + j] = c ? s - BigInt::base : s;
+            }
+        }
+        q[j] = (uint32_t)qhat;
+    }
+    trim(q);
+    return q;
+}
+
+BigInt productTree(const std::vector<uint64_t>& f, size_t lo, size_t hi) {
+    if (hi - lo == 1) return BigInt(f[lo]);
+    size_t mid = lo + (hi - lo) / 2;
+    return productTree(f, lo, mid) * productTree(f, mid, hi);
+}
+
+// The factors are packed into 64-bit words first, so the tree's leaves are
+// a few limbs each rather than one small number.
+BigInt product(const std::vector<uint64_t>& factors) {
+    std::vector<uint64_t> words;
+    uint64_t w = 1;
+    for (uint64_t f : factors) {
+        if (w > UINT64_MAX / f) {
+            words.push_back(w);
+            w = 1;
+        }
+        w *= f;
+    }
+    words.push_back(w);
+    return productTree(words, 0, words.size());
+}
+
+BigInt swing(uint64_t n, const std::vector<uint64_t>& primes) {
+    std::vector<uint64_t> factors;
+    for (uint64_t p : primes) {
+        if (p > n) break;
+        uint64_t pe = 1;
+        for (uint64_t q = n / p; q; q /= p)
+            if (q & 1) pe *= p;
+        if (pe > 1) factors.push_back(pe);
+    }
+    return product(factors);
+}
+
+bool swingFactorial(uint64_t n, const std::vector<uint64_t>& primes, BigInt& out, BudgetGuard* guard) {
+    // 20! is the largest factorial below 2^64.
+    if (n <= 20) {
+        uint64_t f = 1;
+        for (uint64_t i = 2; i <= n; ++i) f *= i;
+        out = BigInt(f);
+        return true;
+    }
+    BigInt half;
+    if (!swingFactorial(n / 2, primes, half, guard)) return false;
+    if (guard && !guard->tick(std::upper_bound(primes.begin(), primes.end(), n) - primes.begin())) return false;
+    out = half * half * swing(n, primes);
+    return true;
+}
+
+}
+
+BigInt::BigInt(unsigned __int128 magnitude, bool negative) : negative_(negative && magnitude) {
+    for (; magnitude; magnitude /= base) limbs_.push_back((uint32_t)(magnitude % base));
+}
+
+BigInt BigInt::fromDouble(double x) {
+    int e;
+    double m = std::frexp(std::fabs(x), &e);
+    if (e <= 64) return BigInt((uint64_t)std::fabs(x), x < 0);
+    return BigInt((uint64_t)std::ldexp(m, 53), x < 0) * bigIntPow(BigInt(2), e - 53);
+}
+
+size_t BigInt::digits() const {
+    if (limbs_.empty()) return 1;
+    size_t d = 9 * (limbs_.size() - 1);
+    for (uint32_t top = limbs_.back(); top; top /= 10) d++;
+    return d;
+}
+
+std::string BigInt::digitWindow(size_t from, size_t count) const {
+    static const uint32_t pow10[9] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+    size_t n = digits();
+    if (from >= n) return "";
+    std::string s(std::min(count, n - from), '0');
+    if (limbs_.empty()) return s;
+    for (size_t i = 0; i < s.size(); ++i) {
+        size_t low = n - 1 - from - i;
+        s[i] = (char)('0' + limbs_[low / 9] / pow10[low % 9] % 10);
+    }
+    return s;
+}
+
+bool BigInt::smallMagnitude(unsigned __int128& m) const {
+    m = 0;
+    for (size_t i = limbs_.size(); i-- > 0;)
+        if (__builtin_mul_overflow(m, base, &m) || __builtin_add_overflow(m, limbs_[i], &m)) return false;
+    return true;
+}
+
+// strtod rounds the leading 28 or more digits correctly; the rest can only
+// matter when those land exactly halfway between two doubles.
+double BigInt::toDouble() const {
+    if (limbs_.empty()) return 0;
+    char buf[64];
+    size_t used = std::min<size_t>(4, limbs_.size());
+    int len = snprintf(buf, sizeof(buf), "%s%u", negative_ ? "-" : "", limbs_.back());
+    for (size_t i = 2; i <= used; ++i) len += snprintf(buf + len, sizeof(buf) - len, "%09u", limbs_[limbs_.size() - i]);
+    snprintf(buf + len, sizeof(buf) - len, "e%zu", 9 * (limbs_.size() - used));
+    return strtod(buf, nullptr);
+}
+
+std::string BigInt::toString() const {
+    if (limbs_.empty()) return "0";
+    std::string s = negative_ ? "-" : "";
+    s += std::to_string(limbs_.back());
+    s.reserve(s.size() + 9 * limbs_.size());
+    char buf[16];
+    for (size_t i = limbs_.size() - 1; i-- > 0;) {
+        snprintf(buf, sizeof(buf), "%09u", limbs_[i]);
+        s += buf;
+    }
+    return s;
+}
+
+BigInt operator+(const BigInt& a, const BigInt& b) {
+    BigInt r;
+    if (a.negative_ == b.negative_) {
+        r.limbs_ = addMagnitude(a.limbs_, b.limbs_);
+        r.negative_ = a.negative_;
+    } else if (compareMagnitude(a.limbs_, b.limbs_) >= 0) {
+        r.limbs_ = subMagnitude(a.limbs_, b.limbs_);
+        r.negative_ = a.negative_;
+    } else {
+        r.limbs_ = subMagnitude(b.limbs_, a.limbs_);
+        r.negative_ = b.negative_;
+    }
+    r.negative_ &= !r.limbs_.empty();
+    return r;
+}
+
+BigInt operator-(const BigInt& a, const BigInt& b) {
+    BigInt negated = b;
+    negated.negative_ = !b.negative_ && !b.isZero();
+    return a + negated;
+}
+
+BigInt operator*(const BigInt& a, const BigInt& b) {
+    BigInt r;
+    r.limbs_ = &a == &b ? mulMagnitude(a.limbs_, a.limbs_) : mulMagnitude(a.limbs_, b.limbs_);
+    r.negative_ = a.negative_ != b.negative_ && !r.limbs_.empty();
+    return r;
+}
+
+BigInt BigInt::operator-() const {
+    BigInt r = *this;
+    r.negative_ = !negative_ && !isZero();
+    return r;
+}
+
+BigInt BigInt::abs() const {
+    BigInt r = *this;
+    r.negative_ = false;
+    return r;
+}
+
+BigInt BigInt::scaleDecimal(long k) const {
+    static const uint32_t powers[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+    BigInt r;
+    r.negative_ = negative_;
+    if (k >= 0) {
+        r.limbs_ = mulSmall(limbs_, powers[k % 9]);
+        if (!r.limbs_.empty()) r.limbs_.insert(r.limbs_.begin(), k / 9, 0);
+        return r;
+    }
+    // Adding half the divisor to the magnitude first makes truncation round.
+    size_t drop = -k / 9;
+    if (drop > limbs_.size()) return BigInt();
+    Limbs half = mulSmall(Limbs{5}, powers[(-k - 1) % 9]);
+    half.insert(half.begin(), (-k - 1) / 9, 0);
+    r.limbs_ = addMagnitude(limbs_, half);
+    r.limbs_.erase(r.limbs_.begin(), r.limbs_.begin() + std::min(drop, r.limbs_.size()));
+    divideSmall(r.limbs_, powers[-k % 9]);
+    r.negative_ &= !r.limbs_.empty();
+    return r;
+}
+
+BigInt operator/(const BigInt& a, const BigInt& b) {
+    BigInt r;
+    r.limbs_ = divMagnitude(a.limbs_, b.limbs_);
+    r.negative_ = a.negative_ != b.negative_ && !r.limbs_.empty();
+    return r;
+}
+
+bool operator<(const BigInt& a, const BigInt& b) {
+    if (a.negative_ != b.negative_) return a.negative_;
+    int c = compareMagnitude(a.limbs_, b.limbs_);
+    return a.negative_ ? c > 0 : c < 0;
+}
+
+BigInt bigIntPow(const BigInt& b, uint64_t e) {
+    BigInt r(1), x = b;
+    for (;;) {
+        if (e & 1) r = r * x;
+        e >>= 1;
+        if (!e) return r;
+        x = x * x;
+    }
+}
+
+BigInt isqrt(const BigInt& n) {
+    if (n.isZero()) return n;
+    // Starting from the root of the leading 30 digits or so, rounded up, and
+    // from above each step stays above it until the floor is reached.
+    long k = std::max(0L, ((long)n.digits() - 30) / 2);
+    double top = std::sqrt(n.scaleDecimal(-2 * k).toDouble()) * (1 + 0x1p-40);
+    BigInt x = (BigInt::fromDouble(std::ceil(top)) + BigInt(1)).scaleDecimal(k), two(2);
+    for (;;) {
+        BigInt y = (x + n / x) / two;
+        if (!(y < x)) return x;
+        x = y;
+    }
+}
+
+bool factorial(uint64_t n, BigInt& out, BudgetGuard* guard) {
+    return swingFactorial(n, n > 20 ? primesBetween(2, n) : std::vector<uint64_t>(), out, guard);
+}
+
+bool binomial(uint64_t n, uint64_t k, BigInt& out) {
+    if (k > n) {
+        out = BigInt();
+        return true;
+    }
+    k = std::min(k, n - k);
+    if (n > binomialSieveMax) {
+        if (k > multiplicativeMax) return false;
+        // C(n, i) = C(n, i - 1) (n - k + i) / i, exact at every step.
+        out = BigInt(1);
+        for (uint64_t i = 1; i <= k; ++i) {
+            out = out * BigInt(n - k + i);
+            divideSmall(out.limbs_, (uint32_t)i);
+        }
+        return true;
+    }
+    std::vector<uint64_t> factors;
+    for (uint64_t p : primesBetween(2, n)) {
+        uint64_t pe = 1;
+        for (uint64_t a = n / p, b = k / p, c = (n - k) / p; a; a /= p, b /= p, c /= p)
+            if (a - b - c) pe *= p;
+        if (pe > 1) factors.push_back(pe);
+    }
+    out = product(factors);
+    return true;
+}
+
+}
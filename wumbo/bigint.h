@@ -0,0 +1,78 @@
+#pragma once
+
+// Arbitrary-precision integers, for exact results too large for a double.
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace wumbo {
+
+class BudgetGuard;
+
+// Results with more decimal digits than this are refused rather than computed.
+constexpr double maxBigDigits = 1 << 22;
+
+// A sign and a magnitude in base 10^9, least significant limb first, so
+// printing needs no base conversion. Short products are formed directly and
+// long ones through number-theoretic transforms modulo three primes (ntt.h),
+// recombined exactly.
+class BigInt {
+public:
+    static constexpr uint32_t base = 1000000000;
+
+    explicit BigInt(unsigned __int128 magnitude = 0, bool negative = false);
+    // The integer x; x must be finite and a whole number.
+    static BigInt fromDouble(double x);
+
+    bool isZero() const { return limbs_.empty(); }
+    bool negative() const { return negative_; }
+    BigInt operator-() const;
+    BigInt abs() const;
+    // The value times 10^k, rounded to nearest with halves away from zero
+    // when k is negative.
+    BigInt scaleDecimal(long k) const;
+    // Decimal digits in the magnitude; 1 for zero.
+    size_t digits() const;
+    // Up to count decimal digits of the magnitude starting from, counting from
+    // the most significant; they are read straight off the limbs that hold
+    // them, so any window of a huge number costs only its own length.
+    std::string digitWindow(size_t from, size_t count) const;
+    // Sets m to the magnitude if that is below 2^128.
+    bool smallMagnitude(unsigned __int128& m) const;
+    // Within an ulp or so of the value, and infinite beyond the double range.
+    double toDouble() const;
+    std::string toString() const;
+    // Memory held by the magnitude.
+    size_t bytes() const { return limbs_.capacity() * sizeof(uint32_t); }
+
+    friend BigInt operator+(const BigInt& a, const BigInt& b);
+    friend BigInt operator-(const BigInt& a, const BigInt& b);
+    friend BigInt operator*(const BigInt& a, const BigInt& b);
+    // Truncated toward zero, as for built-in integers; b must not be zero.
+    friend BigInt operator/(const BigInt& a, const BigInt& b);
+    friend bool operator<(const BigInt& a, const BigInt& b);
+    friend bool binomial(uint64_t n, uint64_t k, BigInt& out);
+
+private:
+    bool negative_ = false;
+    std::vector<uint32_t> limbs_;
+};
+
+BigInt bigIntPow(const BigInt& b, uint64_t e);
+// floor(sqrt(n)) for n >= 0, by Newton's method from above.
+BigInt isqrt(const BigInt& n);
+// n! by Luschny's prime swing, n! = (floor(n/2)!)^2 swing(n), where the
+// exponent of each prime p in swing(n) is the number of odd values among
+// floor(n / p^i); the prime powers are multiplied as a balanced product tree.
+// The guard is ticked between swings, once per prime in each; false if it
+// stops the work.
+bool factorial(uint64_t n, BigInt& out, BudgetGuard* guard = nullptr);
+// C(n, k) as the product of its prime powers, the exponent of p being the
+// number of carries when adding k and n - k in base p (Kummer). That needs
+// the primes up to n, so above 2^26 only min(k, n - k) up to 4096 is
+// supported, multiplying in one factor at a time; false for anything else.
+bool binomial(uint64_t n, uint64_t k, BigInt& out);
+
+}
@@ -0,0 +1,481 @@
+#pragma once
+
+// Compile-time evaluation of constant expressions (C++20):
+//
+//     constexpr double area = wumbo::eval<"2*(3+4)^2">();
+//     using namespace wumbo::literals;
+//     static_assert("1+2*3"_wumbo == 7);
+//
+// Only the arithmetic subset of the language is understood: numbers, + - * /
+// ^ and parentheses, with no functions, factorials, lists, i or x. Within it
+// the results follow engine.c++: unclosed parentheses are closed at the end,
+// division by zero is NaN, and overflow gives infinity rather than an error.
+// Everything works on fixed-size arrays so it runs in constant expressions,
+// and the header needs nothing but the standard library. Malformed
+// expressions fail to compile. Literals are rounded correctly, as strtod
+// rounds them, but integer powers are taken by repeated squaring and
+// non-integer powers by a series exp/log, so either may differ from std::pow
+// in the last bit.
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace wumbo {
+
+template <std::size_t N>
+struct fixed_string {
+    char data[N] = {};
+    constexpr fixed_string(const char (&s)[N]) {
+        for (std::size_t i = 0; i < N; ++i) data[i] = s[i];
+    }
+    constexpr std::size_t size() const { return N - 1; }
+};
+
+namespace ct {
+
+enum TokenType { NUMBER, OPERATOR, LPAREN, RPAREN };
+struct Token {
+    TokenType type = NUMBER;
+    double value = 0;
+    char op = 0;
+};
+
+// At most one token per character, so every stage fits in N slots.
+template <std::size_t N>
+struct Tokens {
+    Token items[N ? N : 1] = {};
+    std::size_t size = 0;
+    constexpr void push(const Token& t) { items[size++] = t; }
+};
+
+constexpr double nan() { return std::numeric_limits<double>::quiet_NaN(); }
+constexpr double inf() { return std::numeric_limits<double>::infinity(); }
+constexpr bool isnan(double x) { return x != x; }
+constexpr bool isinf(double x) { return x == inf() || x == -inf(); }
+constexpr bool signbit(double x) { return std::bit_cast<std::uint64_t>(x) >> 63; }
+constexpr bool isdigit(char c) { return c >= '0' && c <= '9'; }
+constexpr bool isspace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v'; }
+
+constexpr double pow10(int e) {
+    double r = 1, b = 10;
+    bool neg = e < 0;
+    unsigned n = neg ? -e : e;
+    for (; n; n >>= 1, b *= b)
+        if (n & 1) r *= b;
+    return neg ? 1 / r : r;
+}
+
+// Unsigned integer of fixed width for parseNumber's exact path: 769
+// significant digits, or a denominator of up to 10^1094, shifted by 55 bits.
+struct BigNum {
+    static constexpr int capacity = 128;
+    std::uint32_t limb[capacity] = {};
+    int size = 0;
+
+    constexpr void trim() {
+        while (size && !limb[size - 1]) --size;
+    }
+    constexpr void mulAdd(std::uint32_t m, std::uint32_t a) {
+        std::uint64_t carry = a;
+        for (int i = 0; i < size; ++i) {
+            std::uint64_t t = (std::uint64_t)limb[i] * m + carry;
+            limb[i] = (std::uint32_t)t;
+            carry = t >> 32;
+        }
+        if (carry) limb[size++] = (std::uint32_t)carry;
+    }
+    constexpr void mulPow10(long e) {
+        for (; e >= 9; e -= 9) mulAdd(1000000000, 0);
+        std::uint32_t m = 1;
+        for (; e > 0; --e) m *= 10;
+        mulAdd(m, 0);
+    }
+    constexpr int bits() const {
+        int b = size ? 32 * (size - 1) : 0;
+        for (std::uint32_t top = size ? limb[size - 1] : 0; top; top >>= 1) ++b;
+        return b;
+    }
+    constexpr void shiftLeft(int s) {
+        if (!size) return;
+        int limbs = s / 32, shift = s % 32, n = size + limbs + 1;
+        for (int i = n - 1; i >= 0; --i) {
+            int from = i - limbs;
+            std::uint32_t hi = from >= 0 && from < size ? limb[from] : 0;
+            std::uint32_t lo = from >= 1 && from <= size ? limb[from - 1] : 0;
+            limb[i] = shift ? (hi << shift) | (lo >> (32 - shift)) : hi;
+        }
+        size = n;
+        trim();
+    }
+    constexpr void shiftRight1() {
+        for (int i = 0; i < size; ++i) limb[i] = (limb[i] >> 1) | (i + 1 < size ? limb[i + 1] << 31 : 0);
+        trim();
+    }
+    constexpr bool less(const BigNum& o) const {
+        if (size != o.size) return size < o.size;
+        for (int i = size - 1; i >= 0; --i)
+            if (limb[i] != o.limb[i]) return limb[i] < o.limb[i];
+        return false;
+    }
+    // Requires o <= *this.
+    constexpr void subtract(const BigNum& o) {
+        std::uint64_t borrow = 0;
+        for (int i = 0; i < size; ++i) {
+            std::uint64_t t = (std::uint64_t)limb[i] - (i < o.size ? o.limb[i] : 0) - borrow;
+            limb[i] = (std::uint32_t)t;
+            borrow = t >> 63;
+        }
+        trim();
+    }
+};
+
+// The double nearest num / den, ties to even; num and den are nonzero.
+constexpr double nearest(BigNum num, BigNum den) {
+    // Scale so that the quotient q has 54 or 55 bits; the value is then
+    // (q + rest / den) * 2^-scale.
+    int scale = 54 - (num.bits() - den.bits());
+    if (scale > 0) num.shiftLeft(scale);
+    else den.shiftLeft(-scale);
+    BigNum step = den;
+    step.shiftLeft(54);
+    std::uint64_t q = 0;
+    for (int bit = 54; bit >= 0; --bit, step.shiftRight1())
+        if (!num.less(step)) {
+            num.subtract(step);
+            q |= std::uint64_t(1) << bit;
+        }
+    int qbits = 0;
+    for (std::uint64_t t = q; t; t >>= 1) ++qbits;
+    int e = qbits - 1 - scale;
+    if (e > 1023) return std::numeric_limits<double>::infinity();
+    // Drop the bits below the last place of the result, which is 2^-1074
+    // for subnormals.
+    int ulp = e - 52 > -1074 ? e - 52 : -1074, drop = ulp + scale;
+    if (drop > qbits) return 0;
+    std::uint64_t m = q >> drop, rest = q & ((std::uint64_t(1) << drop) - 1), half = std::uint64_t(1) << (drop - 1);
+    if (rest > half || (rest == half && (num.size || (m & 1)))) ++m;
+    if (m >> 53 && ulp == 971) return std::numeric_limits<double>::infinity();
+    // m * 2^ulp is representable, so every step here is exact.
+    double r = (double)m;
+    for (; ulp >= 32; ulp -= 32) r *= 4294967296.0;
+    for (; ulp <= -32; ulp += 32) r /= 4294967296.0;
+    for (; ulp > 0; --ulp) r *= 2;
+    for (; ulp < 0; ++ulp) r /= 2;
+    return r;
+}
+
+// Decimal literal with optional fraction and exponent, as strtod reads and
+// rounds it. Returns the number of characters consumed, 0 if there is no
+// number here.
+template <std::size_t N>
+constexpr std::size_t parseNumber(const fixed_string<N>& s, std::size_t i, double& out) {
+    std::size_t start = i, end = s.size();
+    std::size_t intStart = i;
+    while (i < end && isdigit(s.data[i])) ++i;
+    std::size_t intLen = i - intStart, fracStart = i;
+    if (i < end && s.data[i] == '.') {
+        fracStart = ++i;
+        while (i < end && isdigit(s.data[i])) ++i;
+    }
+    std::size_t fracLen = i - fracStart;
+    if (intLen + fracLen == 0) return 0;
+    long exp10 = 0;
+    if (i < end && (s.data[i] == 'e' || s.data[i] == 'E')) {
+        std::size_t j = i + 1;
+        bool neg = false;
+        if (j < end && (s.data[j] == '+' || s.data[j] == '-')) neg = s.data[j++] == '-';
+        if (j < end && isdigit(s.data[j])) {
+            // Far beyond the range of a double, the exponent only has to stay far.
+            while (j < end && isdigit(s.data[j]))
+                if (exp10 < 100000) exp10 = exp10 * 10 + (s.data[j++] - '0');
+                else ++j;
+            if (neg) exp10 = -exp10;
+            i = j;
+        }
+    }
+    std::size_t len = i - start;
+
+    // The value is the digits from first to last, as an integer, times 10^exp10.
+    auto digit = [&](std::size_t k) { return s.data[k < intLen ? intStart + k : fracStart + k - intLen] - '0'; };
+    std::size_t first = 0, last = intLen + fracLen;
+    while (first < last && digit(first) == 0) ++first;
+    if (first == last) { out = 0; return len; }
+    while (digit(last - 1) == 0) --last;
+    exp10 += (long)intLen - (long)last;
+    long digits = (long)(last - first);
+
+    // With a mantissa and power of ten that are both exact, one operation
+    // rounds correctly.
+    if (digits <= 19 && exp10 >= -22 && exp10 <= 22) {
+        std::uint64_t mant = 0;
+        for (std::size_t k = first; k < last; ++k) mant = mant * 10 + digit(k);
+        if (mant >> 53 == 0) {
+            out = exp10 < 0 ? (double)mant / pow10((int)-exp10) : (double)mant * pow10((int)exp10);
+            return len;
+        }
+    }
+    if (digits + exp10 > 310) { out = std::numeric_limits<double>::infinity(); return len; }
+    if (digits + exp10 < -324) { out = 0; return len; }
+
+    // Otherwise divide exactly. 768 digits tell apart every pair of doubles
+    // and the halfway points between them; any nonzero digits past those
+    // only need to pull the value off a halfway point, which one more 1 does.
+    BigNum num, den;
+    den.limb[0] = 1;
+    den.size = 1;
+    std::size_t kept = last - first > 768 ? first + 768 : last;
+    for (std::size_t k = first; k < kept; ++k) num.mulAdd(10, (std::uint32_t)digit(k));
+    exp10 += (long)(last - kept);
+    if (kept < last) {
+        num.mulAdd(10, 1);
+        exp10--;
+    }
+    if (exp10 > 0) num.mulPow10(exp10);
+    else den.mulPow10(-exp10);
+    out = nearest(num, den);
+    return len;
+}
+
+template <std::size_t N>
+constexpr Tokens<N> tokenize(const fixed_string<N>& s) {
+    Tokens<N> tokens;
+    std::size_t i = 0;
+    while (i < s.size()) {
+        char c = s.data[i];
+        if (isspace(c)) { i++; continue; }
+        if (isdigit(c) || c == '.') {
+            double v = 0;
+            std::size_t len = parseNumber(s, i, v);
+            if (len == 0) { i++; continue; }
+            tokens.push({NUMBER, v, 0});
+            i += len;
+        } else {
+            if (c == '+' || c == '-' || c == '*' || c == '/' || c == '^') tokens.push({OPERATOR, 0, c});
+            else if (c == '(') tokens.push({LPAREN, 0, 0});
+            else if (c == ')') tokens.push({RPAREN, 0, 0});
+            i++;
+        }
+    }
+    return tokens;
+}
+
+constexpr int precedence(char op) {
+    switch (op) {
+        case '^': return 4;
+        case '*': case '/': return 3;
+        case '+': case '-': return 2;
+        default: return 0;
+    }
+}
+
+template <std::size_t N>
+constexpr Tokens<N> infixToPostfix(const Tokens<N>& tokens) {
+    Tokens<N> output, ops;
+    for (std::size_t i = 0; i < tokens.size; ++i) {
+        const Token& t = tokens.items[i];
+        if (t.type == NUMBER) output.push(t);
+        else if (t.type == OPERATOR) {
+            while (ops.size && ops.items[ops.size - 1].type == OPERATOR) {
+                const Token& top = ops.items[ops.size - 1];
+                if (precedence(top.op) > precedence(t.op) || (precedence(top.op) == precedence(t.op) && t.op != '^'))
+                    output.push(ops.items[--ops.size]);
+                else break;
+            }
+            ops.push(t);
+        } else if (t.type == LPAREN) ops.push(t);
+        else if (t.type == RPAREN) {
+            while (ops.size && ops.items[ops.size - 1].type != LPAREN) output.push(ops.items[--ops.size]);
+            if (ops.size && ops.items[ops.size - 1].type == LPAREN) --ops.size;
+        }
+    }
+    // Unclosed parentheses are closed at the end of the input.
+    while (ops.size)
+        if (ops.items[--ops.size].type != LPAREN) output.push(ops.items[ops.size]);
+    return output;
+}
+
+// Arithmetic that overflows is not a constant expression, so results that
+// might are worked out from split mantissas and exponents instead, and turned
+// into infinities here. Otherwise the operation is done as written, which
+// rounds the same as it does at run time.
+
+// x = m * 2^e with 0.5 <= |m| < 1, for x finite and nonzero.
+constexpr double split(double x, long long& e) {
+    e = 0;
+    while (x >= 1 || x <= -1) { x /= 2; ++e; }
+    while (x < 0.5 && x > -0.5) { x *= 2; --e; }
+    return x;
+}
+
+// m * 2^e, rounded once; m is finite and nonzero with |m| < 2, and the
+// result is infinite past the largest double.
+constexpr double scale(double m, long long e) {
+    while (m < 0.5 && m > -0.5) { m *= 2; --e; }
+    while (m >= 1 || m <= -1) { m /= 2; ++e; }
+    if (e > 1024) return m < 0 ? -inf() : inf();
+    if (e < -1075) return m < 0 ? -0.0 : 0.0;
+    // 2^1024 and 2^-1075 are not doubles, but a step of m towards them is exact.
+    if (e == 1024) { m *= 2; --e; }
+    if (e == -1075) { m /= 2; ++e; }
+    double p = 1;
+    for (; e > 0; --e) p *= 2;
+    for (; e < 0; ++e) p /= 2;
+    return m * p;
+}
+
+constexpr double add(double a, double b) {
+    if (isinf(a) && isinf(b) && a != b) return nan();
+    if (isnan(a) || isnan(b) || isinf(a) || isinf(b)) return a + b;
+    // Below 2^1023 each, the sum is at most the largest double.
+    constexpr double big = 8.98846567431157953864652595394512366e307;
+    if (a < big && a > -big && b < big && b > -big) return a + b;
+    double h = a / 2 + b / 2;
+    return h >= big ? inf() : h <= -big ? -inf() : h * 2;
+}
+
+constexpr double mul(double a, double b) {
+    if (isnan(a) || isnan(b)) return nan();
+    if ((a == 0 && isinf(b)) || (b == 0 && isinf(a))) return nan();
+    if (a == 0 || b == 0 || isinf(a) || isinf(b)) return a * b;
+    long long ea = 0, eb = 0;
+    double ma = split(a, ea), mb = split(b, eb);
+    // |a * b| < 2^(ea + eb).
+    return ea + eb <= 1023 ? a * b : scale(ma * mb, ea + eb);
+}
+
+constexpr double div(double a, double b) {
+    if (isnan(a) || isnan(b) || b == 0 || (isinf(a) && isinf(b))) return nan();
+    if (a == 0 || isinf(a) || isinf(b)) return a / b;
+    long long ea = 0, eb = 0;
+    double ma = split(a, ea), mb = split(b, eb);
+    // |a / b| < 2^(ea - eb + 1).
+    return ea - eb <= 1022 ? a / b : scale(ma / mb, ea - eb);
+}
+
+// Natural log and exp by range reduction plus atanh / Taylor series.
+constexpr double ln2 = 0.693147180559945309417232121458176568;
+
+constexpr double log(double x) {
+    if (isnan(x) || x < 0) return nan();
+    if (x == 0) return -inf();
+    if (x == inf()) return x;
+    int k = 0;
+    while (x >= 2) { x /= 2; ++k; }
+    while (x < 1) { x *= 2; --k; }
+    double z = (x - 1) / (x + 1), z2 = z * z, term = z, sum = 0;
+    for (int n = 1; n < 200 && term != 0; n += 2) {
+        sum += term / n;
+        term *= z2;
+    }
+    return 2 * sum + k * ln2;
+}
+
+constexpr double exp(double x) {
+    if (isnan(x)) return x;
+    if (x > 709.8) return inf();
+    if (x < -745.2) return 0;
+    long k = (long)(x / ln2 + (x < 0 ? -0.5 : 0.5));
+    double r = x - k * ln2, term = 1, sum = 1;
+    for (int n = 1; n < 40; ++n) {
+        term *= r / n;
+        sum += term;
+    }
+    return scale(sum, k);
+}
+
+constexpr double pow(double a, double b) {
+    if (b == 0) return 1;
+    if (isnan(a) || isnan(b)) return nan();
+    if (b == (double)(long long)b && b > -2147483648.0 && b < 2147483648.0) {
+        long long n = (long long)b;
+        bool neg = n < 0;
+        unsigned long long u = neg ? -n : n;
+        if (a == 0 || isinf(a)) {
+            double r = (a == 0) == neg ? inf() : 0;
+            return signbit(a) && (u & 1) ? -r : r;
+        }
+        // Squaring the mantissa and doubling the exponent apart, so that
+        // neither the base nor the running product can overflow on the way.
+        long long re = 0, be = 0;
+        double r = 1, base = split(a, be);
+        for (;;) {
+            if (u & 1) {
+                r *= base;
+                re += be;
+                if (r < 0.5 && r > -0.5) { r *= 2; --re; }
+            }
+            if (!(u >>= 1)) break;
+            base *= base;
+            be *= 2;
+            if (base < 0.5) { base *= 2; --be; }
+        }
+        return neg ? scale(1 / r, -re) : scale(r, re);
+    }
+    if (a < 0) return nan();
+    if (a == 0) return b > 0 ? 0 : inf();
+    return exp(mul(b, log(a)));
+}
+
+constexpr double applyOp(double a, double b, char op) {
+    switch (op) {
+        case '+': return add(a, b);
+        case '-': return add(a, -b);
+        case '*': return mul(a, b);
+        case '/': return div(a, b);
+        case '^': return pow(a, b);
+        default: return nan();
+    }
+}
+
+// True when the postfix program leaves exactly one value on the stack.
+template <std::size_t N>
+constexpr bool wellFormed(const Tokens<N>& postfix) {
+    long depth = 0;
+    for (std::size_t i = 0; i < postfix.size; ++i) {
+        if (postfix.items[i].type == NUMBER) depth++;
+        else if (postfix.items[i].type != OPERATOR || --depth < 1) return false;
+    }
+    return depth == 1;
+}
+
+template <std::size_t N>
+constexpr double evalPostfix(const Tokens<N>& postfix) {
+    double st[N ? N : 1] = {};
+    std::size_t sp = 0;
+    for (std::size_t i = 0; i < postfix.size; ++i) {
+        const Token& t = postfix.items[i];
+        if (t.type == NUMBER) st[sp++] = t.value;
+        else if (t.type == OPERATOR) {
+            if (sp < 2) return nan();
+            double b = st[--sp];
+            double a = st[--sp];
+            st[sp++] = applyOp(a, b, t.op);
+        }
+    }
+    return sp == 1 ? st[0] : nan();
+}
+
+}
+
+// The postfix program for S, computed once per distinct expression.
+template <fixed_string S>
+inline constexpr auto program = ct::infixToPostfix(ct::tokenize(S));
+
+template <fixed_string S>
+consteval double eval() {
+    static_assert(ct::wellFormed(program<S>), "malformed wumbo expression");
+    return ct::evalPostfix(program<S>);
+}
+
+namespace literals {
+
+template <fixed_string S>
+consteval double operator""_wumbo() {
+    return eval<S>();
+}
+
+}
+
+}
@@ -0,0 +1,503 @@
+#include "compress.h"
+
+#include <cstring>
+#include <climits>
+#include <algorithm>
+#include <dlfcn.h>
+
+#if __has_include(<zlib.h>)
+#include <zlib.h>
+#define WUMBO_ZLIB 1
+#endif
+
+namespace wumbo {
+
+namespace {
+
+// A frame still incomplete after this many bytes is decompressed as it
+// streams in rather than held whole for a worker.
+constexpr size_t frameLimit = 64 << 20;
+
+// BGZF members hold at most 64 KiB; bgzip stops input a little short of
+// that so incompressible data still fits.
+constexpr size_t bgzfInput = 0xff00;
+constexpr size_t bgzfHeader = 18, bgzfTrailer = 8;
+
+void* openLibrary(std::initializer_list<const char*> names) {
+    for (const char* name : names)
+        if (void* lib = dlopen(name, RTLD_NOW | RTLD_LOCAL)) return lib;
+    return nullptr;
+}
+
+template <typename F>
+bool bind(void* lib, F& f, const char* name) {
+    f = reinterpret_cast<F>(dlsym(lib, name));
+    return f != nullptr;
+}
+
+uint32_t le32(const unsigned char* p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+void put32(std::string& out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out += (char)(v >> (8 * i));
+}
+
+// The parts of zstd's stable interface used here, declared locally so that
+// no header is needed either.
+struct ZstdIn {
+    const void* src;
+    size_t size, pos;
+};
+struct ZstdOut {
+    void* dst;
+    size_t size, pos;
+};
+
+struct Zstd {
+    size_t (*compress)(void*, size_t, const void*, size_t, int);
+    size_t (*compressBound)(size_t);
+    unsigned (*isError)(size_t);
+    size_t (*findFrameCompressedSize)(const void*, size_t);
+    void* (*createDStream)();
+    size_t (*freeDStream)(void*);
+    size_t (*initDStream)(void*);
+    size_t (*decompressStream)(void*, ZstdOut*, ZstdIn*);
+};
+
+const Zstd* zstd() {
+    static const Zstd* loaded = []() -> const Zstd* {
+        static Zstd z;
+        void* lib = openLibrary({"libzstd.so.1", "libzstd.so", "libzstd.1.dylib"});
+        if (!lib || !bind(lib, z.compress, "ZSTD_compress") || !bind(lib, z.compressBound, "ZSTD_compressBound") ||
+            !bind(lib, z.isError, "ZSTD_isError") ||
+            !bind(lib, z.findFrameCompressedSize, "ZSTD_findFrameCompressedSize") ||
+            !bind(lib, z.createDStream, "ZSTD_createDStream") || !bind(lib, z.freeDStream, "ZSTD_freeDStream") ||
+            !bind(lib, z.initDStream, "ZSTD_initDStream") ||
+            !bind(lib, z.decompressStream, "ZSTD_decompressStream"))
+            return nullptr;
+        return &z;
+    }();
+    return loaded;
+}
+
+#ifdef WUMBO_ZLIB
+struct Zlib {
+    int (*inflateInit2_)(z_stream*, int, const char*, int);
+    int (*inflate)(z_stream*, int);
+    int (*inflateReset)(z_stream*);
+    int (*inflateEnd)(z_stream*);
+    int (*deflateInit2_)(z_stream*, int, int, int, int, int, const char*, int);
+    int (*deflate)(z_stream*, int);
+    uLong (*deflateBound)(z_stream*, uLong);
+    int (*deflateEnd)(z_stream*);
+    uLong (*crc32)(uLong, const Bytef*, uInt);
+};
+
+const Zlib* zlib() {
+    static const Zlib* loaded = []() -> const Zlib* {
+        static Zlib z;
+        void* lib = openLibrary({"libz.so.1", "libz.so", "libz.1.dylib"});
+        if (!lib || !bind(lib, z.inflateInit2_, "inflateInit2_") || !bind(lib, z.inflate, "inflate") ||
+            !bind(lib, z.inflateReset, "inflateReset") || !bind(lib, z.inflateEnd, "inflateEnd") ||
+            !bind(lib, z.deflateInit2_, "deflateInit2_") || !bind(lib, z.deflate, "deflate") ||
+            !bind(lib, z.deflateBound, "deflateBound") || !bind(lib, z.deflateEnd, "deflateEnd") ||
+            !bind(lib, z.crc32, "crc32"))
+            return nullptr;
+        return &z;
+    }();
+    return loaded;
+}
+
+// One BGZF member holding data, which must deflate to fit.
+bool bgzfMember(const Zlib* z, std::string_view data, std::string& out) {
+    z_stream s{};
+    if (z->deflateInit2_(&s, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY, ZLIB_VERSION,
+                         (int)sizeof s) != Z_OK)
+        return false;
+    size_t at = out.size();
+    size_t bound = z->deflateBound(&s, (uLong)data.size());
+    out.resize(at + bgzfHeader + bound);
+    s.next_in = (Bytef*)data.data();
+    s.avail_in = (uInt)data.size();
+    s.next_out = (Bytef*)&out[at + bgzfHeader];
+    s.avail_out = (uInt)bound;
+    int r = z->deflate(&s, Z_FINISH);
+    size_t packed = s.total_out;
+    z->deflateEnd(&s);
+    size_t total = bgzfHeader + packed + bgzfTrailer;
+    if (r != Z_STREAM_END || total > 0x10000) {
+        out.resize(at);
+        return false;
+    }
+    static const unsigned char header[] = {0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0};
+    memcpy(&out[at], header, sizeof header);
+    out[at + 16] = (char)((total - 1) & 0xff);
+    out[at + 17] = (char)((total - 1) >> 8);
+    out.resize(at + bgzfHeader + packed);
+    put32(out, (uint32_t)z->crc32(0, (const Bytef*)data.data(), (uInt)data.size()));
+    put32(out, (uint32_t)data.size());
+    return true;
+}
+#endif
+
+// The length of the frame starting at p if it is one of the kind that can be
+// decompressed on its own: 0 if more than n bytes are needed to tell, -1 if
+// it is not.
+long frameLength(Codec codec, const unsigned char* p, size_t n) {
+    if (codec == CODEC_ZSTD) {
+        if (n < 4) return 0;
+        uint32_t magic = le32(p);
+        if (magic != 0xfd2fb528 && (magic & 0xfffffff0) != 0x184d2a50) return -1;
+        // An error here is as likely a frame not yet all read as a bad one;
+        // the frame limit or the end of input settles which.
+        size_t size = zstd()->findFrameCompressedSize(p, n);
+        return zstd()->isError(size) ? 0 : (long)size;
+    }
+    // A BGZF member: a gzip header with a "BC" extra field giving its size.
+    if (n < 12) return 0;
+    if (p[0] != 0x1f || p[1] != 0x8b || p[2] != 8 || !(p[3] & 4)) return -1;
+    size_t extra = p[10] | (size_t)p[11] << 8;
+    if (n < 12 + extra) return 0;
+    for (size_t i = 12; i + 4 <= 12 + extra;) {
+        size_t len = p[i + 2] | (size_t)p[i + 3] << 8;
+        if (p[i] == 'B' && p[i + 1] == 'C' && len == 2 && i + 6 <= 12 + extra) {
+            size_t size = (p[i + 4] | (size_t)p[i + 5] << 8) + 1;
+            return size <= n ? (long)size : 0;
+        }
+        i += 4 + len;
+    }
+    return -1;
+}
+
+}
+
+// Decompresses a stream of one codec frame after frame, a piece at a time.
+class DecompressingReader::Inflater {
+public:
+    explicit Inflater(Codec codec) : codec(codec) {
+        if (codec == CODEC_ZSTD) {
+            if ((dstream = zstd()->createDStream())) zstd()->initDStream(dstream);
+            ok = dstream != nullptr;
+        }
+#ifdef WUMBO_ZLIB
+        else
+            ok = zlib()->inflateInit2_(&z, MAX_WBITS + 16, ZLIB_VERSION, (int)sizeof z) == Z_OK;
+#endif
+    }
+
+    ~Inflater() {
+        if (codec == CODEC_ZSTD) {
+            if (dstream) zstd()->freeDStream(dstream);
+        }
+#ifdef WUMBO_ZLIB
+        else if (ok)
+            zlib()->inflateEnd(&z);
+#endif
+    }
+
+    // Decompresses from the front of in, dropping what it uses, into out,
+    // setting produced. False if the data is corrupt.
+    bool step(std::string_view& in, char* out, size_t room, size_t& produced) {
+        produced = 0;
+        if (!ok) return false;
+        size_t used = 0;
+        if (codec == CODEC_ZSTD) {
+            ZstdIn src{in.data(), in.size(), 0};
+            ZstdOut dst{out, room, 0};
+            size_t r = zstd()->decompressStream(dstream, &dst, &src);
+            if (zstd()->isError(r)) return false;
+            used = src.pos;
+            produced = dst.pos;
+            if (used) midFrame = true;
+            if (r == 0) midFrame = false;
+        }
+#ifdef WUMBO_ZLIB
+        else {
+            z.next_in = (Bytef*)in.data();
+            z.avail_in = (uInt)std::min<size_t>(in.size(), UINT_MAX);
+            z.next_out = (Bytef*)out;
+            z.avail_out = (uInt)std::min<size_t>(room, UINT_MAX);
+            int r = zlib()->inflate(&z, Z_NO_FLUSH);
+            if (r != Z_OK && r != Z_STREAM_END && r != Z_BUF_ERROR) return false;
+            used = (const char*)z.next_in - in.data();
+            produced = (char*)z.next_out - out;
+            if (used) midFrame = true;
+            // Members follow one another, each decompressed afresh.
+            if (r == Z_STREAM_END) {
+                zlib()->inflateReset(&z);
+                midFrame = false;
+            }
+        }
+#endif
+        // Input left, room to write and nothing done means the data is bad.
+        if (!used && !produced && !in.empty()) return false;
+        in.remove_prefix(used);
+        return true;
+    }
+
+    // True between the start of a frame and its end.
+    bool midFrame = false;
+
+private:
+    Codec codec;
+    bool ok = false;
+    void* dstream = nullptr;
+#ifdef WUMBO_ZLIB
+    z_stream z{};
+#endif
+};
+
+Codec codecForName(const std::string& path) {
+    auto endsWith = [&](const char* ext) {
+        size_t n = strlen(ext);
+        return path.size() > n && path.compare(path.size() - n, n, ext) == 0;
+    };
+    if (endsWith(".gz")) return CODEC_GZIP;
+    if (endsWith(".zst")) return CODEC_ZSTD;
+    return CODEC_NONE;
+}
+
+const char* codecExtension(Codec codec) {
+    return codec == CODEC_GZIP ? ".gz" : codec == CODEC_ZSTD ? ".zst" : "";
+}
+
+bool compressFrame(Codec codec, std::string_view data, std::string& out) {
+    if (codec == CODEC_NONE) {
+        out.append(data);
+        return true;
+    }
+    if (codec == CODEC_ZSTD) {
+        const Zstd* z = zstd();
+        if (!z) return false;
+        size_t at = out.size(), bound = z->compressBound(data.size());
+        out.resize(at + bound);
+        size_t n = z->compress(&out[at], bound, data.data(), data.size(), 3);
+        if (z->isError(n)) {
+            out.resize(at);
+            return false;
+        }
+        out.resize(at + n);
+        return true;
+    }
+#ifdef WUMBO_ZLIB
+    const Zlib* z = zlib();
+    if (!z) return false;
+    size_t at = out.size();
+    do {
+        // Halve a piece that will not fit in a member, as bgzip does.
+        size_t take = std::min(data.size(), bgzfInput);
+        while (!bgzfMember(z, data.substr(0, take), out)) {
+            if (take < 0x100) {
+                out.resize(at);
+                return false;
+            }
+            take /= 2;
+        }
+        data.remove_prefix(take);
+    } while (!data.empty());
+    return true;
+#else
+    return false;
+#endif
+}
+
+DecompressingReader::DecompressingReader(int fd, size_t blockBytes, unsigned threads)
+    : reader(fd, blockBytes), blockBytes(blockBytes), threads(std::max(1u, threads)) {}
+
+DecompressingReader::~DecompressingReader() {
+    {
+        std::lock_guard<std::mutex> lock(m);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (auto& t : workers) t.join();
+}
+
+bool DecompressingReader::fail(const std::string& why) {
+    if (error_.empty()) error_ = why;
+    return false;
+}
+
+// Reads enough to see whether the input is compressed and how.
+bool DecompressingReader::sniff() {
+    sniffed = true;
+    while (pending.size() < 4) {
+        std::string_view block;
+        if (!reader.next(block)) return fail("read error");
+        if (block.empty()) break;
+        consumed_ += block.size();
+        pending.append(block);
+    }
+    auto p = (const unsigned char*)pending.data();
+    if (pending.size() >= 2 && p[0] == 0x1f && p[1] == 0x8b)
+        codec_ = CODEC_GZIP;
+    else if (pending.size() >= 4 && (le32(p) == 0xfd2fb528 || (le32(p) & 0xfffffff0) == 0x184d2a50))
+        codec_ = CODEC_ZSTD;
+    if (codec_ == CODEC_NONE) return true;
+    if (codec_ == CODEC_ZSTD && !zstd()) return fail("zstd input needs libzstd, which could not be loaded");
+#ifdef WUMBO_ZLIB
+    if (codec_ == CODEC_GZIP && !zlib()) return fail("gzip input needs zlib, which could not be loaded");
+#else
+    if (codec_ == CODEC_GZIP) return fail("gzip input needs zlib, which this build was made without");
+#endif
+    return true;
+}
+
+// Sends the complete frames at the front of pending to the workers, or
+// failing that reads another block, or decides to stream.
+bool DecompressingReader::feed() {
+    size_t pos = 0;
+    bool sent = false;
+    while (dispatched - head < 2 * threads) {
+        // Gather consecutive frames up to about a block into one job.
+        size_t end = pos;
+        while (end - pos < blockBytes) {
+            long n = frameLength(codec_, (const unsigned char*)pending.data() + end, pending.size() - end);
+            if (n < 0 && end == pos) streaming = true;
+            if (n <= 0) break;
+            end += n;
+        }
+        if (end == pos) break;
+        if (workers.empty())
+            for (unsigned i = 0; i < threads; i++) workers.emplace_back(&DecompressingReader::work, this);
+        {
+            std::lock_guard<std::mutex> lock(m);
+            jobs.emplace_back(dispatched++, pending.substr(pos, end - pos));
+        }
+        cv.notify_all();
+        pos = end;
+        sent = true;
+    }
+    pending.erase(0, pos);
+    if (sent || streaming || dispatched - head >= 2 * threads) return true;
+    if (pending.size() > frameLimit) {
+        streaming = true;
+        return true;
+    }
+    std::string_view block;
+    if (!reader.next(block)) return fail("read error");
+    consumed_ += block.size();
+    if (block.empty()) {
+        inputDone = true;
+        if (!pending.empty()) return fail("compressed input is truncated or corrupt");
+    }
+    pending.append(block);
+    return true;
+}
+
+void DecompressingReader::work() {
+    for (;;) {
+        std::pair<size_t, std::string> job;
+        {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [&] { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        Result result;
+        Inflater inflater(codec_);
+        std::string_view in = job.second;
+        result.ok = true;
+        while (result.ok && !in.empty()) {
+            size_t at = result.text.size(), room = std::max(blockBytes, in.size() * 4), produced;
+            result.text.resize(at + room);
+            result.ok = inflater.step(in, &result.text[at], room, produced);
+            result.text.resize(at + produced);
+        }
+        result.ok = result.ok && !inflater.midFrame;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            results[job.first] = std::move(result);
+        }
+        cv.notify_all();
+    }
+}
+
+// 1 with the next job's text in block, 0 if it is not done yet, -1 if it
+// failed.
+int DecompressingReader::take(std::string_view& block, bool wait) {
+    std::unique_lock<std::mutex> lock(m);
+    if (wait) cv.wait(lock, [&] { return results.count(head) != 0; });
+    auto it = results.find(head);
+    if (it == results.end()) return 0;
+    bool ok = it->second.ok;
+    current = std::move(it->second.text);
+    results.erase(it);
+    head++;
+    if (!ok) {
+        fail("compressed input is corrupt");
+        return -1;
+    }
+    block = current;
+    return 1;
+}
+
+// Decompresses the rest of the input in order as it is read.
+bool DecompressingReader::stream(std::string_view& block) {
+    if (!inflater) {
+        inflater = std::make_unique<Inflater>(codec_);
+        pendingPos = 0;
+    }
+    current.resize(blockBytes);
+    for (;;) {
+        if (pendingPos == pending.size() && !inputDone) {
+            std::string_view more;
+            if (!reader.next(more)) return fail("read error");
+            consumed_ += more.size();
+            inputDone = more.empty();
+            pending.assign(more);
+            pendingPos = 0;
+        }
+        if (pendingPos == pending.size()) {
+            if (inflater->midFrame) return fail("compressed input is truncated");
+            return true;
+        }
+        std::string_view in(pending.data() + pendingPos, pending.size() - pendingPos);
+        size_t produced;
+        if (!inflater->step(in, &current[0], blockBytes, produced)) return fail("compressed input is corrupt");
+        pendingPos = pending.size() - in.size();
+        if (produced) {
+            block = std::string_view(current.data(), produced);
+            return true;
+        }
+    }
+}
+
+bool DecompressingReader::next(std::string_view& block) {
+    block = {};
+    if (!error_.empty()) return false;
+    if (!sniffed && !sniff()) return false;
+    if (codec_ == CODEC_NONE) {
+        // What sniffing read goes out first, then the file as it comes.
+        if (!pending.empty()) {
+            current = std::move(pending);
+            pending.clear();
+            block = current;
+            return true;
+        }
+        if (!reader.next(block)) return fail("read error");
+        consumed_ += block.size();
+        return true;
+    }
+    for (;;) {
+        if (head < dispatched) {
+            // Read and send out more while the oldest job is still running.
+            bool more = !streaming && !inputDone && dispatched - head < 2 * threads;
+            int got = take(block, !more);
+            if (got < 0) return false;
+            if (got > 0) {
+                if (block.empty()) continue;
+                return true;
+            }
+            if (!feed()) return false;
+            continue;
+        }
+        if (streaming) return stream(block);
+        if (inputDone) return true;
+        if (!feed()) return false;
+    }
+}
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+// gzip and zstd streams for batch files. Neither library is linked: each is
+// opened with dlopen the first time a file needs it, as plugins are, so
+// plain files never need them and a compressed file without its library
+// fails with a message saying so.
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <cstdint>
+
+#include "fileio.h"
+#include "parallel.h"
+
+namespace wumbo {
+
+enum Codec { CODEC_NONE, CODEC_GZIP, CODEC_ZSTD };
+
+// The codec a file name asks for by its extension, ".gz" or ".zst", which
+// codecExtension gives back.
+Codec codecForName(const std::string& path);
+const char* codecExtension(Codec codec);
+
+// Appends data to out compressed as a whole: a zstd frame, or gzip members
+// in the BGZF layout, which record their own length. Such pieces
+// concatenate into a valid file, so they can be compressed on separate
+// threads and decompressed again on separate threads.
+bool compressFrame(Codec codec, std::string_view data, std::string& out);
+
+// Reads fd like a BlockReader, decompressing it if it starts with a gzip or
+// zstd magic number and passing it through otherwise. Frames whose length
+// is known up front (zstd frames, BGZF members) are decompressed up to
+// threads at a time and handed out in order. Any other gzip stream, or a
+// frame too long to hold whole, is decompressed as it arrives.
+class DecompressingReader {
+public:
+    explicit DecompressingReader(int fd, size_t blockBytes = 1 << 20, unsigned threads = hardwareThreads());
+    ~DecompressingReader();
+    DecompressingReader(const DecompressingReader&) = delete;
+    DecompressingReader& operator=(const DecompressingReader&) = delete;
+
+    // The next block, valid until the following call; empty at the end of
+    // the input. False with error() set on a read or format error.
+    bool next(std::string_view& block);
+    Codec codec() const { return codec_; }
+    // Bytes read from fd so far.
+    uint64_t consumed() const { return consumed_; }
+    const std::string& error() const { return error_; }
+
+    class Inflater;
+
+private:
+    struct Result {
+        std::string text;
+        bool ok = false;
+    };
+
+    bool fail(const std::string& why);
+    bool sniff();
+    bool feed();
+    int take(std::string_view& block, bool wait);
+    bool stream(std::string_view& block);
+    void work();
+
+    BlockReader reader;
+    size_t blockBytes;
+    unsigned threads;
+    Codec codec_ = CODEC_NONE;
+    bool sniffed = false, streaming = false, inputDone = false;
+    uint64_t consumed_ = 0;
+    std::string error_;
+    // Compressed bytes read but not yet handed on, and in streaming mode how
+    // far the inflater has got through them.
+    std::string pending;
+    size_t pendingPos = 0;
+    std::string current;
+    std::unique_ptr<Inflater> inflater;
+
+    // Frames go out to the workers numbered and come back into results,
+    // which are taken in number order.
+    size_t head = 0, dispatched = 0;
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<std::pair<size_t, std::string>> jobs;
+    std::map<size_t, Result> results;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+};
+
+}
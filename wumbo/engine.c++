@@ -0,0 +1,285 @@
+#include "engine.h"
+
+#include <stack>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <memory_resource>
+
+namespace wumbo {
+
+const char* evalStatusName(EvalStatus s) {
+    switch (s) {
+        case EVAL_OK: return "ok";
+        case EVAL_ERROR: return "error";
+        case EVAL_TIMEOUT: return "time budget exceeded";
+        case EVAL_OUT_OF_MEMORY: return "memory budget exceeded";
+        case EVAL_CANCELLED: return "cancelled";
+    }
+    return "unknown";
+}
+
+std::vector<Token> tokenize(const std::string& expr, const SymbolTable* symbols, BudgetGuard* guard) {
+    std::vector<Token> tokens;
+    size_t i = 0, charged = 0;
+    while (i < expr.size()) {
+        if (guard && (!guard->tick() || !guard->track(tokens, charged))) break;
+        if (isspace(expr[i])) { i++; continue; }
+        if (isdigit(expr[i]) || expr[i] == '.') {
+            // strtod rather than stod(expr.substr(i)): the copy made every
+            // number cost O(rest of input), and stod throws on a lone '.'.
+            char* end;
+            double val = strtod(expr.c_str() + i, &end);
+            size_t len = end - (expr.c_str() + i);
+            if (len == 0) { i++; continue; }
+            i += len;
+            bool imaginary = i < expr.size() && expr[i] == 'i' && !(i + 1 < expr.size() && (isalnum(expr[i + 1]) || expr[i + 1] == '_'));
+            if (imaginary) i++;
+            tokens.push_back({NUMBER, val, imaginary ? 'i' : (char)0});
+        } else if (isalpha(expr[i]) || expr[i] == '_') {
+            size_t start = i;
+            while (i < expr.size() && (isalnum(expr[i]) || expr[i] == '_')) i++;
+            std::string name(expr, start, i - start);
+            const Binding* binding = symbols ? symbols->findValue(name) : nullptr;
+            if (name == "i" || name == "x") tokens.push_back({NUMBER, 1, name[0]});
+            else if (binding) tokens.push_back({NUMBER, 0, 'v', nullptr, 0, binding});
+            else tokens.push_back({FUNCTION, 0, 0, symbols ? symbols->findFunction(name) : findBuiltin(name)});
+        } else {
+            char c = expr[i];
+            if (c == '+' || c == '-' || c == '*' || c == '/' || c == '^') tokens.push_back({OPERATOR, 0, c});
+            else if (c == '(' || c == '[') tokens.push_back({LPAREN, 0, c == '[' ? '[' : (char)0});
+            else if (c == ')' || c == ']') tokens.push_back({RPAREN, 0, c == ']' ? ']' : (char)0});
+            else if (c == ',') tokens.push_back({COMMA, 0, 0});
+            else if (c == '!') tokens.push_back({FUNCTION, 0, '!', findBuiltin("factorial"), 1});
+            i++;
+        }
+    }
+    return tokens;
+}
+
+int precedence(char op) {
+    switch (op) {
+        case '^': return 4;
+        case '*': case '/': return 3;
+        case '+': case '-': return 2;
+        default: return 0;
+    }
+}
+
+double applyOp(double a, double b, char op) {
+    switch (op) {
+        case '+': return a + b;
+        case '-': return a - b;
+        case '*': return a * b;
+        case '/': return b != 0 ? a / b : NAN;
+        case '^': return pow(a, b);
+        default: return NAN;
+    }
+}
+
+std::vector<Token> infixToPostfix(const std::vector<Token>& tokens, BudgetGuard* guard) {
+    std::vector<Token> output;
+    std::stack<Token> ops;
+    // Commas seen so far in each open parenthesis, to count call arguments.
+    std::vector<int> commas;
+    TokenType prev = LPAREN;
+    size_t charged = 0;
+    auto popUntilLParen = [&]() {
+        while (!ops.empty() && ops.top().type != LPAREN) {
+            output.push_back(ops.top());
+            ops.pop();
+        }
+    };
+    // Closes the innermost parenthesis, emitting the call or list it belongs to.
+    auto closeParen = [&](bool empty) {
+        popUntilLParen();
+        if (ops.empty()) return;
+        bool list = ops.top().op == '[';
+        ops.pop();
+        int argc = empty ? 0 : commas.back() + 1;
+        commas.pop_back();
+        if (list) output.push_back({LIST, 0, 0, nullptr, argc});
+        else if (!ops.empty() && ops.top().type == FUNCTION) {
+            output.push_back(ops.top());
+            output.back().argc = argc;
+            ops.pop();
+        }
+    };
+    for (auto& t : tokens) {
+        if (guard && (!guard->tick() || !guard->track(output, charged))) break;
+        if (t.type == NUMBER) output.push_back(t);
+        else if (t.type == OPERATOR) {
+            while (!ops.empty() && ops.top().type == OPERATOR) {
+                if ((precedence(ops.top().op) > precedence(t.op)) ||
+                    (precedence(ops.top().op) == precedence(t.op) && t.op != '^')) {
+                    output.push_back(ops.top());
+                    ops.pop();
+                } else break;
+            }
+            ops.push(t);
+        } else if (t.type == FUNCTION && t.op == '!') {
+            // Postfix and binding tighter than any operator, so its operand
+            // is already complete on the output.
+            output.push_back(t);
+        } else if (t.type == FUNCTION) ops.push(t);
+        else if (t.type == LPAREN) {
+            ops.push(t);
+            commas.push_back(0);
+        } else if (t.type == COMMA) {
+            popUntilLParen();
+            if (!commas.empty()) commas.back()++;
+        } else if (t.type == RPAREN) closeParen(prev == LPAREN);
+        prev = t.type;
+    }
+    // Unclosed parentheses are closed at the end of the input.
+    while (!ops.empty()) {
+        if (ops.top().type == LPAREN) closeParen(false);
+        else {
+            output.push_back(ops.top());
+            ops.pop();
+        }
+    }
+    return output;
+}
+
+bool complexMode(const std::vector<Token>& postfix) {
+    for (auto& t : postfix)
+        if (t.type == NUMBER && t.op == 'i') return true;
+    return false;
+}
+
+bool exactMode(const std::vector<Token>& postfix) {
+    static const Function* exact = findBuiltin("exact");
+    for (auto& t : postfix)
+        if (t.type == FUNCTION && t.fn == exact) return true;
+    return false;
+}
+
+bool needsValues(const std::vector<Token>& postfix) {
+    for (auto& t : postfix)
+        if ((t.type == NUMBER && t.op) || t.type == LIST || (t.type == FUNCTION && t.fn && !t.fn->scalar))
+            return true;
+    return false;
+}
+
+double evalPostfix(const std::vector<Token>& postfix, BudgetGuard* guard, EvalResult* result) {
+    if (needsValues(postfix)) return evalValues(postfix, guard, result).toDouble();
+    std::stack<double> st;
+    for (auto& t : postfix) {
+        if (guard && !guard->tick()) {
+            if (result && !st.empty()) result->partial = st.top();
+            return NAN;
+        }
+        if (t.type == NUMBER) st.push(t.value);
+        else if (t.type == OPERATOR) {
+            if (st.size() < 2) return NAN;
+            double b = st.top(); st.pop();
+            double a = st.top(); st.pop();
+            st.push(applyOp(a, b, t.op));
+        } else if (t.type == FUNCTION) {
+            if (!t.fn || t.argc != t.fn->arity || (int)st.size() < t.argc) return NAN;
+            double args[maxArity];
+            for (int j = t.argc - 1; j >= 0; --j) { args[j] = st.top(); st.pop(); }
+            st.push(t.fn->call(args));
+        }
+    }
+    if (st.size() != 1) return NAN;
+    return st.top();
+}
+
+Value evalValues(const std::vector<Token>& postfix, BudgetGuard* guard, EvalResult* result) {
+    bool complex = complexMode(postfix), exact = !complex && exactMode(postfix);
+    // The stack starts in a local arena and only goes to the heap for
+    // expressions nested deeper than it holds.
+    alignas(Value) char arena[64 * sizeof(Value)];
+    std::pmr::monotonic_buffer_resource resource(arena, sizeof(arena));
+    std::pmr::vector<Value> st(&resource);
+    st.reserve(32);
+    for (auto& t : postfix) {
+        if (guard && !guard->tick()) {
+            if (result && !st.empty()) result->partial = st.back();
+            return NAN;
+        }
+        size_t before = guard ? guard->bytes() : 0;
+        if (t.type == NUMBER) {
+            if (t.op == 'i') st.push_back(std::complex<double>(0, t.value));
+            else if (t.op == 'x') st.push_back(Value::poly({0, 1}));
+            else if (t.op == 'v') st.push_back(t.binding->get());
+            else if (complex) st.push_back(std::complex<double>(t.value, 0));
+            else if (exact && std::isfinite(t.value)) st.push_back(Value(ExactReal::fromDouble(t.value)));
+            else st.push_back(t.value);
+        } else if (t.type == OPERATOR) {
+            if (st.size() < 2) return NAN;
+            Value b = st.back(); st.pop_back();
+            st.back() = applyOp(st.back(), b, t.op, guard);
+        } else if (t.type == FUNCTION) {
+            if (!t.fn || t.argc != t.fn->arity || (int)st.size() < t.argc) return NAN;
+            Value r = t.fn->callValues(st.data() + st.size() - t.argc, guard);
+            st.resize(st.size() - t.argc);
+            st.push_back(r);
+        } else if (t.type == LIST) {
+            if ((int)st.size() < t.argc) return NAN;
+            std::vector<Value> items(st.end() - t.argc, st.end());
+            st.resize(st.size() - t.argc);
+            st.push_back(std::move(items));
+        }
+        // Operations that allocate much charge the guard ahead; only what the
+        // result holds beyond that is charged here.
+        size_t held = st.empty() ? 0 : st.back().heapBytes(), ahead = guard ? guard->bytes() - before : 0;
+        if (guard && held > ahead && !guard->charge(held - ahead)) {
+            if (result) result->partial = st.back();
+            return NAN;
+        }
+    }
+    if (st.size() != 1) return NAN;
+    return st.back();
+}
+
+bool wellFormed(const std::vector<Token>& postfix) {
+    long depth = 0;
+    for (auto& t : postfix) {
+        if (t.type == NUMBER) depth++;
+        else if (t.type == OPERATOR && --depth < 1) return false;
+        else if (t.type == FUNCTION) {
+            if (!t.fn || t.argc != t.fn->arity || depth < t.argc) return false;
+            depth += 1 - t.argc;
+        } else if (t.type == LIST) {
+            if (depth < t.argc) return false;
+            depth += 1 - t.argc;
+        }
+    }
+    return depth == 1;
+}
+
+EvalResult evaluate(const std::string& expr, const EvalBudget& budget, const SymbolTable* symbols) {
+    EvalResult result;
+    BudgetGuard guard(budget, result);
+    guard.beginStage("tokenize", expr.size());
+    auto tokens = tokenize(expr, symbols, &guard);
+    if (!guard.check()) return result;
+    guard.beginStage("parse", tokens.size());
+    auto postfix = infixToPostfix(tokens, &guard);
+    if (!guard.check()) return result;
+    guard.beginStage("evaluate", postfix.size());
+    if (!guard.charge(postfix.size() * sizeof(double))) return result;
+    result.value = evalValues(postfix, &guard, &result);
+    if (guard.check() && result.value.isError()) result.status = EVAL_ERROR;
+    result.seconds = guard.elapsed();
+    return result;
+}
+
+Program compile(const std::string& expr, const SymbolTable* symbols) {
+    return {infixToPostfix(tokenize(expr, symbols))};
+}
+
+double run(const Program& program) {
+    return evalPostfix(program.postfix);
+}
+
+double evaluate(const std::string& expr, const SymbolTable* symbols) {
+    auto tokens = tokenize(expr, symbols);
+    auto postfix = infixToPostfix(tokens);
+    return evalPostfix(postfix);
+}
+
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+// The evaluation engine: tokenizer, shunting-yard and postfix evaluator. It
+// holds no global state and does not depend on SDL, so any number of threads
+// can evaluate at once. wumbo.h wraps it in a C ABI.
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "symbols.h"
+
+namespace wumbo {
+
+// NUMBER tokens with op 'i' are imaginary literals ("2i", or "i" alone),
+// with op 'x' the polynomial variable x, and with op 'v' a named value, read
+// from binding when evaluated.
+// FUNCTION tokens carry the function their identifier was bound to, null if
+// the name is unknown; infixToPostfix fills in argc, the number of arguments
+// the call was written with. A postfix "!" is a FUNCTION token with op '!'
+// calling the factorial built-in on the operand before it. Brackets are parentheses with op '[' or ']', and
+// a bracketed list "[a, b, c]" becomes a LIST token with argc elements.
+enum TokenType { NUMBER, OPERATOR, LPAREN, RPAREN, FUNCTION, COMMA, LIST };
+struct Token {
+    TokenType type;
+    double value;
+    char op;
+    const Function* fn = nullptr;
+    int argc = 0;
+    const Binding* binding = nullptr;
+};
+
+// Outcome of an evaluation. Anything other than EVAL_OK comes with an error value.
+enum EvalStatus { EVAL_OK, EVAL_ERROR, EVAL_TIMEOUT, EVAL_OUT_OF_MEMORY, EVAL_CANCELLED };
+
+const char* evalStatusName(EvalStatus s);
+
+// Limits for a single evaluation; zero means unlimited. progress is called
+// every so often with the work done and total work of the current stage and
+// cancels the evaluation by returning false.
+struct EvalBudget {
+    double maxSeconds = 0;
+    size_t maxBytes = 0;
+    std::function<bool(const char* stage, size_t done, size_t total)> progress;
+};
+
+// What an evaluation got done. When it stops early, stage/done/total say how
+// far it got and partial holds the innermost value computed so far.
+struct EvalResult {
+    Value value;
+    EvalStatus status = EVAL_OK;
+    const char* stage = "";
+    size_t done = 0, total = 0;
+    Value partial;
+    double seconds = 0;
+    size_t peakBytes = 0;
+};
+
+// Cooperative budget checks shared by every stage of an evaluation. Loops call
+// tick() once per unit of work and charge() for memory they hold on to; the
+// clock is only read every checkInterval ticks to keep the check cheap.
+class BudgetGuard {
+public:
+    BudgetGuard(const EvalBudget& budget, EvalResult& result)
+        : budget(budget), result(result), start(std::chrono::steady_clock::now()) {}
+
+    void beginStage(const char* stage, size_t total) {
+        result.stage = stage;
+        result.done = 0;
+        result.total = total;
+    }
+
+    bool tick(size_t steps = 1) {
+        result.done += steps;
+        countdown = countdown > steps ? countdown - steps : 0;
+        if (countdown == 0) {
+            countdown = checkInterval;
+            return check();
+        }
+        return result.status == EVAL_OK;
+    }
+
+    bool charge(size_t bytes) {
+        bytes_ += bytes;
+        result.peakBytes = std::max(result.peakBytes, bytes_);
+        if (budget.maxBytes && bytes_ > budget.maxBytes) return fail(EVAL_OUT_OF_MEMORY);
+        return result.status == EVAL_OK;
+    }
+
+    // For work about to take steps ticks and allocate bytes, so that it is
+    // refused before it starts rather than found over budget after.
+    bool reserve(size_t steps, size_t bytes) {
+        return tick(steps) && charge(bytes);
+    }
+
+    // Charges whatever v has grown by since the last call for it.
+    template <typename T> bool track(const std::vector<T>& v, size_t& charged) {
+        size_t bytes = v.capacity() * sizeof(T);
+        if (bytes <= charged) return result.status == EVAL_OK;
+        size_t grown = bytes - charged;
+        charged = bytes;
+        return charge(grown);
+    }
+
+    bool check() {
+        if (result.status != EVAL_OK) return false;
+        result.seconds = elapsed();
+        if (budget.maxSeconds > 0 && result.seconds > budget.maxSeconds) return fail(EVAL_TIMEOUT);
+        if (budget.progress && !budget.progress(result.stage, result.done, result.total)) return fail(EVAL_CANCELLED);
+        return true;
+    }
+
+    bool fail(EvalStatus status) {
+        if (result.status == EVAL_OK) result.status = status;
+        return false;
+    }
+
+    size_t bytes() const { return bytes_; }
+
+    double elapsed() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    static constexpr size_t checkInterval = 4096;
+    const EvalBudget& budget;
+    EvalResult& result;
+    std::chrono::steady_clock::time_point start;
+    size_t countdown = checkInterval;
+    size_t bytes_ = 0;
+};
+
+// A compiled expression: its postfix form, ready to be evaluated repeatedly.
+struct Program {
+    std::vector<Token> postfix;
+};
+
+// Identifiers are looked up in symbols; without a table every identifier is
+// unknown and any expression using one evaluates to NaN.
+std::vector<Token> tokenize(const std::string& expr, const SymbolTable* symbols = nullptr, BudgetGuard* guard = nullptr);
+int precedence(char op);
+double applyOp(double a, double b, char op);
+std::vector<Token> infixToPostfix(const std::vector<Token>& tokens, BudgetGuard* guard = nullptr);
+// Expressions containing an imaginary literal are evaluated in complex mode:
+// every value is complex, so sqrt(-4)+0i is 2i where sqrt(-4) alone is NaN.
+bool complexMode(const std::vector<Token>& postfix);
+// Expressions calling exact() outside complex mode are evaluated in exact
+// mode: every literal is the exact decimal it was written as, so
+// exact(0.1+0.2-0.3) is 0, and results are exact reals, whose digits are
+// computed as they are printed.
+bool exactMode(const std::vector<Token>& postfix);
+// True for programs only evalValues can run: complex mode, list literals, the
+// variable x, named values, or calls to functions that have no double form (such as fft
+// and exact).
+bool needsValues(const std::vector<Token>& postfix);
+// The double evaluator; a program that needsValues yields its value if that
+// is a number on the real axis and NaN otherwise.
+double evalPostfix(const std::vector<Token>& postfix, BudgetGuard* guard = nullptr, EvalResult* result = nullptr);
+Value evalValues(const std::vector<Token>& postfix, BudgetGuard* guard = nullptr, EvalResult* result = nullptr);
+// True if postfix calls only known functions with the right argument count
+// and leaves exactly one value.
+bool wellFormed(const std::vector<Token>& postfix);
+
+Program compile(const std::string& expr, const SymbolTable* symbols = nullptr);
+double run(const Program& program);
+
+EvalResult evaluate(const std::string& expr, const EvalBudget& budget, const SymbolTable* symbols = nullptr);
+double evaluate(const std::string& expr, const SymbolTable* symbols = nullptr);
+
+}
@@ -0,0 +1,516 @@
+#include "exact.h"
+
+#include <mutex>
+#include <atomic>
+#include <cmath>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+namespace wumbo {
+
+namespace {
+
+// The position of a leading digit not yet seen at the precision tried.
+constexpr long unknownMsd = LONG_MIN;
+// exp() refuses arguments beyond this, whose results have more digits than
+// maxBigDigits.
+constexpr long maxExpHundredths = 1000000000;
+
+// Set by format() for the thread it runs on; approximations on that thread
+// give up once it reads true.
+thread_local const std::atomic<bool>* stopFlag = nullptr;
+
+bool stopped() {
+    return stopFlag && stopFlag->load(std::memory_order_relaxed);
+}
+
+// Magnitude bounds are clamped to within this of zero.
+constexpr long noBound = (long)maxBigDigits + 2;
+
+long clampBound(long b) {
+    return std::max(-noBound, std::min(b, noBound));
+}
+
+long digitCount(long n) {
+    long d = 1;
+    for (; n >= 10; n /= 10) d++;
+    return d;
+}
+
+long floorHalf(long p) {
+    return p >= 0 ? p / 2 : -((1 - p) / 2);
+}
+
+// Guard digits for a series summed at precision p: one unit of rounding per
+// term, and no series here needs more than 4 terms per digit.
+long seriesPrecision(long p) {
+    long digits = -std::min(p, 0L);
+    return std::min(p, 0L) - digitCount(4 * digits + 20) - 2;
+}
+
+}
+
+// An approximation at precision p is an integer within 1 of x 10^-p, so p
+// is the decimal position of its last digit, negative for fractions. Nodes
+// are shared between the values built from them and may be approximated
+// from several threads; the lock covers the memo, and is only ever taken
+// from a parent, so locks are acquired in DAG order.
+struct ExactReal::Node {
+    virtual ~Node() = default;
+
+    bool approx(long p, BigInt& m) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (valid && prec <= p) {
+            m = prec == p ? appr : appr.scaleDecimal(prec - p);
+            return true;
+        }
+        if (p < -(long)maxBigDigits || stopped() || !compute(p, m)) return false;
+        valid = true;
+        prec = p;
+        appr = m;
+        return true;
+    }
+
+    // Sets msd to the position of the leading digit, roughly, if |x| is
+    // seen to be above 10^p: then 10^msd / 2 <= |x| < 10^(msd + 1).
+    // Otherwise msd is unknownMsd and |x| < 10^p.
+    bool msd(long p, long& msd) {
+        BigInt m;
+        if (!approx(p - 1, m)) return false;
+        msd = m.abs() < BigInt(2) ? unknownMsd : p - 2 + (long)m.digits();
+        return true;
+    }
+
+    // A b with |x| < 10^b, as tight as the node can cheaply tell; noBound
+    // if it cannot.
+    long bound() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!bounded) {
+            boundValue = clampBound(computeBound());
+            bounded = true;
+        }
+        return boundValue;
+    }
+
+    // msd() from coarse to fine. Above the point, the precision starts just
+    // under bound() and drops by eighths from there and, once the value shows,
+    // is bisected back up, so even a huge value is placed from a few digits
+    // rather than its whole integer part. Below it, precisions grow half
+    // again each time down to limit, so a small value costs no more digits
+    // than it needs.
+    bool iterMsd(long limit, long& out) {
+        long unseen = bound();
+        for (long seen = unseen - 16; seen > 0; unseen = seen, seen /= 8) {
+            if (!msd(seen, out)) return false;
+            if (out == unknownMsd) continue;
+            while (unseen - seen > 16) {
+                long mid = seen + (unseen - seen) / 2, m;
+                if (!msd(mid, m)) return false;
+                if (m == unknownMsd) unseen = mid;
+                else {
+                    seen = mid;
+                    out = m;
+                }
+            }
+            return true;
+        }
+        for (long p = 0; p > limit + 30; p = p * 3 / 2 - 16) {
+            if (!msd(p, out)) return false;
+            if (out != unknownMsd) return true;
+        }
+        return msd(limit, out);
+    }
+
+    virtual bool compute(long p, BigInt& m) = 0;
+    virtual long computeBound() { return noBound; }
+
+    std::mutex mutex;
+    bool valid = false, bounded = false;
+    long prec = 0, boundValue = 0;
+    BigInt appr;
+};
+
+namespace {
+
+typedef std::shared_ptr<ExactReal::Node> NodePtr;
+
+struct Decimal : ExactReal::Node {
+    Decimal(BigInt m, long e) : m(std::move(m)), e(e) {}
+    bool compute(long p, BigInt& out) override {
+        out = m.scaleDecimal(e - p);
+        return true;
+    }
+    long computeBound() override { return m.isZero() ? -noBound : (long)m.digits() + e; }
+    BigInt m;
+    long e;
+};
+
+struct Add : ExactReal::Node {
+    Add(NodePtr a, NodePtr b) : a(std::move(a)), b(std::move(b)) {}
+    // Two errors under a unit at p - 1 and the final rounding stay under
+    // one at p.
+    bool compute(long p, BigInt& out) override {
+        BigInt x, y;
+        if (!a->approx(p - 1, x) || !b->approx(p - 1, y)) return false;
+        out = (x + y).scaleDecimal(-1);
+        return true;
+    }
+    long computeBound() override { return std::max(a->bound(), b->bound()) + 1; }
+    NodePtr a, b;
+};
+
+struct Negate : ExactReal::Node {
+    explicit Negate(NodePtr a) : a(std::move(a)) {}
+    bool compute(long p, BigInt& out) override {
+        if (!a->approx(p, out)) return false;
+        out = -out;
+        return true;
+    }
+    long computeBound() override { return a->bound(); }
+    NodePtr a;
+};
+
+struct Abs : ExactReal::Node {
+    explicit Abs(NodePtr a) : a(std::move(a)) {}
+    bool compute(long p, BigInt& out) override {
+        if (!a->approx(p, out)) return false;
+        out = out.abs();
+        return true;
+    }
+    long computeBound() override { return a->bound(); }
+    NodePtr a;
+};
+
+// Each factor is needed to three digits past the point where the other's
+// magnitude would make its error matter. If both are too small to bound,
+// the product is too small to see.
+struct Multiply : ExactReal::Node {
+    Multiply(NodePtr a, NodePtr b) : a(std::move(a)), b(std::move(b)) {}
+    bool compute(long p, BigInt& out) override {
+        ExactReal::Node *x = a.get(), *y = b.get();
+        long half = floorHalf(p) - 1, msdX, msdY;
+        if (!x->msd(half, msdX)) return false;
+        if (msdX == unknownMsd) {
+            if (!y->msd(half, msdY)) return false;
+            if (msdY == unknownMsd) {
+                out = BigInt();
+                return true;
+            }
+            std::swap(x, y);
+            msdX = msdY;
+        }
+        long precY = p - msdX - 3;
+        BigInt ay, ax;
+        if (!y->approx(precY, ay)) return false;
+        if (ay.isZero()) {
+            out = BigInt();
+            return true;
+        }
+        long precX = p - (precY + (long)ay.digits() - 1) - 3;
+        if (!x->approx(precX, ax)) return false;
+        out = (ax * ay).scaleDecimal(precX + precY - p);
+        return true;
+    }
+    long computeBound() override { return a->bound() + b->bound(); }
+    NodePtr a, b;
+};
+
+// 10^-p / x from x to four digits more than the quotient has, which needs
+// x to be told apart from zero first.
+struct Inverse : ExactReal::Node {
+    explicit Inverse(NodePtr a) : a(std::move(a)) {}
+    bool compute(long p, BigInt& out) override {
+        long msd;
+        if (!a->iterMsd(-ExactReal::zeroDigits, msd) || msd == unknownMsd) return false;
+        long digits = 4 - msd - p, precNeeded = msd - digits, scale = -p - precNeeded;
+        if (scale < 0) {
+            out = BigInt();
+            return true;
+        }
+        BigInt d;
+        if (!a->approx(precNeeded, d)) return false;
+        BigInt q = (BigInt(1).scaleDecimal(scale) + d.abs() / BigInt(2)) / d.abs();
+        out = d.negative() ? -q : q;
+        return true;
+    }
+    NodePtr a;
+};
+
+// The integer root of x 10^(2 - 2p) is within two units at p - 1. An error
+// of d in x moves the root by about d / (2 sqrt x), so a large x needs its
+// own precision only to p plus half its digits, padded out with zeros; one
+// too small to bound is short at twice the precision anyway.
+struct Sqrt : ExactReal::Node {
+    explicit Sqrt(NodePtr a) : a(std::move(a)) {}
+    bool compute(long p, BigInt& out) override {
+        long msd;
+        if (!a->msd(p - 1, msd)) return false;
+        long q = msd == unknownMsd ? 2 * (p - 1) : std::max(2 * (p - 1), p - 1 + floorHalf(msd));
+        BigInt v;
+        if (!a->approx(q, v)) return false;
+        if (v.negative()) {
+            if (v < BigInt(1, true)) return false;
+            v = BigInt();
+        }
+        out = isqrt(v.scaleDecimal(q - 2 * (p - 1))).scaleDecimal(-1);
+        return true;
+    }
+    long computeBound() override {
+        long b = a->bound();
+        return b >= 0 ? (b + 1) / 2 : b / 2;
+    }
+    NodePtr a;
+};
+
+// The Taylor series for |x| up to about a tenth, and e^x = (e^(x/2))^2 to
+// get there.
+struct Exp : ExactReal::Node {
+    explicit Exp(NodePtr a) : a(std::move(a)) {}
+    bool prepare() {
+        if (checked) return true;
+        if (!a->approx(-2, hundredths)) return false;
+        if (BigInt(maxExpHundredths) < hundredths.abs()) return false;
+        if (BigInt(10) < hundredths.abs()) {
+            auto half = std::make_shared<Exp>(std::make_shared<Multiply>(a, std::make_shared<Decimal>(BigInt(5), -1)));
+            reduced = std::make_shared<Multiply>(half, half);
+        }
+        checked = true;
+        return true;
+    }
+    bool compute(long p, BigInt& out) override {
+        if (!prepare()) return false;
+        if (reduced) return reduced->approx(p, out);
+        long cp = seriesPrecision(p);
+        BigInt x;
+        if (!a->approx(cp, x)) return false;
+        BigInt one = BigInt(1).scaleDecimal(-cp), term = one, sum = one;
+        for (unsigned long k = 1; !term.isZero(); ++k) {
+            if (stopped()) return false;
+            term = (term * x).scaleDecimal(cp) / BigInt(k);
+            sum = sum + term;
+        }
+        out = sum.scaleDecimal(cp - p);
+        return true;
+    }
+    // x is under a hundredth above hundredths / 100, so e^x is under
+    // 10^((hundredths + 1) / 100 log10 e).
+    long computeBound() override {
+        if (!prepare()) return noBound;
+        return (long)std::floor(std::max(0.0, hundredths.toDouble() + 1) / 100 * M_LOG10E) + 1;
+    }
+    NodePtr a, reduced;
+    BigInt hundredths;
+    bool checked = false;
+};
+
+NodePtr ln10();
+
+// log x = 2 atanh((x - 1) / (x + 1)), whose series gains two and a half
+// digits a term for x within a tenth of one. Outside that, log x =
+// -log(1/x) below a half, log(x 10^-k) + k log 10 above ten, bringing x
+// between one and ten, and 2 log(sqrt x) in between.
+struct Log : ExactReal::Node {
+    explicit Log(NodePtr a) : a(std::move(a)) {}
+    bool prepare() {
+        if (checked) return true;
+        if (!a->approx(-2, hundredths)) return false;
+        if (hundredths < BigInt(1, true)) return false;
+        if (!(BigInt(50) < hundredths)) {
+            reduced = std::make_shared<Negate>(std::make_shared<Log>(std::make_shared<Inverse>(a)));
+        } else if (BigInt(1000) < hundredths) {
+            long k = (long)hundredths.digits() - 3;
+            auto scaled = std::make_shared<Multiply>(a, std::make_shared<Decimal>(BigInt(1), -k));
+            reduced = std::make_shared<Add>(std::make_shared<Log>(scaled),
+                                            std::make_shared<Multiply>(std::make_shared<Decimal>(BigInt(k), 0), ln10()));
+        } else if (hundredths < BigInt(90) || BigInt(110) < hundredths) {
+            auto root = std::make_shared<Log>(std::make_shared<Sqrt>(a));
+            reduced = std::make_shared<Multiply>(std::make_shared<Decimal>(BigInt(2), 0), root);
+        }
+        checked = true;
+        return true;
+    }
+    bool compute(long p, BigInt& out) override {
+        if (!prepare()) return false;
+        if (reduced) return reduced->approx(p, out);
+        long cp = seriesPrecision(p);
+        BigInt x;
+        if (!a->approx(cp, x)) return false;
+        BigInt one = BigInt(1).scaleDecimal(-cp);
+        BigInt z = (x - one).scaleDecimal(-cp) / (x + one), z2 = (z * z).scaleDecimal(cp), power = z, sum;
+        for (unsigned long k = 1; !power.isZero(); k += 2) {
+            if (stopped()) return false;
+            sum = sum + power / BigInt(k);
+            power = (power * z2).scaleDecimal(cp);
+        }
+        out = (sum + sum).scaleDecimal(cp - p);
+        return true;
+    }
+    // From x above a half and below 10^b, |log x| < 3 max(b, 1).
+    long computeBound() override {
+        if (!prepare() || !(BigInt(50) < hundredths)) return noBound;
+        return digitCount(3 * std::max(a->bound(), 1L));
+    }
+    NodePtr a, reduced;
+    BigInt hundredths;
+    bool checked = false;
+};
+
+// Shared by every logarithm, so its digits are worked out once.
+NodePtr ln10() {
+    static const NodePtr node = std::make_shared<Log>(std::make_shared<Decimal>(BigInt(10), 0));
+    return node;
+}
+
+const Decimal* constant(const std::shared_ptr<ExactReal::Node>& n) {
+    return dynamic_cast<const Decimal*>(n.get());
+}
+
+}
+
+ExactReal::ExactReal(BigInt m, long e) : node_(std::make_shared<Decimal>(std::move(m), e)) {}
+
+ExactReal ExactReal::fromDouble(double x) {
+    char buf[40];
+    for (int digits = 1; digits <= 17; ++digits) {
+        snprintf(buf, sizeof(buf), "%.*e", digits - 1, x);
+        if (strtod(buf, nullptr) == x) break;
+    }
+    // buf is [-]d.ddde[+-]xx.
+    uint64_t m = 0;
+    long shown = -1;
+    const char* s = buf + (buf[0] == '-');
+    for (; *s != 'e'; ++s)
+        if (*s != '.') {
+            m = m * 10 + (*s - '0');
+            shown++;
+        }
+    return ExactReal(BigInt(m, buf[0] == '-'), strtol(s + 1, nullptr, 10) - shown);
+}
+
+bool ExactReal::isZero() const {
+    const Decimal* c = constant(node_);
+    return c && c->m.isZero();
+}
+
+bool ExactReal::wholeConstant(long& n) const {
+    const Decimal* c = constant(node_);
+    if (!c || c->e > 18) return false;
+    BigInt whole = c->m.scaleDecimal(c->e);
+    unsigned __int128 mag;
+    if (c->e < 0 && !(whole.scaleDecimal(-c->e) - c->m).isZero()) return false;
+    if (!whole.smallMagnitude(mag) || mag >> 63) return false;
+    n = whole.negative() ? -(long)mag : (long)mag;
+    return true;
+}
+
+bool ExactReal::approx(long p, BigInt& m) const {
+    return node_->approx(p, m);
+}
+
+bool ExactReal::format(int digits, std::string& out, const std::atomic<bool>* stop) const {
+    struct Scope {
+        const std::atomic<bool>* saved = stopFlag;
+        ~Scope() { stopFlag = saved; }
+    } scope;
+    if (stop) stopFlag = stop;
+    long msd;
+    if (!node_->iterMsd(-zeroDigits, msd)) return false;
+    if (msd == unknownMsd) {
+        out = "0";
+        return true;
+    }
+    // One digit more than wanted, since msd can be one too high; then
+    // rounded to exactly digits of them, carrying 9.99... up to 10.0...
+    long p = msd - digits;
+    BigInt m;
+    if (!approx(p, m)) return false;
+    long extra = (long)m.digits() - digits;
+    m = m.scaleDecimal(-extra);
+    p += extra;
+    if ((long)m.digits() > digits) {
+        m = m.scaleDecimal(-1);
+        p++;
+    }
+    std::string s = m.abs().toString();
+    long e = p + digits - 1;
+    out = m.negative() ? "-" : "";
+    if (e < -4 || e >= digits) {
+        std::string frac = s.substr(1);
+        frac.erase(frac.find_last_not_of('0') + 1);
+        char exp[32];
+        snprintf(exp, sizeof(exp), "e%c%02ld", e < 0 ? '-' : '+', e < 0 ? -e : e);
+        out += s.substr(0, 1) + (frac.empty() ? "" : "." + frac) + exp;
+        return true;
+    }
+    std::string whole = e >= 0 ? s.substr(0, e + 1) : "0";
+    std::string frac = e >= 0 ? s.substr(e + 1) : std::string(-e - 1, '0') + s;
+    frac.erase(frac.find_last_not_of('0') + 1);
+    out += whole + (frac.empty() ? "" : "." + frac);
+    return true;
+}
+
+double ExactReal::toDouble() const {
+    std::string s;
+    return format(17, s) ? strtod(s.c_str(), nullptr) : NAN;
+}
+
+// Constants combine into constants, so arithmetic on literals stays a
+// single decimal however long the expression.
+ExactReal operator+(const ExactReal& a, const ExactReal& b) {
+    const Decimal *x = constant(a.node_), *y = constant(b.node_);
+    if (x && y) {
+        long e = std::min(x->e, y->e);
+        return ExactReal(x->m.scaleDecimal(x->e - e) + y->m.scaleDecimal(y->e - e), e);
+    }
+    return ExactReal(std::make_shared<Add>(a.node_, b.node_));
+}
+
+ExactReal operator-(const ExactReal& a, const ExactReal& b) {
+    return a + -b;
+}
+
+ExactReal operator*(const ExactReal& a, const ExactReal& b) {
+    const Decimal *x = constant(a.node_), *y = constant(b.node_);
+    if (x && y && x->m.digits() + y->m.digits() <= maxBigDigits) return ExactReal(x->m * y->m, x->e + y->e);
+    return ExactReal(std::make_shared<Multiply>(a.node_, b.node_));
+}
+
+ExactReal operator/(const ExactReal& a, const ExactReal& b) {
+    return a * ExactReal(std::make_shared<Inverse>(b.node_));
+}
+
+ExactReal ExactReal::operator-() const {
+    if (const Decimal* c = constant(node_)) return ExactReal(-c->m, c->e);
+    return ExactReal(std::make_shared<Negate>(node_));
+}
+
+ExactReal exactPow(const ExactReal& a, long n) {
+    if (n < 0) return ExactReal(BigInt(1)) / exactPow(a, -n);
+    ExactReal r(BigInt(1)), x = a;
+    for (;;) {
+        if (n & 1) r = r * x;
+        n >>= 1;
+        if (!n) return r;
+        x = x * x;
+    }
+}
+
+ExactReal exactSqrt(const ExactReal& a) {
+    return ExactReal(std::make_shared<Sqrt>(a.node_));
+}
+
+ExactReal exactExp(const ExactReal& a) {
+    return ExactReal(std::make_shared<Exp>(a.node_));
+}
+
+ExactReal exactLog(const ExactReal& a) {
+    return ExactReal(std::make_shared<Log>(a.node_));
+}
+
+ExactReal exactAbs(const ExactReal& a) {
+    return ExactReal(std::make_shared<Abs>(a.node_));
+}
+
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+// Exact reals. A number is kept as the expression that defines it, a DAG of
+// operations on exact decimals, and digits are produced only when asked
+// for, to as many as are asked for. Each node remembers the finest
+// approximation it has made, so asking for more digits refines rather than
+// restarts, and asking for fewer costs a rounding.
+
+#include <memory>
+#include <string>
+#include <atomic>
+
+#include "bigint.h"
+
+namespace wumbo {
+
+class ExactReal {
+public:
+    struct Node;
+
+    // m 10^e.
+    explicit ExactReal(BigInt m = BigInt(), long e = 0);
+    // The shortest decimal that reads back as x, which is what was typed for
+    // any literal, so 0.1 is exactly 1/10; x must be finite.
+    static ExactReal fromDouble(double x);
+
+    // Only a constant zero is known to be one; whether a computed value is
+    // zero cannot be decided from finitely many digits.
+    bool isZero() const;
+    // Sets n to a constant that is a whole number below 2^63 in magnitude.
+    bool wholeConstant(long& n) const;
+
+    // An integer m with |m - x 10^-p| < 1. False if that needed the inverse,
+    // logarithm or root of a number that is negative where it must not be,
+    // or indistinguishable from zero to zeroDigits places.
+    bool approx(long p, BigInt& m) const;
+    // digits significant digits, %g style; the last may be one off, since
+    // rounding it correctly can need unboundedly many more. False as above,
+    // or once stop is seen set, which is checked between approximations and
+    // series terms, so another thread can abandon a long computation.
+    bool format(int digits, std::string& out, const std::atomic<bool>* stop = nullptr) const;
+    // NaN when approx() would fail.
+    double toDouble() const;
+
+    friend ExactReal operator+(const ExactReal& a, const ExactReal& b);
+    friend ExactReal operator-(const ExactReal& a, const ExactReal& b);
+    friend ExactReal operator*(const ExactReal& a, const ExactReal& b);
+    friend ExactReal operator/(const ExactReal& a, const ExactReal& b);
+    ExactReal operator-() const;
+
+    friend ExactReal exactPow(const ExactReal& a, long n);
+    friend ExactReal exactSqrt(const ExactReal& a);
+    friend ExactReal exactExp(const ExactReal& a);
+    friend ExactReal exactLog(const ExactReal& a);
+    friend ExactReal exactAbs(const ExactReal& a);
+
+    // Numbers below 10^-zeroDigits in magnitude cannot be told from zero.
+    static constexpr long zeroDigits = 2000;
+
+private:
+    explicit ExactReal(std::shared_ptr<Node> node) : node_(std::move(node)) {}
+
+    std::shared_ptr<Node> node_;
+};
+
+// a^n by repeated squaring, with 1/a for negative n.
+ExactReal exactPow(const ExactReal& a, long n);
+ExactReal exactSqrt(const ExactReal& a);
+ExactReal exactExp(const ExactReal& a);
+// Natural logarithm; fails to approximate unless a > 0.
+ExactReal exactLog(const ExactReal& a);
+ExactReal exactAbs(const ExactReal& a);
+
+}
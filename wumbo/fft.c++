@@ -0,0 +1,345 @@
+#include "fft.h"
+#include "parallel.h"
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+namespace wumbo {
+
+namespace {
+
+// Transforms of at least this many points are split across threads.
+constexpr size_t parallelMin = 1 << 15;
+// Convolutions with an operand this short are done directly.
+constexpr size_t directMax = 32;
+
+// One level of the recursion: a transform of n points split into radix
+// interleaved sub-transforms of m = n / radix points. twr/twi hold the
+// twiddles W_n^(qk) for q = 1..radix-1 and k < m, q-major, so the combine loops
+// read them contiguously; rootr/rooti hold W_radix^j for the generic butterfly.
+struct Stage {
+    size_t n, radix, m;
+    std::vector<double> twr, twi, rootr, rooti;
+};
+
+struct Plan {
+    std::vector<Stage> stages;
+};
+
+// Splits n into the radices of a mixed-radix plan, fours first. Returns false
+// if n has a prime factor above 13.
+bool factorize(size_t n, std::vector<size_t>& radices) {
+    while (n % 4 == 0) { radices.push_back(4); n /= 4; }
+    for (size_t p : {2, 3, 5, 7, 11, 13})
+        while (n % p == 0) { radices.push_back(p); n /= p; }
+    return n == 1;
+}
+
+// W_n^j = e^(-2 pi i j/n) as the product of a coarse and a fine root, so the
+// whole plan takes about 2 sqrt(n) sin/cos evaluations, each exact to a
+// rounding, rather than n of them.
+class Roots {
+public:
+    explicit Roots(size_t n) : n(n), block((size_t)std::ceil(std::sqrt((double)n))) {
+        fine.resize(block);
+        coarse.resize(n / block + 1);
+        for (size_t j = 0; j < fine.size(); ++j) fine[j] = angle(j);
+        for (size_t j = 0; j < coarse.size(); ++j) coarse[j] = angle(j * block);
+    }
+
+    void get(size_t j, double& re, double& im) const {
+        auto [cr, ci] = coarse[j / block];
+        auto [fr, fi] = fine[j % block];
+        re = cr * fr - ci * fi;
+        im = cr * fi + ci * fr;
+    }
+
+private:
+    std::pair<double, double> angle(size_t j) const {
+        double a = -2 * M_PI * (double)(j % n) / (double)n;
+        return {std::cos(a), std::sin(a)};
+    }
+
+    size_t n, block;
+    std::vector<std::pair<double, double>> fine, coarse;
+};
+
+Plan makePlan(size_t n, const std::vector<size_t>& radices) {
+    Roots roots(n);
+    Plan plan;
+    size_t len = n;
+    for (size_t r : radices) {
+        Stage st{len, r, len / r, {}, {}, {}, {}};
+        size_t scale = n / len;
+        st.twr.resize((r - 1) * st.m);
+        st.twi.resize((r - 1) * st.m);
+        for (size_t q = 1; q < r; ++q)
+            for (size_t k = 0; k < st.m; ++k)
+                roots.get(q * k * scale, st.twr[(q - 1) * st.m + k], st.twi[(q - 1) * st.m + k]);
+        st.rootr.resize(r);
+        st.rooti.resize(r);
+        for (size_t j = 0; j < r; ++j) roots.get(j * (n / r), st.rootr[j], st.rooti[j]);
+        plan.stages.push_back(std::move(st));
+        len /= r;
+    }
+    return plan;
+}
+
+// Combines the radix sub-transforms in x, each m points long, into y for k
+// in [begin, end). Radix 2 and 4 are straight-line loops over k on split
+// arrays, which the compiler vectorizes; other radices gather each k's inputs
+// and run a small direct DFT.
+void combine(const Stage& st, const double* __restrict xr, const double* __restrict xi,
+             double* __restrict yr, double* __restrict yi, size_t begin, size_t end) {
+    size_t m = st.m;
+    const double* __restrict wr = st.twr.data();
+    const double* __restrict wi = st.twi.data();
+    if (st.radix == 2) {
+        for (size_t k = begin; k < end; ++k) {
+            double tr = xr[m + k] * wr[k] - xi[m + k] * wi[k];
+            double ti = xr[m + k] * wi[k] + xi[m + k] * wr[k];
+            yr[k] = xr[k] + tr;
+            yi[k] = xi[k] + ti;
+            yr[m + k] = xr[k] - tr;
+            yi[m + k] = xi[k] - ti;
+        }
+        return;
+    }
+    if (st.radix == 4) {
+        for (size_t k = begin; k < end; ++k) {
+            double r1 = xr[m + k], i1 = xi[m + k], r2 = xr[2 * m + k], i2 = xi[2 * m + k];
+            double r3 = xr[3 * m + k], i3 = xi[3 * m + k];
+            double w1r = wr[k], w1i = wi[k], w2r = wr[m + k], w2i = wi[m + k];
+            double w3r = wr[2 * m + k], w3i = wi[2 * m + k];
+            double a1r = r1 * w1r - i1 * w1i, a1i = r1 * w1i + i1 * w1r;
+            double a2r = r2 * w2r - i2 * w2i, a2i = r2 * w2i + i2 * w2r;
+            double a3r = r3 * w3r - i3 * w3i, a3i = r3 * w3i + i3 * w3r;
+            double t0r = xr[k] + a2r, t0i = xi[k] + a2i;
+            double t1r = xr[k] - a2r, t1i = xi[k] - a2i;
+            double t2r = a1r + a3r, t2i = a1i + a3i;
+            double t3r = a1r - a3r, t3i = a1i - a3i;
+            // W_4 = -i, and -i(x + iy) = y - ix.
+            yr[k] = t0r + t2r;
+            yi[k] = t0i + t2i;
+            yr[2 * m + k] = t0r - t2r;
+            yi[2 * m + k] = t0i - t2i;
+            yr[m + k] = t1r + t3i;
+            yi[m + k] = t1i - t3r;
+            yr[3 * m + k] = t1r - t3i;
+            yi[3 * m + k] = t1i + t3r;
+        }
+        return;
+    }
+    size_t r = st.radix;
+    double tr[13], ti[13];
+    for (size_t k = begin; k < end; ++k) {
+        tr[0] = xr[k];
+        ti[0] = xi[k];
+        for (size_t q = 1; q < r; ++q) {
+            double ar = xr[q * m + k], ai = xi[q * m + k];
+            double cr = wr[(q - 1) * m + k], ci = wi[(q - 1) * m + k];
+            tr[q] = ar * cr - ai * ci;
+            ti[q] = ar * ci + ai * cr;
+        }
+        for (size_t s = 0; s < r; ++s) {
+            double sr = 0, si = 0;
+            for (size_t q = 0, j = 0; q < r; ++q, j = (j + s) % r) {
+                sr += tr[q] * st.rootr[j] - ti[q] * st.rooti[j];
+                si += tr[q] * st.rooti[j] + ti[q] * st.rootr[j];
+            }
+            yr[s * m + k] = sr;
+            yi[s * m + k] = si;
+        }
+    }
+}
+
+// Decimation in time: transforms the n points in x into y, using x as
+// scratch. Each level first deinterleaves x into radix contiguous runs in y,
+// transforms the runs back into x and combines them into y, so every pass
+// streams through memory; and since the recursion is depth-first, once a run
+// fits in a cache level it is finished there before the next one starts.
+void transform(const Plan& plan, size_t level, double* xr, double* xi, double* yr, double* yi, unsigned threads) {
+    const Stage& st = plan.stages[level];
+    size_t r = st.radix, m = st.m;
+    if (m == 1) {
+        combine(st, xr, xi, yr, yi, 0, 1);
+        return;
+    }
+    bool parallel = threads > 1 && st.n >= parallelMin;
+    for (size_t q = 0; q < r; ++q)
+        for (size_t j = 0; j < m; ++j) {
+            yr[q * m + j] = xr[j * r + q];
+            yi[q * m + j] = xi[j * r + q];
+        }
+    unsigned inner = parallel ? std::max(1u, threads / (unsigned)r) : 1;
+    parallelFor(r, parallel ? std::min<unsigned>(threads, r) : 1, [&](size_t begin, size_t end) {
+        for (size_t q = begin; q < end; ++q)
+            transform(plan, level + 1, yr + q * m, yi + q * m, xr + q * m, xi + q * m, inner);
+    });
+    parallelFor(m, parallel ? threads : 1, [&](size_t begin, size_t end) { combine(st, xr, xi, yr, yi, begin, end); });
+}
+
+void bluestein(double* re, double* im, size_t n);
+
+void forward(double* re, double* im, size_t n) {
+    if (n <= 1) return;
+    std::vector<size_t> radices;
+    if (!factorize(n, radices)) {
+        bluestein(re, im, n);
+        return;
+    }
+    Plan plan = makePlan(n, radices);
+    std::vector<double> xr(re, re + n), xi(im, im + n);
+    transform(plan, 0, xr.data(), xi.data(), re, im, n >= parallelMin ? hardwareThreads() : 1);
+}
+
+size_t powerOfTwo(size_t minimum) {
+    size_t n = 1;
+    while (n < minimum) n <<= 1;
+    return n;
+}
+
+// X_k = w_k sum_j (x_j w_j) conj(w_(k-j)) with the chirp w_j = e^(-pi i j^2/n):
+// a convolution, done with power-of-two transforms.
+void bluestein(double* re, double* im, size_t n) {
+    size_t len = powerOfTwo(2 * n - 1);
+    std::vector<double> wr(n), wi(n);
+    for (size_t j = 0; j < n; ++j) {
+        // j^2 mod 2n keeps the angle small enough to stay accurate.
+        double a = -M_PI * (double)((unsigned __int128)j * j % (2 * n)) / (double)n;
+        wr[j] = std::cos(a);
+        wi[j] = std::sin(a);
+    }
+    std::vector<double> ar(len), ai(len), br(len), bi(len);
+    for (size_t j = 0; j < n; ++j) {
+        ar[j] = re[j] * wr[j] - im[j] * wi[j];
+        ai[j] = re[j] * wi[j] + im[j] * wr[j];
+        br[j] = wr[j];
+        bi[j] = -wi[j];
+        if (j) {
+            br[len - j] = wr[j];
+            bi[len - j] = -wi[j];
+        }
+    }
+    forward(ar.data(), ai.data(), len);
+    forward(br.data(), bi.data(), len);
+    for (size_t k = 0; k < len; ++k) {
+        double pr = ar[k] * br[k] - ai[k] * bi[k];
+        double pi = ar[k] * bi[k] + ai[k] * br[k];
+        ar[k] = pr;
+        ai[k] = pi;
+    }
+    ifft(ar.data(), ai.data(), len);
+    for (size_t k = 0; k < n; ++k) {
+        re[k] = ar[k] * wr[k] - ai[k] * wi[k];
+        im[k] = ar[k] * wi[k] + ai[k] * wr[k];
+    }
+}
+
+bool allIntegers(const double* x, size_t n, double& maxAbs) {
+    maxAbs = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (x[i] != std::floor(x[i])) return false;
+        maxAbs = std::max(maxAbs, std::fabs(x[i]));
+    }
+    return true;
+}
+
+}
+
+void fft(double* re, double* im, size_t n) {
+    forward(re, im, n);
+}
+
+void ifft(double* re, double* im, size_t n) {
+    if (n == 0) return;
+    for (size_t i = 0; i < n; ++i) im[i] = -im[i];
+    forward(re, im, n);
+    double scale = 1.0 / n;
+    for (size_t i = 0; i < n; ++i) {
+        re[i] *= scale;
+        im[i] *= -scale;
+    }
+}
+
+size_t smoothSize(size_t minimum) {
+    size_t best = powerOfTwo(minimum);
+    for (size_t p5 = 1; p5 < best; p5 *= 5)
+        for (size_t p35 = p5; p35 < best; p35 *= 3) {
+            size_t n = p35;
+            while (n < minimum) n <<= 1;
+            best = std::min(best, n);
+        }
+    return best;
+}
+
+void convolve(const double* ar, const double* ai, size_t na, const double* br, const double* bi, size_t nb,
+              double* outRe, double* outIm) {
+    if (na == 0 || nb == 0) return;
+    size_t len = na + nb - 1;
+    if (std::min(na, nb) <= directMax) {
+        std::fill(outRe, outRe + len, 0.0);
+        std::fill(outIm, outIm + len, 0.0);
+        for (size_t i = 0; i < na; ++i)
+            for (size_t j = 0; j < nb; ++j) {
+                outRe[i + j] += ar[i] * br[j] - ai[i] * bi[j];
+                outIm[i + j] += ar[i] * bi[j] + ai[i] * br[j];
+            }
+        return;
+    }
+    size_t n = smoothSize(len);
+    std::vector<double> xr(n), xi(n), yr(n), yi(n);
+    std::copy(ar, ar + na, xr.begin());
+    std::copy(ai, ai + na, xi.begin());
+    std::copy(br, br + nb, yr.begin());
+    std::copy(bi, bi + nb, yi.begin());
+    forward(xr.data(), xi.data(), n);
+    forward(yr.data(), yi.data(), n);
+    for (size_t k = 0; k < n; ++k) {
+        double pr = xr[k] * yr[k] - xi[k] * yi[k];
+        double pi = xr[k] * yi[k] + xi[k] * yr[k];
+        xr[k] = pr;
+        xi[k] = pi;
+    }
+    ifft(xr.data(), xi.data(), n);
+    std::copy(xr.begin(), xr.begin() + len, outRe);
+    std::copy(xi.begin(), xi.begin() + len, outIm);
+}
+
+void convolveReal(const double* a, size_t na, const double* b, size_t nb, double* out) {
+    if (na == 0 || nb == 0) return;
+    size_t len = na + nb - 1;
+    if (std::min(na, nb) <= directMax) {
+        std::fill(out, out + len, 0.0);
+        for (size_t i = 0; i < na; ++i)
+            for (size_t j = 0; j < nb; ++j) out[i + j] += a[i] * b[j];
+        return;
+    }
+    // With z = a + ib, A_k = (Z_k + conj Z_-k)/2 and B_k = (Z_k - conj Z_-k)/2i,
+    // so A_k B_k = (Z_k^2 - (conj Z_-k)^2)/4i: one transform instead of two.
+    size_t n = smoothSize(len);
+    std::vector<double> zr(n), zi(n);
+    std::copy(a, a + na, zr.begin());
+    std::copy(b, b + nb, zi.begin());
+    forward(zr.data(), zi.data(), n);
+    std::vector<double> cr(n), ci(n);
+    for (size_t k = 0; k < n; ++k) {
+        size_t nk = k ? n - k : 0;
+        double pr = zr[k], pi = zi[k], qr = zr[nk], qi = -zi[nk];
+        double sr = pr + qr, si = pi + qi, dr = pr - qr, di = pi - qi;
+        double xr = sr * dr - si * di, xi = sr * di + si * dr;
+        // Dividing by 4i: (x + iy) / 4i = (y - ix) / 4.
+        cr[k] = xi / 4;
+        ci[k] = -xr / 4;
+    }
+    ifft(cr.data(), ci.data(), n);
+    std::copy(cr.begin(), cr.begin() + len, out);
+    // Integer inputs have an integer convolution; below 2^40 the transform's
+    // error stays far under 1/2, so rounding recovers it exactly.
+    double maxA, maxB;
+    if (allIntegers(a, na, maxA) && allIntegers(b, nb, maxB) && maxA * maxB * (double)std::min(na, nb) < 0x1p40)
+        for (size_t i = 0; i < len; ++i) out[i] = std::nearbyint(out[i]);
+}
+
+}
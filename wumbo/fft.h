@@ -0,0 +1,29 @@
+#pragma once
+
+// Discrete Fourier transforms and convolution on split real/imaginary arrays.
+// Lengths whose prime factors are all at most 13 run a recursive mixed-radix
+// transform: depth-first, so each sub-transform works in cache once it is small
+// enough, whatever the cache size. Other lengths go through Bluestein's
+// algorithm on a power-of-two length. Large transforms are split across threads.
+
+#include <cstddef>
+
+namespace wumbo {
+
+// In place, X[k] = sum_j x[j] e^(-2 pi i jk/n).
+void fft(double* re, double* im, size_t n);
+// In place, including the 1/n scaling, so ifft(fft(x)) == x.
+void ifft(double* re, double* im, size_t n);
+
+// Linear convolution: out gets na + nb - 1 points. Short operands are
+// convolved directly, long ones through transforms. convolveReal packs both
+// real inputs into one complex transform, and rounds the result when both
+// inputs are integers small enough for it to be exact.
+void convolve(const double* ar, const double* ai, size_t na, const double* br, const double* bi, size_t nb,
+              double* outRe, double* outIm);
+void convolveReal(const double* a, size_t na, const double* b, size_t nb, double* out);
+
+// The smallest n >= minimum whose prime factors are all 2, 3 or 5.
+size_t smoothSize(size_t minimum);
+
+}
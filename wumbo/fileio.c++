@@ -0,0 +1,401 @@
+#include "fileio.h"
+
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define WUMBO_IO_URING 1
+#endif
+
+namespace wumbo {
+
+namespace {
+
+// The tag of cancellation requests, which no reader slot or writer id has.
+constexpr uint64_t cancelTag = ~(uint64_t)0;
+
+bool regularFile(int fd) {
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+}
+
+#ifdef WUMBO_IO_URING
+
+// A ring driven from one thread through the system calls themselves, so no
+// library is needed. Requests queue up in the submission ring until
+// submit() hands them to the kernel, and completions are read straight off
+// the completion ring.
+struct Ring {
+    int fd = -1;
+    unsigned entries = 0, tail = 0;
+    unsigned *sqHead = nullptr, *sqTail = nullptr, *sqMask = nullptr, *sqArray = nullptr;
+    unsigned *cqHead = nullptr, *cqTail = nullptr, *cqMask = nullptr;
+    io_uring_sqe* sqes = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    void* sqMap = MAP_FAILED;
+    void* cqMap = MAP_FAILED;
+    size_t sqBytes = 0, cqBytes = 0;
+
+    ~Ring() {
+        if (sqes) munmap(sqes, entries * sizeof(io_uring_sqe));
+        if (cqMap != MAP_FAILED && cqMap != sqMap) munmap(cqMap, cqBytes);
+        if (sqMap != MAP_FAILED) munmap(sqMap, sqBytes);
+        if (fd >= 0) close(fd);
+    }
+
+    // Null unless the kernel offers a ring with plain reads and writes at
+    // the current position (5.6 on).
+    static std::unique_ptr<Ring> open(unsigned n) {
+        auto ring = std::make_unique<Ring>();
+        io_uring_params p;
+        memset(&p, 0, sizeof p);
+        ring->fd = (int)syscall(__NR_io_uring_setup, n, &p);
+        if (ring->fd < 0 || !(p.features & IORING_FEAT_RW_CUR_POS) || !ring->map(p)) return nullptr;
+        return ring;
+    }
+
+    bool map(const io_uring_params& p) {
+        entries = p.sq_entries;
+        sqBytes = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqBytes = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) sqBytes = cqBytes = std::max(sqBytes, cqBytes);
+        int prot = PROT_READ | PROT_WRITE, flags = MAP_SHARED | MAP_POPULATE;
+        sqMap = mmap(nullptr, sqBytes, prot, flags, fd, IORING_OFF_SQ_RING);
+        if (sqMap == MAP_FAILED) return false;
+        cqMap = single ? sqMap : mmap(nullptr, cqBytes, prot, flags, fd, IORING_OFF_CQ_RING);
+        if (cqMap == MAP_FAILED) return false;
+        void* s = mmap(nullptr, entries * sizeof(io_uring_sqe), prot, flags, fd, IORING_OFF_SQES);
+        if (s == MAP_FAILED) return false;
+        sqes = (io_uring_sqe*)s;
+        char* sq = (char*)sqMap;
+        char* cq = (char*)cqMap;
+        sqHead = (unsigned*)(sq + p.sq_off.head);
+        sqTail = (unsigned*)(sq + p.sq_off.tail);
+        sqMask = (unsigned*)(sq + p.sq_off.ring_mask);
+        sqArray = (unsigned*)(sq + p.sq_off.array);
+        cqHead = (unsigned*)(cq + p.cq_off.head);
+        cqTail = (unsigned*)(cq + p.cq_off.tail);
+        cqMask = (unsigned*)(cq + p.cq_off.ring_mask);
+        cqes = (io_uring_cqe*)(cq + p.cq_off.cqes);
+        tail = *sqTail;
+        return true;
+    }
+
+    bool registerBuffers(const iovec* v, unsigned n) {
+        return syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, v, n) == 0;
+    }
+
+    // A cleared entry to fill in, or null if the submission ring is full
+    // even after handing what it holds to the kernel.
+    io_uring_sqe* get() {
+        if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= entries &&
+            (!submit(0) || tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= entries))
+            return nullptr;
+        unsigned i = tail++ & *sqMask;
+        sqArray[i] = i;
+        memset(&sqes[i], 0, sizeof(io_uring_sqe));
+        return &sqes[i];
+    }
+
+    // bufIndex is that of a registered buffer holding buf, or -1.
+    bool read(int file, char* buf, size_t len, int64_t offset, int bufIndex, uint64_t tag) {
+        io_uring_sqe* s = get();
+        if (!s) return false;
+        s->opcode = bufIndex >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        s->fd = file;
+        s->addr = (uint64_t)(uintptr_t)buf;
+        s->len = (unsigned)len;
+        s->off = (uint64_t)offset;
+        s->buf_index = (uint16_t)std::max(bufIndex, 0);
+        s->user_data = tag;
+        return true;
+    }
+
+    bool write(int file, const char* buf, size_t len, int64_t offset, uint64_t tag) {
+        io_uring_sqe* s = get();
+        if (!s) return false;
+        s->opcode = IORING_OP_WRITE;
+        s->fd = file;
+        s->addr = (uint64_t)(uintptr_t)buf;
+        s->len = (unsigned)len;
+        s->off = (uint64_t)offset;
+        s->user_data = tag;
+        return true;
+    }
+
+    bool cancel(uint64_t tag) {
+        io_uring_sqe* s = get();
+        if (!s) return false;
+        s->opcode = IORING_OP_ASYNC_CANCEL;
+        s->addr = tag;
+        s->user_data = cancelTag;
+        return true;
+    }
+
+    // Hands the queued requests to the kernel, then waits for at least wait
+    // completions.
+    bool submit(unsigned wait) {
+        __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+        for (;;) {
+            unsigned count = tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+            if (!count && !wait) return true;
+            if (syscall(__NR_io_uring_enter, fd, count, wait, wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0) >= 0)
+                return true;
+            if (errno != EINTR) return false;
+        }
+    }
+
+    // 1 with the next completion's tag and result, 0 if there is none yet
+    // and wait is false, -1 if the ring failed.
+    int next(uint64_t& tag, int& result, bool wait) {
+        for (;;) {
+            unsigned head = *cqHead;
+            if (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                const io_uring_cqe& c = cqes[head & *cqMask];
+                tag = c.user_data;
+                result = c.res;
+                __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+                return 1;
+            }
+            if (!wait) return 0;
+            if (!submit(1)) return -1;
+        }
+    }
+};
+
+#else
+
+struct Ring {
+    static std::unique_ptr<Ring> open(unsigned) { return nullptr; }
+    bool registerBuffers(const iovec*, unsigned) { return false; }
+    bool read(int, char*, size_t, int64_t, int, uint64_t) { return false; }
+    bool write(int, const char*, size_t, int64_t, uint64_t) { return false; }
+    bool cancel(uint64_t) { return false; }
+    bool submit(unsigned) { return false; }
+    int next(uint64_t&, int&, bool) { return -1; }
+};
+
+#endif
+
+BlockReader::BlockReader(int fd, size_t blockBytes, unsigned depth)
+    : fd(fd), blockBytes(blockBytes), slots(std::max(depth, 1u)) {
+    seekable = regularFile(fd) && (start = lseek(fd, 0, SEEK_CUR)) >= 0;
+    ring = Ring::open(2 * (unsigned)slots.size());
+    buffers.reset(new char[blockBytes * (ring ? slots.size() : 1)]);
+    if (!ring) return;
+    std::vector<iovec> v(slots.size());
+    for (size_t i = 0; i < v.size(); ++i) v[i] = {buffers.get() + i * blockBytes, blockBytes};
+    registered = ring->registerBuffers(v.data(), (unsigned)v.size());
+}
+
+BlockReader::~BlockReader() {
+    if (!ring || !inFlight) return;
+    for (size_t i = 0; i < slots.size(); ++i)
+        if (slots[i].busy) ring->cancel(i);
+    uint64_t tag;
+    int result;
+    while (inFlight) {
+        if (ring->next(tag, result, true) < 0) {
+            // The kernel cancels what a ring still holds when it is closed,
+            // which must come before the buffers it reads into are freed.
+            ring.reset();
+            return;
+        }
+        if (tag < slots.size() && slots[tag].busy) {
+            slots[tag].busy = false;
+            inFlight--;
+        }
+    }
+}
+
+// Every slot but the held ones gets the next block of a regular file; a
+// stream gets one read at a time, since reads queued together could
+// complete out of order.
+bool BlockReader::fill(size_t held) {
+    while (!ended && tail - head + held < slots.size() && (seekable || inFlight == 0)) {
+        Slot& s = slots[tail % slots.size()];
+        s.filled = 0;
+        s.end = false;
+        if (!issue(tail)) return false;
+        tail++;
+    }
+    return ring->submit(0);
+}
+
+bool BlockReader::issue(size_t block) {
+    size_t i = block % slots.size();
+    Slot& s = slots[i];
+    s.block = block;
+    s.busy = true;
+    int64_t offset = seekable ? start + (int64_t)(block * blockBytes + s.filled) : -1;
+    if (!ring->read(fd, buffers.get() + i * blockBytes + s.filled, blockBytes - s.filled, offset,
+                    registered ? (int)i : -1, i))
+        return false;
+    inFlight++;
+    return true;
+}
+
+// Waits for block, reissuing the rest of a regular file's block after a
+// short read; a read of nothing marks the end.
+bool BlockReader::complete(size_t block) {
+    Slot& want = slots[block % slots.size()];
+    uint64_t tag;
+    int result;
+    while (want.busy) {
+        if (ring->next(tag, result, true) < 0) return false;
+        if (tag >= slots.size()) continue;
+        Slot& s = slots[tag];
+        inFlight--;
+        if (result == -EINTR || result == -EAGAIN) {
+            if (!issue(s.block)) return false;
+            continue;
+        }
+        if (result < 0) {
+            errno = -result;
+            return false;
+        }
+        s.filled += result;
+        if (result == 0) s.end = true;
+        else if (seekable && s.filled < blockBytes) {
+            if (!issue(s.block)) return false;
+            continue;
+        }
+        s.busy = false;
+    }
+    return true;
+}
+
+bool BlockReader::next(std::string_view& block) {
+    block = {};
+    if (failed) return false;
+    if (!ring) {
+        for (;;) {
+            ssize_t got = read(fd, buffers.get(), blockBytes);
+            if (got >= 0) {
+                block = {buffers.get(), (size_t)got};
+                return true;
+            }
+            if (errno != EINTR) return !(failed = true);
+        }
+    }
+    if (!fill(0)) return !(failed = true);
+    if (head == tail) return true;
+    if (!complete(head)) return !(failed = true);
+    const Slot& s = slots[head % slots.size()];
+    ended |= s.end;
+    if (s.end && !s.filled) {
+        head = tail;
+        return true;
+    }
+    block = {buffers.get() + (head % slots.size()) * blockBytes, s.filled};
+    head++;
+    if (!fill(1)) return !(failed = true);
+    return true;
+}
+
+BlockWriter::BlockWriter(int fd, unsigned depth) : fd(fd), depth(std::max(depth, 1u)) {
+    // Writes to a file opened for appending go to its end whatever their
+    // offset, so they too must go one at a time.
+    seekable = regularFile(fd) && !(fcntl(fd, F_GETFL) & O_APPEND) && (offset = lseek(fd, 0, SEEK_CUR)) >= 0;
+    ring = Ring::open(2 * this->depth);
+}
+
+BlockWriter::~BlockWriter() {
+    flush();
+}
+
+bool BlockWriter::submit(uint64_t id) {
+    Pending& p = inFlight[id];
+    if (ring->write(fd, p.data.data() + p.done, p.data.size() - p.done, seekable ? p.offset + (int64_t)p.done : -1, id))
+        return true;
+    failed = true;
+    inFlight.erase(id);
+    return false;
+}
+
+// Takes one completion, resubmitting what a short write left; false only if
+// the ring itself failed.
+bool BlockWriter::reap(bool wait) {
+    uint64_t tag;
+    int result;
+    int got = ring->next(tag, result, wait);
+    if (got <= 0) return got == 0;
+    auto it = inFlight.find(tag);
+    if (it == inFlight.end()) return true;
+    if (result == -EINTR || result == -EAGAIN) {
+        submit(tag);
+        return true;
+    }
+    if (result <= 0) {
+        failed = true;
+        inFlight.erase(it);
+        return true;
+    }
+    it->second.done += result;
+    if (it->second.done < it->second.data.size()) submit(tag);
+    else inFlight.erase(it);
+    return true;
+}
+
+bool BlockWriter::write(std::string data) {
+    if (failed) return false;
+    if (data.empty()) return true;
+    if (!ring) {
+        for (size_t done = 0; done < data.size();) {
+            ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return !(failed = true);
+            done += n;
+        }
+        return true;
+    }
+    while (inFlight.size() >= (seekable ? depth : 1u))
+        if (!reap(true)) return !(failed = true);
+    uint64_t id = nextId++;
+    Pending& p = inFlight[id];
+    p.data = std::move(data);
+    p.offset = offset;
+    if (seekable) offset += (int64_t)p.data.size();
+    if (!submit(id) || !ring->submit(0)) failed = true;
+    return !failed;
+}
+
+bool BlockWriter::flush() {
+    if (!ring) return !failed;
+    while (!inFlight.empty())
+        if (!reap(true)) abandon();
+    // Positioned writes leave the file offset where it was.
+    if (seekable) lseek(fd, offset, SEEK_SET);
+    return !failed;
+}
+
+// Cancels the writes in flight and waits for them, so that their data can
+// be freed. If the ring cannot even do that, it is closed first, which
+// cancels them too.
+void BlockWriter::abandon() {
+    failed = true;
+    for (auto& p : inFlight) ring->cancel(p.first);
+    uint64_t tag;
+    int result;
+    while (!inFlight.empty()) {
+        if (ring->next(tag, result, true) < 0) {
+            ring.reset();
+            inFlight.clear();
+            return;
+        }
+        inFlight.erase(tag);
+    }
+}
+
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+// Reading and writing a file a block at a time with several requests in
+// flight, for batch input and output. On Linux the requests go through an
+// io_uring, the read buffers registered with it once, so the next blocks
+// are already on their way while the caller works on the last one; where
+// no ring can be had (an old kernel, a seccomp filter) plain read and write
+// are used. Regular files are read and written at explicit offsets, depth
+// requests at a time. Pipes and sockets deliver data in order only, so they
+// get one request in flight ahead of the caller.
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+namespace wumbo {
+
+struct Ring;
+
+// Reads fd, which stays the caller's to close, from its current position.
+class BlockReader {
+public:
+    explicit BlockReader(int fd, size_t blockBytes = 1 << 20, unsigned depth = 8);
+    ~BlockReader();
+    BlockReader(const BlockReader&) = delete;
+    BlockReader& operator=(const BlockReader&) = delete;
+
+    // The next block, valid until the following call; empty at the end of
+    // the input. False on a read error.
+    bool next(std::string_view& block);
+    bool async() const { return ring != nullptr; }
+
+private:
+    // Block b is read into slot b % depth.
+    struct Slot {
+        size_t block = 0, filled = 0;
+        bool busy = false, end = false;
+    };
+
+    bool fill(size_t held);
+    bool issue(size_t block);
+    bool complete(size_t block);
+
+    int fd;
+    size_t blockBytes;
+    bool seekable = false, registered = false, failed = false, ended = false;
+    int64_t start = 0;
+    std::unique_ptr<char[]> buffers;
+    std::vector<Slot> slots;
+    size_t head = 0, tail = 0, inFlight = 0;
+    std::unique_ptr<Ring> ring;
+};
+
+// Writes to fd, which stays the caller's to close, from its current position.
+class BlockWriter {
+public:
+    explicit BlockWriter(int fd, unsigned depth = 8);
+    // Waits for the writes still in flight.
+    ~BlockWriter();
+    BlockWriter(const BlockWriter&) = delete;
+    BlockWriter& operator=(const BlockWriter&) = delete;
+
+    // Queues data to be written after everything queued before it; false
+    // once any write has failed.
+    bool write(std::string data);
+    // Waits for every queued write; false if any failed.
+    bool flush();
+    bool async() const { return ring != nullptr; }
+
+private:
+    struct Pending {
+        std::string data;
+        size_t done = 0;
+        int64_t offset = 0;
+    };
+
+    bool submit(uint64_t id);
+    bool reap(bool wait);
+    void abandon();
+
+    int fd;
+    unsigned depth;
+    bool seekable = false, failed = false;
+    int64_t offset = 0;
+    uint64_t nextId = 0;
+    std::unordered_map<uint64_t, Pending> inFlight;
+    std::unique_ptr<Ring> ring;
+};
+
+}
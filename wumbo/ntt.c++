@@ -0,0 +1,105 @@
+#include "ntt.h"
+#include "numtheory.h"
+
+#include <mutex>
+#include <algorithm>
+
+namespace wumbo {
+
+namespace {
+
+// For p = c 2^k + 1 the prime factors of p - 1 are 2 and those of c.
+uint32_t primitiveRoot(uint32_t p, uint32_t c) {
+    std::vector<uint32_t> factors{2};
+    uint32_t m = c;
+    while (m % 2 == 0) m /= 2;
+    for (uint32_t f = 3; f * f <= m; f += 2)
+        if (m % f == 0) {
+            factors.push_back(f);
+            while (m % f == 0) m /= f;
+        }
+    if (m > 1) factors.push_back(m);
+    for (uint32_t g = 2;; ++g) {
+        bool generator = true;
+        for (uint32_t f : factors) generator &= powMod(g, (p - 1) / f, p) != 1;
+        if (generator) return g;
+    }
+}
+
+}
+
+uint32_t powMod(uint64_t b, uint64_t e, uint32_t p) {
+    uint64_t r = 1;
+    for (b %= p; e; e >>= 1, b = b * b % p)
+        if (e & 1) r = r * b % p;
+    return (uint32_t)r;
+}
+
+unsigned log2Ceil(size_t n) {
+    unsigned k = 0;
+    while (((size_t)1 << k) < n) k++;
+    return k;
+}
+
+// The search costs as much as a short transform, and every big-integer
+// product asks again, so the primes found for each k are kept.
+std::vector<NttPrime> nttPrimes(unsigned logLen, size_t want) {
+    static std::mutex mutex;
+    static std::vector<NttPrime> found[31];
+    unsigned k = std::max(logLen, 20u);
+    if (k >= 31) return {};
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<NttPrime>& primes = found[k];
+    uint32_t c = primes.empty() ? (uint32_t)((1u << 31) - 1) >> k : (primes.back().p >> k) - 1;
+    for (; c >= ((1u << 30) >> k) && primes.size() < want; --c) {
+        uint32_t p = (c << k) | 1;
+        if (isPrime(p)) primes.push_back({p, primitiveRoot(p, c)});
+    }
+    return std::vector<NttPrime>(primes.begin(), primes.begin() + std::min(want, primes.size()));
+}
+
+void ntt(Residues& a, const NttPrime& prime, bool inverse) {
+    uint32_t p = prime.p;
+    size_t n = a.size();
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) std::swap(a[i], a[j]);
+    }
+    std::vector<uint32_t> w;
+    for (size_t len = 2; len <= n; len <<= 1) {
+        uint64_t step = powMod(prime.root, (p - 1) / len, p);
+        if (inverse) step = powMod(step, p - 2, p);
+        size_t half = len / 2;
+        w.resize(half);
+        w[0] = 1;
+        for (size_t j = 1; j < half; ++j) w[j] = (uint32_t)(w[j - 1] * step % p);
+        for (size_t i = 0; i < n; i += len)
+            for (size_t j = 0; j < half; ++j) {
+                uint32_t u = a[i + j], v = (uint32_t)((uint64_t)a[i + j + half] * w[j] % p);
+                a[i + j] = u + v >= p ? u + v - p : u + v;
+                a[i + j + half] = u >= v ? u - v : u + p - v;
+            }
+    }
+    if (inverse) {
+        uint64_t scale = powMod(n, p - 2, p);
+        for (auto& x : a) x = (uint32_t)(x * scale % p);
+    }
+}
+
+Residues mulMod(const Residues& a, const Residues& b, size_t n, const NttPrime& prime) {
+    size_t len = 1;
+    while (len < a.size() + b.size() - 1) len <<= 1;
+    Residues x(len), y(len);
+    std::copy(a.begin(), a.end(), x.begin());
+    std::copy(b.begin(), b.end(), y.begin());
+    ntt(x, prime, false);
+    ntt(y, prime, false);
+    for (size_t j = 0; j < len; ++j) x[j] = (uint32_t)((uint64_t)x[j] * y[j] % prime.p);
+    ntt(x, prime, true);
+    x.resize(n);
+    return x;
+}
+
+}
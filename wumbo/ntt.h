@@ -0,0 +1,34 @@
+#pragma once
+
+// Number-theoretic transforms modulo 31-bit primes, for exact convolution of
+// integer sequences. Polynomial and big-integer multiplication transform
+// modulo several primes and recombine the results by the Chinese remainder
+// theorem.
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace wumbo {
+
+struct NttPrime {
+    uint32_t p, root;
+};
+
+typedef std::vector<uint32_t> Residues;
+
+uint32_t powMod(uint64_t b, uint64_t e, uint32_t p);
+// The smallest k with 2^k >= n.
+unsigned log2Ceil(size_t n);
+
+// Up to want primes c 2^k + 1 between 2^30 and 2^31, largest first, with
+// 2^k at least 2^logLen; k = 20 has 91 of them, enough for any product of
+// doubles.
+std::vector<NttPrime> nttPrimes(unsigned logLen, size_t want);
+// In place on a power-of-two number of residues; the inverse includes the
+// 1/n scaling.
+void ntt(Residues& a, const NttPrime& prime, bool inverse);
+// a b modulo p, truncated to n terms.
+Residues mulMod(const Residues& a, const Residues& b, size_t n, const NttPrime& prime);
+
+}
@@ -0,0 +1,212 @@
+#include "numtheory.h"
+#include "parallel.h"
+
+#include <cmath>
+#include <numeric>
+#include <algorithm>
+
+namespace wumbo {
+
+namespace {
+
+// Odd numbers per sieve segment, one byte each.
+constexpr size_t segmentSize = 1 << 18;
+// Segments start from a copy of the pattern the primes 3 to 13 leave on the
+// odd numbers, which repeats every 3 * 5 * 7 * 11 * 13 of them, rather than
+// crossing those primes off one multiple at a time.
+constexpr uint32_t presievePrimes[] = {3, 5, 7, 11, 13};
+constexpr size_t presievePeriod = 3 * 5 * 7 * 11 * 13;
+// Pollard steps between gcds.
+constexpr uint64_t gcdBatch = 128;
+
+uint64_t mulMod(uint64_t a, uint64_t b, uint64_t n) {
+    return (uint64_t)((unsigned __int128)a * b % n);
+}
+
+uint64_t powMod(uint64_t b, uint64_t e, uint64_t n) {
+    uint64_t r = 1;
+    for (b %= n; e; e >>= 1, b = mulMod(b, b, n))
+        if (e & 1) r = mulMod(r, b, n);
+    return r;
+}
+
+uint64_t isqrt(uint64_t n) {
+    uint64_t r = (uint64_t)std::sqrt((double)n);
+    while (r * r > n) r--;
+    while ((r + 1) * (r + 1) <= n) r++;
+    return r;
+}
+
+const uint32_t smallPrimes[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97};
+
+// One odd base prime per entry, up to limit.
+std::vector<uint32_t> basePrimes(uint64_t limit) {
+    std::vector<char> composite(limit / 2 + 1);
+    std::vector<uint32_t> primes;
+    for (uint64_t i = 3; i <= limit; i += 2) {
+        if (composite[i / 2]) continue;
+        primes.push_back((uint32_t)i);
+        for (uint64_t j = i * i; j <= limit; j += 2 * i) composite[j / 2] = 1;
+    }
+    return primes;
+}
+
+uint64_t rho(uint64_t n) {
+    if (n % 2 == 0) return 2;
+    for (uint64_t c = 1;; ++c) {
+        auto f = [&](uint64_t v) {
+            uint64_t r = mulMod(v, v, n) + c;
+            return r >= n || r < c ? r - n : r;
+        };
+        uint64_t y = 2, x = y, ys = y, g = 1, q = 1;
+        for (uint64_t r = 1; g == 1; r *= 2) {
+            x = y;
+            for (uint64_t i = 0; i < r; ++i) y = f(y);
+            for (uint64_t k = 0; k < r && g == 1; k += gcdBatch) {
+                ys = y;
+                for (uint64_t i = 0; i < std::min(gcdBatch, r - k); ++i) {
+                    y = f(y);
+                    q = mulMod(q, x > y ? x - y : y - x, n);
+                }
+                g = std::gcd(q, n);
+            }
+        }
+        // The batch overshot into the cycle; redo its steps one gcd at a time.
+        if (g == n) {
+            do {
+                ys = f(ys);
+                g = std::gcd(x > ys ? x - ys : ys - x, n);
+            } while (g == 1);
+        }
+        if (g != n) return g;
+    }
+}
+
+void factorInto(uint64_t n, std::vector<uint64_t>& out) {
+    if (n == 1) return;
+    if (isPrime(n)) {
+        out.push_back(n);
+        return;
+    }
+    uint64_t d = rho(n);
+    factorInto(d, out);
+    factorInto(n / d, out);
+}
+
+}
+
+bool isPrime(uint64_t n) {
+    if (n < 2) return false;
+    for (uint32_t p : smallPrimes)
+        if (n % p == 0) return n == p;
+    if (n < 97 * 97) return true;
+    uint64_t d = n - 1;
+    int s = 0;
+    while (d % 2 == 0) { d /= 2; s++; }
+    for (uint64_t a : {2ull, 325ull, 9375ull, 28178ull, 450775ull, 9780504ull, 1795265022ull}) {
+        a %= n;
+        if (a == 0) continue;
+        uint64_t x = powMod(a, d, n);
+        if (x == 1 || x == n - 1) continue;
+        bool composite = true;
+        for (int i = 1; i < s && composite; ++i) {
+            x = mulMod(x, x, n);
+            composite = x != n - 1;
+        }
+        if (composite) return false;
+    }
+    return true;
+}
+
+uint64_t nextPrime(uint64_t n) {
+    if (n < 2) return 2;
+    for (uint64_t c = n % 2 ? n + 2 : n + 1; c > n; c += 2)
+        if (isPrime(c)) return c;
+    return 0;
+}
+
+std::vector<uint64_t> factorize(uint64_t n) {
+    std::vector<uint64_t> out;
+    if (n == 0) return out;
+    for (uint32_t p : smallPrimes)
+        while (n % p == 0) {
+            out.push_back(p);
+            n /= p;
+        }
+    factorInto(n, out);
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+std::vector<uint64_t> primesBetween(uint64_t lo, uint64_t hi) {
+    std::vector<uint64_t> out;
+    if (hi < 2 || lo > hi) return out;
+    if (lo <= 2) out.push_back(2);
+    uint64_t first = std::max<uint64_t>(lo, 3) | 1;
+    if (first > hi) return out;
+    uint64_t odds = (hi - first) / 2 + 1;
+    std::vector<uint32_t> base = basePrimes(isqrt(hi));
+    // Odd number v is entry (v - 1) / 2 of the pattern, modulo its period.
+    std::vector<char> pattern(presievePeriod);
+    for (size_t j = 0; j < presievePeriod; ++j)
+        for (uint32_t q : presievePrimes) pattern[j] |= (2 * j + 1) % q == 0;
+    size_t segments = (odds + segmentSize - 1) / segmentSize;
+    unsigned threads = (unsigned)std::min<size_t>(hardwareThreads(), segments);
+    // Each thread sieves one run of consecutive segments into its own list,
+    // so concatenating the lists keeps the primes in order.
+    std::vector<std::vector<uint64_t>> found(threads);
+    size_t perThread = (segments + threads - 1) / threads;
+    parallelFor(threads, threads, [&](size_t begin, size_t end) {
+        std::vector<char> composite(segmentSize);
+        for (size_t t = begin; t < end; ++t)
+            for (size_t s = t * perThread; s < std::min(segments, (t + 1) * perThread); ++s) {
+                // Odd number i of this segment is start + 2i.
+                uint64_t start = first + 2 * (uint64_t)s * segmentSize;
+                uint64_t count = std::min<uint64_t>(segmentSize, odds - (uint64_t)s * segmentSize);
+                uint64_t last = start + 2 * (count - 1);
+                for (uint64_t i = 0, o = (start - 1) / 2 % presievePeriod; i < count;) {
+                    uint64_t n = std::min<uint64_t>(count - i, presievePeriod - o);
+                    std::copy(pattern.begin() + o, pattern.begin() + o + n, composite.begin() + i);
+                    i += n;
+                    o = 0;
+                }
+                for (uint32_t q : presievePrimes)
+                    if (q >= start && q <= last) composite[(q - start) / 2] = 0;
+                for (uint64_t p : base) {
+                    if (p <= presievePrimes[4]) continue;
+                    if (p * p > last) break;
+                    uint64_t m = std::max(p * p, (start + p - 1) / p * p);
+                    if (m % 2 == 0) m += p;
+                    for (uint64_t i = (m - start) / 2; i < count; i += p) composite[i] = 1;
+                }
+                for (uint64_t i = 0; i < count; ++i)
+                    if (!composite[i]) found[t].push_back(start + 2 * i);
+            }
+    });
+    for (auto& f : found) out.insert(out.end(), f.begin(), f.end());
+    return out;
+}
+
+uint64_t primePi(uint64_t n) {
+    if (n < 2) return 0;
+    // After processing the primes below p, low[v] counts the numbers in
+    // [2, v] with no prime factor below p, and high[k] the same for n / k.
+    uint64_t r = isqrt(n);
+    std::vector<uint64_t> low(r + 1), high(r + 1);
+    for (uint64_t v = 1; v <= r; ++v) {
+        low[v] = v - 1;
+        high[v] = n / v - 1;
+    }
+    for (uint64_t p = 2; p <= r; ++p) {
+        if (low[p] == low[p - 1]) continue;
+        uint64_t below = low[p - 1], p2 = p * p;
+        for (uint64_t k = 1; k <= r && n / k >= p2; ++k) {
+            uint64_t kp = k * p;
+            high[k] -= (kp <= r ? high[kp] : low[n / kp]) - below;
+        }
+        for (uint64_t v = r; v >= p2; --v) low[v] -= low[v / p] - below;
+    }
+    return high[1];
+}
+
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// Primality, factorization and prime enumeration on 64-bit integers.
+
+#include <vector>
+#include <cstdint>
+
+namespace wumbo {
+
+// Deterministic Miller-Rabin: the seven bases used are known to have no
+// common strong pseudoprime below 2^64.
+bool isPrime(uint64_t n);
+// The smallest prime above n, or 0 if there is none below 2^64.
+uint64_t nextPrime(uint64_t n);
+// The prime factors of n >= 1 in ascending order, with multiplicity. Small
+// factors are found by trial division, the rest by Pollard's rho with
+// Brent's cycle detection, batching the gcds over runs of 128 steps.
+std::vector<uint64_t> factorize(uint64_t n);
+// The primes in [lo, hi] by a segmented sieve of Eratosthenes: odd numbers
+// only, in segments sized for L2, spread across threads.
+std::vector<uint64_t> primesBetween(uint64_t lo, uint64_t hi);
+// The number of primes <= n, by the Lucy-Hedgehog recurrence over the values
+// n / k in O(n^(3/4)) time and O(sqrt n) space.
+uint64_t primePi(uint64_t n);
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// Fork-join helpers for the numeric kernels that split large jobs across
+// threads. Every call starts and joins its own threads, so nothing outlives it.
+
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+namespace wumbo {
+
+inline unsigned hardwareThreads() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+// Runs f(begin, end) over [0, n) in up to threads pieces, the first on the
+// calling thread.
+template <typename F>
+void parallelFor(size_t n, unsigned threads, F f) {
+    if (threads <= 1 || n < 2) {
+        f(0, n);
+        return;
+    }
+    size_t step = (n + threads - 1) / threads;
+    std::vector<std::thread> pool;
+    for (size_t b = step; b < n; b += step) pool.emplace_back(f, b, std::min(n, b + step));
+    f(0, std::min(n, step));
+    for (auto& t : pool) t.join();
+}
+
+}
@@ -0,0 +1,50 @@
+#ifndef WUMBO_PLUGIN_H
+#define WUMBO_PLUGIN_H
+
+/* Interface for plugin libraries. A plugin is a shared library exporting
+ *
+ *     int wumbo_plugin_init(const wumbo_plugin_api* api);
+ *
+ * which registers its functions through api->register_function and returns 0
+ * on success. Each function has a scalar entry point taking arity doubles and
+ * returning a double, and optionally a batch entry point that evaluates n
+ * calls at once:
+ *
+ *     static double hypot2(double a, double b) { return a * a + b * b; }
+ *     static void hypot2_n(const double* a, const double* b, double* out, size_t n) {
+ *         for (size_t i = 0; i < n; ++i) out[i] = a[i] * a[i] + b[i] * b[i];
+ *     }
+ *     int wumbo_plugin_init(const wumbo_plugin_api* api) {
+ *         return api->register_function(api->context, "hypot2", 2,
+ *                                       (wumbo_fn)hypot2, (wumbo_fn)hypot2_n);
+ *     }
+ *
+ * Functions may be called from several threads at once. The batch entry
+ * point's output never aliases its inputs. */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WUMBO_PLUGIN_ABI_VERSION 1
+#define WUMBO_MAX_ARITY 4
+
+typedef void (*wumbo_fn)(void);
+
+typedef struct wumbo_plugin_api {
+    int abi_version;
+    void* context;
+    /* Returns 0 on success, nonzero if the name is taken or arity is not in
+     * 0..WUMBO_MAX_ARITY. */
+    int (*register_function)(void* context, const char* name, int arity, wumbo_fn scalar, wumbo_fn batch);
+} wumbo_plugin_api;
+
+typedef int (*wumbo_plugin_init_fn)(const wumbo_plugin_api* api);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,388 @@
+#include "poly.h"
+#include "fft.h"
+#include "ntt.h"
+#include "engine.h"
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+namespace wumbo {
+
+namespace {
+
+// Operands this short are multiplied directly, and up to karatsubaMax by
+// Karatsuba before switching to transforms.
+constexpr size_t schoolbookMax = 32;
+constexpr size_t karatsubaMax = 1024;
+// Quotients this short are found by long division.
+constexpr size_t longDivisionMax = 64;
+
+void schoolbook(const double* a, size_t na, const double* b, size_t nb, double* out) {
+    std::fill(out, out + na + nb - 1, 0.0);
+    for (size_t i = 0; i < na; ++i)
+        for (size_t j = 0; j < nb; ++j) out[i + j] += a[i] * b[j];
+}
+
+// out (2n - 1 points) = a * b for two n-point operands.
+void karatsuba(const double* a, const double* b, size_t n, double* out) {
+    if (n <= schoolbookMax) {
+        schoolbook(a, n, b, n, out);
+        return;
+    }
+    size_t lo = n / 2, hi = n - lo;
+    std::vector<double> sa(hi), sb(hi), mid(2 * hi - 1);
+    for (size_t i = 0; i < hi; ++i) {
+        sa[i] = a[lo + i] + (i < lo ? a[i] : 0);
+        sb[i] = b[lo + i] + (i < lo ? b[i] : 0);
+    }
+    // out[0, 2lo-1) = a0 b0 and out[2lo, 2n-1) = a1 b1 don't overlap.
+    std::fill(out, out + 2 * n - 1, 0.0);
+    karatsuba(a, b, lo, out);
+    karatsuba(a + lo, b + lo, hi, out + 2 * lo);
+    karatsuba(sa.data(), sb.data(), hi, mid.data());
+    for (size_t i = 0; i + 1 < 2 * lo; ++i) mid[i] -= out[i];
+    for (size_t i = 0; i + 1 < 2 * hi; ++i) mid[i] -= out[2 * lo + i];
+    for (size_t i = 0; i + 1 < 2 * hi; ++i) out[lo + i] += mid[i];
+}
+
+// Unequal operands are cut into pieces as long as the shorter one.
+void karatsubaUnbalanced(const double* a, size_t na, const double* b, size_t nb, double* out) {
+    if (na < nb) {
+        std::swap(a, b);
+        std::swap(na, nb);
+    }
+    std::fill(out, out + na + nb - 1, 0.0);
+    std::vector<double> piece(nb), part(2 * nb - 1);
+    for (size_t start = 0; start < na; start += nb) {
+        size_t len = std::min(nb, na - start);
+        std::fill(piece.begin(), piece.end(), 0.0);
+        std::copy(a + start, a + start + len, piece.begin());
+        karatsuba(piece.data(), b, nb, part.data());
+        for (size_t i = 0; i < len + nb - 1; ++i) out[start + i] += part[i];
+    }
+}
+
+// Residue of an integer-valued double; fmod is exact.
+uint32_t residue(double x, uint32_t p) {
+    double r = std::fmod(x, (double)p);
+    return (uint32_t)(r < 0 ? r + p : r);
+}
+
+bool integerCoeffs(const Coeffs& a, double& maxAbs) {
+    maxAbs = 0;
+    for (double c : a) {
+        if (!std::isfinite(c) || c != std::floor(c)) return false;
+        maxAbs = std::max(maxAbs, std::fabs(c));
+    }
+    return true;
+}
+
+Residues reduce(const Coeffs& a, size_t n, uint32_t p) {
+    Residues r(n);
+    for (size_t j = 0; j < std::min(n, a.size()); ++j) r[j] = residue(a[j], p);
+    return r;
+}
+
+// Recombines residues by Garner's algorithm. For each coefficient the
+// mixed-radix digits d give X = d0 + p0 (d1 + p1 (d2 + ...)), evaluated
+// top-down in long double; X above (P-1)/2, whose digits are (p_i-1)/2,
+// stands for the negative X - P. Primes can be added one at a time.
+class Garner {
+public:
+    explicit Garner(size_t count) : count(count) {}
+
+    void add(const NttPrime& prime, const Residues& r) {
+        size_t j = primes.size();
+        primes.push_back(prime);
+        for (size_t i = 0; i < j; ++i) inv.push_back(powMod(primes[i].p, prime.p - 2, prime.p));
+        digits.resize(count * (j + 1));
+        for (size_t c = 0; c < count; ++c) {
+            uint64_t x = r[c];
+            for (size_t i = 0; i < j; ++i)
+                x = (x + prime.p - digits[c * j + i] % prime.p) * inv[j * (j - 1) / 2 + i] % prime.p;
+            next.push_back((uint32_t)x);
+        }
+        // Widen the per-coefficient digit rows from j to j + 1.
+        for (size_t c = count; c-- > 0;) {
+            for (size_t i = j; i-- > 0;) digits[c * (j + 1) + i] = digits[c * j + i];
+            digits[c * (j + 1) + j] = next[c];
+        }
+        next.clear();
+    }
+
+    // True if the last prime added changed nothing: every value already fit
+    // in the primes before it, so its top digit is 0, or p-1 for a negative.
+    bool settled() const {
+        size_t k = primes.size();
+        if (k < 2) return false;
+        for (size_t c = 0; c < count; ++c) {
+            uint32_t top = digits[c * k + k - 1];
+            if (top != 0 && top != primes[k - 1].p - 1) return false;
+        }
+        return true;
+    }
+
+    double value(size_t c) const {
+        size_t k = primes.size();
+        const uint32_t* d = &digits[c * k];
+        bool negative = false;
+        for (size_t j = k; j-- > 0;) {
+            uint32_t half = (primes[j].p - 1) / 2;
+            if (d[j] != half) {
+                negative = d[j] > half;
+                break;
+            }
+        }
+        long double v = 0;
+        for (size_t j = k; j-- > 0;) v = v * primes[j].p + (negative ? primes[j].p - 1 - d[j] : d[j]);
+        return negative ? -(double)(v + 1) : (double)v;
+    }
+
+private:
+    size_t count;
+    std::vector<NttPrime> primes;
+    std::vector<uint32_t> inv, digits, next;
+};
+
+// Multiplies modulo as many primes as a coefficient of bits bits, the most
+// the product can have, needs; false if there are too few primes, a
+// coefficient is past the range of doubles or guard stops it.
+bool nttMul(const Coeffs& a, const Coeffs& b, double bits, Coeffs& out, BudgetGuard* guard) {
+    size_t len = a.size() + b.size() - 1;
+    size_t want = (size_t)std::ceil((bits + 2) / 30);
+    std::vector<NttPrime> primes = nttPrimes(log2Ceil(len), want);
+    if (primes.size() < want) return false;
+    // A digit per coefficient and prime, and the transforms of one prime.
+    if (guard && !guard->charge((len * want + ((size_t)3 << log2Ceil(len))) * sizeof(uint32_t))) return false;
+    Garner garner(len);
+    for (auto& prime : primes) {
+        if (guard && !guard->tick(len)) return false;
+        garner.add(prime, mulMod(reduce(a, a.size(), prime.p), reduce(b, b.size(), prime.p), len, prime));
+    }
+    out.resize(len);
+    for (size_t c = 0; c < len; ++c)
+        if (!std::isfinite(out[c] = garner.value(c))) return false;
+    return true;
+}
+
+// 1/f modulo x^n and p by Newton's iteration g <- g (2 - f g), which doubles
+// the number of correct terms each step. f[0] must be nonzero.
+Residues reciprocalMod(const Residues& f, size_t n, const NttPrime& prime) {
+    uint32_t p = prime.p;
+    Residues g{powMod(f[0], p - 2, p)};
+    for (size_t len = 1; len < n;) {
+        len = std::min(2 * len, n);
+        Residues head(f.begin(), f.begin() + std::min(len, f.size()));
+        Residues e = mulMod(head, g, len, prime);
+        for (auto& c : e) c = c ? p - c : 0;
+        e[0] = (e[0] + 2) % p;
+        g = mulMod(g, e, len, prime);
+    }
+    return g;
+}
+
+// The quotient of integer polynomials by one with leading coefficient +-1
+// has integer coefficients, but the reciprocal series behind it can grow
+// exponentially and cancel, which floating point cannot follow. So the
+// quotient is found modulo one prime after another, Newton's iteration
+// running in Z_p, until an extra prime no longer changes it.
+bool integerQuotient(const Coeffs& a, const Coeffs& b, Coeffs& q, BudgetGuard* guard) {
+    size_t qn = a.size() - b.size() + 1;
+    Coeffs ra(a.rbegin(), a.rbegin() + qn), rb(b.rbegin(), b.rend());
+    std::vector<NttPrime> primes = nttPrimes(log2Ceil(2 * qn), 91);
+    Garner garner(qn);
+    for (auto& prime : primes) {
+        // Another digit per coefficient, and the transforms of this prime.
+        if (guard && !guard->reserve(qn, (qn + ((size_t)6 << log2Ceil(2 * qn))) * sizeof(uint32_t))) return false;
+        Residues inv = reciprocalMod(reduce(rb, std::min(qn, rb.size()), prime.p), qn, prime);
+        garner.add(prime, mulMod(reduce(ra, qn, prime.p), inv, qn, prime));
+        if (garner.settled()) {
+            q.resize(qn);
+            for (size_t c = 0; c < qn; ++c) q[qn - 1 - c] = garner.value(c);
+            return true;
+        }
+    }
+    return false;
+}
+
+// The reciprocal g of f modulo x^n by Newton's iteration g <- g (2 - f g),
+// which doubles the number of correct terms each step; false if a product
+// is refused. f[0] must be nonzero.
+bool reciprocal(const Coeffs& f, size_t n, Coeffs& g, BudgetGuard* guard) {
+    g = {1 / f[0]};
+    Coeffs e;
+    for (size_t len = 1; len < n;) {
+        len = std::min(2 * len, n);
+        Coeffs head(f.begin(), f.begin() + std::min(len, f.size()));
+        if (!polyMul(head, g, e, guard)) return false;
+        e.resize(len);
+        for (auto& c : e) c = -c;
+        e[0] += 2;
+        if (!polyMul(g, e, g, guard)) return false;
+        g.resize(len);
+    }
+    return true;
+}
+
+double maxAbs(const Coeffs& a) {
+    double m = 0;
+    for (double c : a) m = std::max(m, std::fabs(c));
+    return m;
+}
+
+}
+
+void trimPoly(Coeffs& a) {
+    while (!a.empty() && a.back() == 0) a.pop_back();
+}
+
+bool polyMul(const Coeffs& a, const Coeffs& b, Coeffs& product, BudgetGuard* guard) {
+    if (a.empty() || b.empty()) {
+        product.clear();
+        return true;
+    }
+    size_t shorter = std::min(a.size(), b.size()), len = a.size() + b.size() - 1;
+    if (guard && !guard->reserve(len, len * sizeof(double))) return false;
+    Coeffs out(len);
+    if (shorter <= schoolbookMax) {
+        schoolbook(a.data(), a.size(), b.data(), b.size(), out.data());
+        product = std::move(out);
+        return true;
+    }
+    double maxA, maxB;
+    if (integerCoeffs(a, maxA) && integerCoeffs(b, maxB)) {
+        if (maxA == 0 || maxB == 0) {
+            product.assign(out.size(), 0.0);
+            return true;
+        }
+        // The most bits a coefficient of the product can have, counted in
+        // logarithms since the bound itself may be past the range of doubles.
+        double bits = std::log2(maxA) + std::log2(maxB) + std::log2((double)shorter);
+        // Below 2^40 every sum Karatsuba forms is an exact double.
+        if (bits < 40 && shorter <= karatsubaMax) {
+            if (guard && !guard->charge(4 * shorter * sizeof(double))) return false;
+            karatsubaUnbalanced(a.data(), a.size(), b.data(), b.size(), out.data());
+            product = std::move(out);
+            return true;
+        }
+        if (nttMul(a, b, bits, out, guard)) {
+            product = std::move(out);
+            return true;
+        }
+        // Too long for enough primes, or too large for doubles. Coefficients
+        // this wide would come out of a floating-point transform with errors
+        // as large as the small ones, so they are refused rather than made up.
+        if (bits >= 53 || (guard && !guard->check())) return false;
+    }
+    // Scaled copies of the operands, and the transforms.
+    if (guard && !guard->charge(5 * len * sizeof(double))) return false;
+    // Scaled so that the largest coefficients are near 1, no partial sum
+    // overflows where the product itself does not.
+    int expA = 0, expB = 0;
+    double scaleA = maxAbs(a), scaleB = maxAbs(b);
+    if (std::isfinite(scaleA)) std::frexp(scaleA, &expA);
+    if (std::isfinite(scaleB)) std::frexp(scaleB, &expB);
+    Coeffs sa(a.size()), sb(b.size());
+    for (size_t i = 0; i < a.size(); ++i) sa[i] = std::ldexp(a[i], -expA);
+    for (size_t i = 0; i < b.size(); ++i) sb[i] = std::ldexp(b[i], -expB);
+    if (shorter <= karatsubaMax) karatsubaUnbalanced(sa.data(), sa.size(), sb.data(), sb.size(), out.data());
+    else convolveReal(sa.data(), sa.size(), sb.data(), sb.size(), out.data());
+    for (auto& c : out) c = std::ldexp(c, expA + expB);
+    product = std::move(out);
+    return true;
+}
+
+bool polyPow(const Coeffs& a, unsigned long n, Coeffs& out, BudgetGuard* guard) {
+    out = {1};
+    if (n == 0) return true;
+    if (a.empty()) {
+        out.clear();
+        return true;
+    }
+    if ((double)(a.size() - 1) * n > maxPolyDegree) return false;
+    Coeffs base = a;
+    for (;;) {
+        if ((n & 1) && !polyMul(out, base, out, guard)) return false;
+        n >>= 1;
+        if (!n) return true;
+        if (!polyMul(base, base, base, guard)) return false;
+    }
+}
+
+bool polyDivMod(const Coeffs& a0, const Coeffs& b0, Coeffs& q, Coeffs& r, BudgetGuard* guard) {
+    Coeffs a = a0, b = b0;
+    trimPoly(a);
+    trimPoly(b);
+    if (b.empty()) return false;
+    if (a.size() < b.size()) {
+        q.clear();
+        r = a;
+        return true;
+    }
+    size_t qn = a.size() - b.size() + 1;
+    if (qn <= longDivisionMax) {
+        q.assign(qn, 0.0);
+        r = a;
+        for (size_t i = qn; i-- > 0;) {
+            double c = r[i + b.size() - 1] / b.back();
+            q[i] = c;
+            for (size_t j = 0; j < b.size(); ++j) r[i + j] -= c * b[j];
+        }
+        r.resize(b.size() - 1);
+    } else {
+        // With rev(p) the coefficients of p reversed, rev(q) = rev(a) / rev(b)
+        // modulo x^qn, and rev(b) has the nonzero leading coefficient of b as
+        // its constant term.
+        double maxA, maxB;
+        bool integer = integerCoeffs(a, maxA) && integerCoeffs(b, maxB) && std::fabs(b.back()) == 1;
+        if (!integer || !integerQuotient(a, b, q, guard)) {
+            if (guard && !guard->check()) return false;
+            Coeffs ra(a.rbegin(), a.rbegin() + qn), rb(b.rbegin(), b.rend());
+            if (rb.size() > qn) rb.resize(qn);
+            Coeffs inv;
+            if (!reciprocal(rb, qn, inv, guard) || !polyMul(ra, inv, q, guard)) return false;
+            q.resize(qn);
+            std::reverse(q.begin(), q.end());
+        }
+        Coeffs bq;
+        if (!polyMul(b, q, bq, guard)) return false;
+        r.assign(b.size() - 1, 0.0);
+        for (size_t i = 0; i < r.size(); ++i) r[i] = a[i] - bq[i];
+    }
+    trimPoly(q);
+    trimPoly(r);
+    return true;
+}
+
+bool polyGcd(Coeffs a, Coeffs b, Coeffs& out, BudgetGuard* guard) {
+    trimPoly(a);
+    trimPoly(b);
+    double maxA, maxB;
+    bool integer = integerCoeffs(a, maxA) && integerCoeffs(b, maxB);
+    Coeffs q, r;
+    while (!b.empty()) {
+        if (!polyDivMod(a, b, q, r, guard)) return false;
+        // Remainder terms this small next to the dividend are rounding left
+        // over from an exact division.
+        double scale = 0;
+        for (double c : a) scale = std::max(scale, std::fabs(c));
+        for (auto& c : r)
+            if (std::fabs(c) <= 1e-10 * scale) c = 0;
+        trimPoly(r);
+        a = std::move(b);
+        b = std::move(r);
+    }
+    out = std::move(a);
+    if (out.empty()) return true;
+    double lead = out.back();
+    for (auto& c : out) {
+        c /= lead;
+        // The monic gcd of integer polynomials usually has small rational
+        // coefficients; snap those that are integers up to rounding.
+        if (integer && std::fabs(c - std::nearbyint(c)) <= 1e-9 * std::max(1.0, std::fabs(c))) c = std::nearbyint(c);
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// Dense polynomials in x with double coefficients, lowest power first. An
+// empty vector is the zero polynomial.
+
+#include <vector>
+#include <cstddef>
+
+namespace wumbo {
+
+typedef std::vector<double> Coeffs;
+
+class BudgetGuard;
+
+// Results of higher degree are refused rather than allocated.
+constexpr size_t maxPolyDegree = 1 << 24;
+
+// Drops zero leading coefficients.
+void trimPoly(Coeffs& a);
+
+// The functions below also fail when guard, if given, stops them, and charge
+// it for the memory each product needs before allocating that memory.
+
+// Schoolbook for short operands and Karatsuba for medium ones. Long operands
+// with integer coefficients go through number-theoretic transforms modulo as
+// many 31-bit primes as the result's size needs, recombined by CRT, so the
+// coefficients are exact up to the final rounding to double; others go
+// through the floating-point transform in fft.h. Integer products that would
+// need more primes than there are, or have coefficients past the range of
+// doubles, are refused with false, leaving product untouched. product may
+// alias a or b.
+bool polyMul(const Coeffs& a, const Coeffs& b, Coeffs& product, BudgetGuard* guard = nullptr);
+// a^n by repeated squaring; false if the result would be too large or a
+// product is refused.
+bool polyPow(const Coeffs& a, unsigned long n, Coeffs& out, BudgetGuard* guard = nullptr);
+// a = q b + r with deg r < deg b; false if b is zero or a product is
+// refused. Long quotients use Newton iteration for the reciprocal of b, so
+// division costs a few multiplications.
+bool polyDivMod(const Coeffs& a, const Coeffs& b, Coeffs& q, Coeffs& r, BudgetGuard* guard = nullptr);
+// The monic greatest common divisor, by Euclid's algorithm with remainders
+// that vanish to rounding treated as zero; false if a division fails.
+bool polyGcd(Coeffs a, Coeffs b, Coeffs& out, BudgetGuard* guard = nullptr);
+
+}
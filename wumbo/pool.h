@@ -0,0 +1,42 @@
+#pragma once
+
+// Long-lived worker threads taking tasks from one queue, for work that
+// outlives the call that starts it (parallel.h covers work that does not).
+
+#include <functional>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "parallel.h"
+
+namespace wumbo {
+
+class WorkerPool {
+public:
+    explicit WorkerPool(unsigned threads = hardwareThreads());
+    // Runs the tasks still queued, then joins the threads.
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Queues task to run on some worker; tasks start in the order queued.
+    void submit(std::function<void()> task);
+    unsigned size() const { return (unsigned)threads.size(); }
+
+    // The pool shared by everything in the process, started on first use.
+    static WorkerPool& shared();
+
+private:
+    void run();
+
+    std::mutex m;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> tasks;
+    bool stopping = false;
+    std::vector<std::thread> threads;
+};
+
+}
@@ -0,0 +1,945 @@
+#include "script.h"
+
+#include <cmath>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace wumbo {
+
+// The instruction set. Registers are slots of the running function's frame;
+// jumps are relative to the jumping instruction.
+//   'k'  a = constants[b]        'v'  a = values[b]       'm'  a = b
+//   '+' '-' '*' '/' '^'  a = b op c, as applyOp
+//   '~'  a = -b                  '!'  a = not b           't'  a = b as 1 or 0
+//   '?'  a = b cmp c as 1 or 0, cmp being '<', 'l' (<=), '=' or '#' (!=)
+//   'f'  a = calls[b] on c, c + 1, ...
+//   'c'  a = functions[b] on c, c + 1, ...
+//   'j'  jump by c               'F' / 'T'  jump by c if a is false / true
+//   'b'  jump by c unless a cmp b
+//   'P'  jump by c unless a is within the bound b, going by the step in b + 1
+//   'N'  a += step, then jump by c if a is still within the bound
+//   'r'  return a
+
+namespace {
+
+bool truth(double x) {
+    return x != 0 && x == x;
+}
+
+bool compare(double a, double b, char cmp) {
+    switch (cmp) {
+        case '<': return a < b;
+        case 'l': return a <= b;
+        case '=': return a == b;
+        default: return a != b;
+    }
+}
+
+bool keyword(const std::string& s) {
+    static const char* const words[] = {"def", "if", "else", "while", "for", "return", "and", "or", "not"};
+    for (const char* w : words)
+        if (s == w) return true;
+    return false;
+}
+
+// Expression kinds: 'n' number, 'a' name, 'c' call, '~' negation, '!' not,
+// and otherwise the binary operator: + - * / ^, a comparison < l > g E N
+// (<, <=, >, >=, ==, !=), '&' and, '|' or.
+struct Expr {
+    char kind;
+    double value = 0;
+    std::string name;
+    std::vector<std::unique_ptr<Expr>> args;
+};
+using ExprPtr = std::unique_ptr<Expr>;
+
+// Statement kinds: 'e' expression, '=' assignment, 'i' if, 'w' while,
+// 'f' for, 'r' return.
+struct Stmt {
+    char kind;
+    int line = 0;
+    std::string name;
+    ExprPtr a, b, c;
+    std::vector<std::unique_ptr<Stmt>> body, orElse;
+};
+using StmtPtr = std::unique_ptr<Stmt>;
+
+struct Def {
+    std::string name;
+    int line = 0;
+    std::vector<std::string> params;
+    std::vector<StmtPtr> body;
+};
+
+ExprPtr node(char kind, ExprPtr a = nullptr, ExprPtr b = nullptr) {
+    auto e = std::make_unique<Expr>();
+    e->kind = kind;
+    if (a) e->args.push_back(std::move(a));
+    if (b) e->args.push_back(std::move(b));
+    return e;
+}
+
+bool comparison(char kind) {
+    return kind && strchr("<l>gEN", kind);
+}
+
+// Recursive descent over lexemes: 'n' number, 'a' name, ';' a new line or
+// semicolon, 0 the end, and otherwise the operator or bracket, with <=, >=,
+// == and != as l, g, E and N. New lines inside parentheses are spaces.
+class Parser {
+public:
+    explicit Parser(const std::string& src) : src(&src) { next(); }
+
+    // defs[0] is the top level, followed by the functions defined.
+    bool program(std::vector<Def>& defs) {
+        Def top;
+        std::vector<Def> functions;
+        if (!statements(top.body, 0, &functions)) return false;
+        defs.push_back(std::move(top));
+        for (auto& d : functions) defs.push_back(std::move(d));
+        return true;
+    }
+
+    std::string error;
+
+private:
+    const std::string* src;
+    size_t pos = 0;
+    int line = 1, parens = 0;
+    char kind = 0;
+    int at = 1;
+    double number = 0;
+    std::string name;
+
+    void next() {
+        const std::string& s = *src;
+        while (pos < s.size()) {
+            if (s[pos] == '#') {
+                while (pos < s.size() && s[pos] != '\n') pos++;
+            } else if (s[pos] == '\n' && parens == 0) {
+                break;
+            } else if (isspace((unsigned char)s[pos])) {
+                line += s[pos++] == '\n';
+            } else {
+                break;
+            }
+        }
+        at = line;
+        if (pos >= s.size()) { kind = 0; return; }
+        char ch = s[pos];
+        if (ch == '\n' || ch == ';') {
+            line += ch == '\n';
+            pos++;
+            kind = ';';
+        } else if (isdigit((unsigned char)ch) || (ch == '.' && isdigit((unsigned char)s[pos + 1]))) {
+            char* end;
+            number = strtod(s.c_str() + pos, &end);
+            pos = end - s.c_str();
+            kind = 'n';
+        } else if (isalpha((unsigned char)ch) || ch == '_') {
+            size_t start = pos;
+            while (pos < s.size() && (isalnum((unsigned char)s[pos]) || s[pos] == '_')) pos++;
+            name = s.substr(start, pos - start);
+            kind = 'a';
+        } else if (pos + 1 < s.size() && s[pos + 1] == '=' && strchr("<>=!", ch)) {
+            kind = ch == '<' ? 'l' : ch == '>' ? 'g' : ch == '=' ? 'E' : 'N';
+            pos += 2;
+        } else {
+            kind = strchr("+-*/^!(){},=<>", ch) ? ch : '?';
+            if (ch == '(') parens++;
+            if (ch == ')' && parens) parens--;
+            pos++;
+        }
+    }
+
+    bool word(const char* w) const { return kind == 'a' && name == w; }
+
+    bool fail(const std::string& what) {
+        if (error.empty()) error = "line " + std::to_string(at) + ": " + what;
+        return false;
+    }
+
+    bool expect(char k, const char* what) {
+        if (kind != k) return fail(std::string("expected ") + what);
+        next();
+        return true;
+    }
+
+    bool identifier(std::string& out, const char* what) {
+        if (kind != 'a' || keyword(name)) return fail(std::string("expected ") + what);
+        out = name;
+        next();
+        return true;
+    }
+
+    // Statements up to end ('}' or 0), which is left unread.
+    bool statements(std::vector<StmtPtr>& out, char end, std::vector<Def>* defs) {
+        for (;;) {
+            while (kind == ';') next();
+            if (kind == end) return true;
+            if (kind == 0) return fail("missing }");
+            if (word("def")) {
+                if (!defs) return fail("functions are defined at the top level");
+                if (!def(*defs)) return false;
+                continue;
+            }
+            bool block = false;
+            StmtPtr s = statement(block);
+            if (!s) return false;
+            out.push_back(std::move(s));
+            if (!block && kind != ';' && kind != end) return fail("expected a new line or ;");
+        }
+    }
+
+    bool def(std::vector<Def>& defs) {
+        Def d;
+        d.line = at;
+        next();
+        if (!identifier(d.name, "a function name") || !expect('(', "(")) return false;
+        while (kind != ')') {
+            if (!d.params.empty() && !expect(',', ", or )")) return false;
+            d.params.emplace_back();
+            if (!identifier(d.params.back(), "a parameter name")) return false;
+        }
+        next();
+        if (!block(d.body)) return false;
+        defs.push_back(std::move(d));
+        return true;
+    }
+
+    bool block(std::vector<StmtPtr>& out) {
+        if (!expect('{', "{")) return false;
+        if (!statements(out, '}', nullptr)) return false;
+        next();
+        return true;
+    }
+
+    StmtPtr statement(bool& isBlock) {
+        auto s = std::make_unique<Stmt>();
+        s->line = at;
+        isBlock = word("if") || word("while") || word("for");
+        if (word("if")) {
+            next();
+            s->kind = 'i';
+            if (!(s->a = expr()) || !block(s->body)) return nullptr;
+            Parser saved = *this;
+            while (kind == ';') next();
+            if (!word("else")) {
+                *this = saved;
+                return s;
+            }
+            next();
+            if (word("if")) {
+                bool nested;
+                StmtPtr inner = statement(nested);
+                if (!inner) return nullptr;
+                s->orElse.push_back(std::move(inner));
+            } else if (!block(s->orElse)) {
+                return nullptr;
+            }
+        } else if (word("while")) {
+            next();
+            s->kind = 'w';
+            if (!(s->a = expr()) || !block(s->body)) return nullptr;
+        } else if (word("for")) {
+            next();
+            s->kind = 'f';
+            if (!identifier(s->name, "a variable") || !expect('=', "=")) return nullptr;
+            if (!(s->a = expr()) || !expect(',', ",") || !(s->b = expr())) return nullptr;
+            if (kind == ',') {
+                next();
+                if (!(s->c = expr())) return nullptr;
+            }
+            if (!block(s->body)) return nullptr;
+        } else if (word("return")) {
+            next();
+            s->kind = 'r';
+            if (kind != ';' && kind != '}' && kind != 0 && !(s->a = expr())) return nullptr;
+        } else if (word("else")) {
+            fail("else without if");
+            return nullptr;
+        } else {
+            s->kind = 'e';
+            if (kind == 'a' && !keyword(name)) {
+                Parser saved = *this;
+                next();
+                if (kind == '=') {
+                    s->kind = '=';
+                    s->name = saved.name;
+                    next();
+                } else {
+                    *this = saved;
+                }
+            }
+            if (!(s->a = expr())) return nullptr;
+        }
+        return s;
+    }
+
+    ExprPtr expr() {
+        ExprPtr l = conjunction();
+        while (l && word("or")) {
+            next();
+            ExprPtr r = conjunction();
+            if (!r) return nullptr;
+            l = node('|', std::move(l), std::move(r));
+        }
+        return l;
+    }
+
+    ExprPtr conjunction() {
+        ExprPtr l = negation();
+        while (l && word("and")) {
+            next();
+            ExprPtr r = negation();
+            if (!r) return nullptr;
+            l = node('&', std::move(l), std::move(r));
+        }
+        return l;
+    }
+
+    ExprPtr negation() {
+        if (!word("not")) return relation();
+        next();
+        ExprPtr e = negation();
+        return e ? node('!', std::move(e)) : nullptr;
+    }
+
+    ExprPtr relation() {
+        ExprPtr l = sum();
+        if (!l || !comparison(kind)) return l;
+        char op = kind;
+        next();
+        ExprPtr r = sum();
+        if (!r) return nullptr;
+        if (comparison(kind)) {
+            fail("comparisons do not chain");
+            return nullptr;
+        }
+        return node(op, std::move(l), std::move(r));
+    }
+
+    ExprPtr sum() {
+        ExprPtr l = term();
+        while (l && (kind == '+' || kind == '-')) {
+            char op = kind;
+            next();
+            ExprPtr r = term();
+            if (!r) return nullptr;
+            l = node(op, std::move(l), std::move(r));
+        }
+        return l;
+    }
+
+    ExprPtr term() {
+        ExprPtr l = unary();
+        while (l && (kind == '*' || kind == '/')) {
+            char op = kind;
+            next();
+            ExprPtr r = unary();
+            if (!r) return nullptr;
+            l = node(op, std::move(l), std::move(r));
+        }
+        return l;
+    }
+
+    // -2^2 is -4, and 2^-1 is a half.
+    ExprPtr unary() {
+        if (kind != '-') return power();
+        next();
+        ExprPtr e = unary();
+        return e ? node('~', std::move(e)) : nullptr;
+    }
+
+    ExprPtr power() {
+        ExprPtr b = postfix();
+        if (!b || kind != '^') return b;
+        next();
+        ExprPtr e = unary();
+        return e ? node('^', std::move(b), std::move(e)) : nullptr;
+    }
+
+    ExprPtr postfix() {
+        ExprPtr e = primary();
+        while (e && kind == '!') {
+            next();
+            e = node('c', std::move(e));
+            e->name = "factorial";
+        }
+        return e;
+    }
+
+    ExprPtr primary() {
+        if (kind == 'n') {
+            ExprPtr e = node('n');
+            e->value = number;
+            next();
+            return e;
+        }
+        if (kind == '(') {
+            next();
+            ExprPtr e = expr();
+            if (!e || !expect(')', ")")) return nullptr;
+            return e;
+        }
+        if (kind != 'a' || keyword(name)) {
+            fail("expected a number, a name or (");
+            return nullptr;
+        }
+        ExprPtr e = node('a');
+        e->name = name;
+        next();
+        if (kind != '(') return e;
+        e->kind = 'c';
+        next();
+        while (kind != ')') {
+            if (!e->args.empty() && !expect(',', ", or )")) return nullptr;
+            ExprPtr arg = expr();
+            if (!arg) return nullptr;
+            e->args.push_back(std::move(arg));
+        }
+        next();
+        return e;
+    }
+};
+
+void assignedIn(const std::vector<StmtPtr>& body, std::vector<std::string>& names) {
+    for (auto& s : body) {
+        if ((s->kind == '=' || s->kind == 'f') && std::find(names.begin(), names.end(), s->name) == names.end())
+            names.push_back(s->name);
+        assignedIn(s->body, names);
+        assignedIn(s->orElse, names);
+    }
+}
+
+class Compiler {
+public:
+    Compiler(Script& script, const SymbolTable* symbols, std::string& error)
+        : script(script), symbols(symbols), error(error) {}
+
+    bool run(std::vector<Def>& defs) {
+        for (size_t i = 1; i < defs.size(); ++i) {
+            const std::string& name = defs[i].name;
+            line = defs[i].line;
+            if (defIndex.count(name)) return fail(name + " is defined twice");
+            if (lookup(name)) return fail(name + " is already a function");
+            defIndex[name] = {(int)i, defs[i].params.size()};
+        }
+        script.functions.resize(defs.size());
+        for (size_t i = 0; i < defs.size(); ++i) {
+            topLevel = i == 0;
+            if (!function(defs[i], script.functions[i])) return false;
+        }
+        // Its result would always be NaN, which reads as a failure.
+        if (!valued) return fail("the script has no value; end it with an expression");
+        return true;
+    }
+
+private:
+    // A loop being compiled: what its body assigns, and the instructions
+    // hoisted to run once in front of it.
+    struct Loop {
+        std::unordered_set<std::string> assigned;
+        std::vector<ScriptOp> pre;
+    };
+
+    struct Callee {
+        int index;
+        size_t arity;
+    };
+
+    Script& script;
+    const SymbolTable* symbols;
+    std::string& error;
+    int line = 0;
+    std::unordered_map<std::string, Callee> defIndex;
+
+    // The function being compiled. Loops enclosing the current instruction
+    // are loops[0, depth), outermost first.
+    std::unordered_map<std::string, int> locals;
+    std::unordered_map<uint64_t, int> constantRegs;
+    std::unordered_map<const Binding*, int> valueRegs;
+    std::vector<ScriptOp> prologue;
+    std::vector<ScriptOp>* code = nullptr;
+    std::vector<Loop*> loops;
+    size_t depth = 0;
+    int registers = 0;
+    int result = 0;
+    // Whether the top level, defs[0], is being compiled, and whether it has
+    // any statement that sets its value.
+    bool topLevel = false, valued = false;
+
+    bool fail(const std::string& what) {
+        if (error.empty()) error = "line " + std::to_string(line) + ": " + what;
+        return false;
+    }
+
+    const Function* lookup(const std::string& name) const {
+        return symbols ? symbols->findFunction(name) : findBuiltin(name);
+    }
+
+    size_t emit(ScriptOp op) {
+        code->push_back(op);
+        return code->size() - 1;
+    }
+
+    void patch(size_t jump) { (*code)[jump].c = (int32_t)(code->size() - jump); }
+
+    bool function(const Def& d, ScriptFunction& out) {
+        locals.clear();
+        constantRegs.clear();
+        valueRegs.clear();
+        prologue.clear();
+        loops.clear();
+        depth = 0;
+        registers = 0;
+        line = d.line;
+        std::vector<std::string> names = d.params;
+        for (size_t i = 0; i < names.size(); ++i)
+            if (std::find(names.begin(), names.begin() + i, names[i]) != names.begin() + i)
+                return fail(names[i] + " is a parameter twice");
+        assignedIn(d.body, names);
+        for (size_t i = 0; i < names.size(); ++i) {
+            // Assigning to a function is reported at the assignment.
+            if (lookup(names[i]) || defIndex.count(names[i])) {
+                if (i < d.params.size()) return fail(names[i] + " is a function");
+                continue;
+            }
+            locals.emplace(names[i], registers++);
+        }
+        result = registers++;
+        std::vector<ScriptOp> body;
+        code = &body;
+        if (!statements(d.body)) return false;
+        emit({'r', 0, result});
+        out.params = (int)d.params.size();
+        out.code = std::move(prologue);
+        out.code.insert(out.code.end(), body.begin(), body.end());
+        out.registers = registers;
+        return true;
+    }
+
+    bool statements(const std::vector<StmtPtr>& body) {
+        for (auto& s : body)
+            if (!statement(*s)) return false;
+        return true;
+    }
+
+    bool statement(const Stmt& s) {
+        line = s.line;
+        switch (s.kind) {
+            case 'e':
+                valued |= topLevel;
+                return expr(*s.a, result) >= 0;
+            case '=': {
+                valued |= topLevel;
+                auto var = locals.find(s.name);
+                if (var == locals.end()) return fail(s.name + " is a function");
+                return move(expr(*s.a, var->second), result);
+            }
+            case 'r': {
+                valued |= topLevel && s.a;
+                int r = s.a ? expr(*s.a) : result;
+                if (r < 0) return false;
+                emit({'r', 0, r});
+                return true;
+            }
+            case 'i': {
+                std::vector<size_t> falses;
+                if (!condition(*s.a, falses) || !statements(s.body)) return false;
+                if (s.orElse.empty()) {
+                    for (size_t j : falses) patch(j);
+                    return true;
+                }
+                size_t skip = emit({'j'});
+                for (size_t j : falses) patch(j);
+                if (!statements(s.orElse)) return false;
+                patch(skip);
+                return true;
+            }
+            case 'w': {
+                Loop loop;
+                std::vector<ScriptOp> body;
+                std::vector<ScriptOp>* outer = enter(loop, s, body);
+                std::vector<size_t> falses;
+                if (!condition(*s.a, falses) || !statements(s.body)) return false;
+                emit({'j', 0, 0, 0, -(int32_t)code->size()});
+                for (size_t j : falses) patch(j);
+                leave(loop, body, outer);
+                return true;
+            }
+            case 'f': {
+                if (!locals.count(s.name)) return fail(s.name + " is a function");
+                int var = locals[s.name], bound = registers;
+                registers += 2;
+                if (expr(*s.a, var) < 0 || expr(*s.b, bound) < 0) return false;
+                if (s.c ? expr(*s.c, bound + 1) < 0 : !move(constant(1), bound + 1)) return false;
+                Loop loop;
+                std::vector<ScriptOp> body;
+                std::vector<ScriptOp>* outer = enter(loop, s, body);
+                loop.assigned.insert(s.name);
+                size_t prep = emit({'P', 0, var, bound});
+                if (!statements(s.body)) return false;
+                emit({'N', 0, var, bound, 1 - (int32_t)code->size()});
+                patch(prep);
+                leave(loop, body, outer);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<ScriptOp>* enter(Loop& loop, const Stmt& s, std::vector<ScriptOp>& body) {
+        std::vector<std::string> names;
+        assignedIn(s.body, names);
+        loop.assigned.insert(names.begin(), names.end());
+        loops.push_back(&loop);
+        depth = loops.size();
+        std::vector<ScriptOp>* outer = code;
+        code = &body;
+        return outer;
+    }
+
+    void leave(Loop& loop, const std::vector<ScriptOp>& body, std::vector<ScriptOp>* outer) {
+        loops.pop_back();
+        depth = loops.size();
+        code = outer;
+        code->insert(code->end(), loop.pre.begin(), loop.pre.end());
+        code->insert(code->end(), body.begin(), body.end());
+    }
+
+    // Emits jumps, collected in falses, taken when e does not hold;
+    // comparisons jump on the compared registers directly.
+    bool condition(const Expr& e, std::vector<size_t>& falses) {
+        if (e.kind == '&' && hoistLevel(e) >= depth)
+            return condition(*e.args[0], falses) && condition(*e.args[1], falses);
+        if (comparison(e.kind) && hoistLevel(e) >= depth) {
+            int x = expr(*e.args[0]), y = expr(*e.args[1]);
+            if (x < 0 || y < 0) return false;
+            char cmp = e.kind;
+            if (cmp == '>' || cmp == 'g') std::swap(x, y);
+            falses.push_back(emit({'b', relation(cmp), x, y}));
+            return true;
+        }
+        int r = expr(e);
+        if (r < 0) return false;
+        falses.push_back(emit({'F', 0, r}));
+        return true;
+    }
+
+    static char relation(char kind) {
+        switch (kind) {
+            case '<': case '>': return '<';
+            case 'l': case 'g': return 'l';
+            case 'E': return '=';
+            default: return '#';
+        }
+    }
+
+    int constant(double v) {
+        uint64_t bits;
+        memcpy(&bits, &v, sizeof bits);
+        auto it = constantRegs.find(bits);
+        if (it != constantRegs.end()) return it->second;
+        script.constants.push_back(v);
+        prologue.push_back({'k', 0, registers, (int32_t)script.constants.size() - 1});
+        return constantRegs[bits] = registers++;
+    }
+
+    bool move(int from, int dst) {
+        if (from >= 0 && dst >= 0 && from != dst) emit({'m', 0, dst, from});
+        return from >= 0;
+    }
+
+    int place(int r, int dst) {
+        if (r < 0 || dst < 0) return r;
+        move(r, dst);
+        return dst;
+    }
+
+    int variable(const Expr& e) {
+        auto it = locals.find(e.name);
+        if (it != locals.end()) return it->second;
+        const Binding* b = symbols ? symbols->findValue(e.name) : nullptr;
+        if (!b) {
+            fail(lookup(e.name) || defIndex.count(e.name) ? e.name + " is a function" : "unknown name " + e.name);
+            return -1;
+        }
+        auto v = valueRegs.find(b);
+        if (v != valueRegs.end()) return v->second;
+        script.values.push_back(b);
+        prologue.push_back({'v', 0, registers, (int32_t)script.values.size() - 1});
+        return valueRegs[b] = registers++;
+    }
+
+    // The number of enclosing loops e must stay inside: past those, none of
+    // the loops assigns anything it reads. Calls to script functions stay
+    // put, since they may be costly or not finish and the loop body might
+    // never have run them.
+    size_t hoistLevel(const Expr& e) const {
+        if (e.kind == 'n') return 0;
+        if (e.kind == 'a') {
+            size_t level = 0;
+            for (size_t i = 0; i < depth; ++i)
+                if (loops[i]->assigned.count(e.name)) level = i + 1;
+            return level;
+        }
+        if (e.kind == 'c' && defIndex.count(e.name)) return depth;
+        size_t level = 0;
+        for (auto& a : e.args) level = std::max(level, hoistLevel(*a));
+        return level;
+    }
+
+    // Compiles e into dst, or a new register if dst is -1, and returns the
+    // register holding its value; -1 on error.
+    int expr(const Expr& e, int dst = -1) {
+        if (e.kind == 'n') return place(constant(e.value), dst);
+        if (e.kind == 'a') return place(variable(e), dst);
+        double folded;
+        if (fold(e, folded)) return place(constant(folded), dst);
+        size_t level = hoistLevel(e);
+        if (level < depth) {
+            std::vector<ScriptOp>* here = code;
+            size_t saved = depth;
+            code = &loops[level]->pre;
+            depth = level;
+            int r = expr(e);
+            code = here;
+            depth = saved;
+            return place(r, dst);
+        }
+        int r = dst >= 0 ? dst : registers++;
+        switch (e.kind) {
+            case '~': case '!': {
+                int x = expr(*e.args[0]);
+                if (x < 0) return -1;
+                emit({e.kind, 0, r, x});
+                return r;
+            }
+            case '&': case '|': {
+                int x = expr(*e.args[0]);
+                if (x < 0) return -1;
+                size_t shortCut = emit({e.kind == '&' ? 'F' : 'T', 0, x});
+                int y = expr(*e.args[1]);
+                if (y < 0) return -1;
+                emit({'t', 0, r, y});
+                size_t done = emit({'j'});
+                patch(shortCut);
+                move(constant(e.kind == '|'), r);
+                patch(done);
+                return r;
+            }
+            case 'c': return call(e, r);
+        }
+        int x = expr(*e.args[0]);
+        if (x < 0) return -1;
+        // Squares are the commonest power and need no call to pow.
+        if (e.kind == '^' && e.args[1]->kind == 'n' && e.args[1]->value == 2) {
+            emit({'*', 0, r, x, x});
+            return r;
+        }
+        int y = expr(*e.args[1]);
+        if (y < 0) return -1;
+        if (comparison(e.kind)) {
+            if (e.kind == '>' || e.kind == 'g') std::swap(x, y);
+            emit({'?', relation(e.kind), r, x, y});
+        } else {
+            emit({e.kind, 0, r, x, y});
+        }
+        return r;
+    }
+
+    int call(const Expr& e, int r) {
+        auto d = defIndex.find(e.name);
+        const Function* fn = d == defIndex.end() ? lookup(e.name) : nullptr;
+        if (d == defIndex.end() && !fn) {
+            fail("unknown function " + e.name);
+            return -1;
+        }
+        if (fn && !fn->scalar) {
+            fail(e.name + " has no real form to call from a script");
+            return -1;
+        }
+        size_t arity = fn ? (size_t)fn->arity : d->second.arity;
+        if (e.args.size() != arity) {
+            fail(e.name + " takes " + std::to_string(arity) + " arguments");
+            return -1;
+        }
+        int args = registers;
+        registers += (int)arity;
+        for (size_t i = 0; i < arity; ++i)
+            if (expr(*e.args[i], args + (int)i) < 0) return -1;
+        if (!fn) {
+            emit({'c', 0, r, d->second.index, args});
+            return r;
+        }
+        auto at = std::find(script.calls.begin(), script.calls.end(), fn);
+        if (at == script.calls.end()) at = script.calls.insert(at, fn);
+        emit({'f', 0, r, (int32_t)(at - script.calls.begin()), args});
+        return r;
+    }
+
+    // Operations on constants, and built-ins applied to them, are done once
+    // here; plugin functions are left to run.
+    bool fold(const Expr& e, double& out) const {
+        double v[maxArity];
+        if (e.args.size() > (size_t)maxArity) return false;
+        for (size_t i = 0; i < e.args.size(); ++i) {
+            if (e.args[i]->kind == 'n') v[i] = e.args[i]->value;
+            else if (!fold(*e.args[i], v[i])) return false;
+        }
+        switch (e.kind) {
+            case 'n': out = e.value; return true;
+            case 'a': return false;
+            case 'c': {
+                const Function* fn = defIndex.count(e.name) ? nullptr : findBuiltin(e.name);
+                if (!fn || !fn->scalar || e.args.size() != (size_t)fn->arity) return false;
+                out = fn->call(v);
+                return true;
+            }
+            case '~': out = -v[0]; return true;
+            case '!': out = !truth(v[0]); return true;
+            case '&': out = truth(v[0]) && truth(v[1]); return true;
+            case '|': out = truth(v[0]) || truth(v[1]); return true;
+        }
+        if (comparison(e.kind)) {
+            bool swap = e.kind == '>' || e.kind == 'g';
+            out = compare(swap ? v[1] : v[0], swap ? v[0] : v[1], relation(e.kind));
+        } else {
+            out = applyOp(v[0], v[1], e.kind);
+        }
+        return true;
+    }
+};
+
+}
+
+bool isScript(const std::string& text) {
+    return text.find_first_of(";{}=<>\n") != std::string::npos;
+}
+
+bool compileScript(const std::string& source, Script& out, const SymbolTable* symbols, std::string* error) {
+    out = Script();
+    Parser parser(source);
+    std::vector<Def> defs;
+    std::string message;
+    bool ok = parser.program(defs);
+    if (!ok) message = parser.error;
+    else ok = Compiler(out, symbols, message).run(defs);
+    if (error) *error = message;
+    return ok;
+}
+
+double runScript(const Script& script, BudgetGuard* guard) {
+    if (script.functions.empty()) return NAN;
+    struct Frame {
+        const ScriptFunction* fn;
+        const ScriptOp* ip;
+        size_t base;
+        int32_t dst;
+    };
+    const ScriptFunction* fn = &script.functions[0];
+    std::vector<double> regs(fn->registers, NAN);
+    std::vector<Frame> frames;
+    size_t charged = 0;
+    if (guard && !guard->track(regs, charged)) return NAN;
+    const double* k = script.constants.data();
+    const ScriptOp* ip = fn->code.data();
+    size_t base = 0;
+    double* r = regs.data();
+    for (;;) {
+        const ScriptOp& o = *ip++;
+        switch (o.op) {
+            case 'k': r[o.a] = k[o.b]; break;
+            case 'v': r[o.a] = script.values[o.b]->get().toDouble(); break;
+            case 'm': r[o.a] = r[o.b]; break;
+            case '+': r[o.a] = r[o.b] + r[o.c]; break;
+            case '-': r[o.a] = r[o.b] - r[o.c]; break;
+            case '*': r[o.a] = r[o.b] * r[o.c]; break;
+            case '/': r[o.a] = r[o.c] != 0 ? r[o.b] / r[o.c] : NAN; break;
+            case '^': r[o.a] = pow(r[o.b], r[o.c]); break;
+            case '~': r[o.a] = -r[o.b]; break;
+            case '!': r[o.a] = !truth(r[o.b]); break;
+            case 't': r[o.a] = truth(r[o.b]); break;
+            case '?': r[o.a] = compare(r[o.b], r[o.c], o.cmp); break;
+            case 'f': r[o.a] = script.calls[o.b]->call(r + o.c); break;
+            case 'j':
+                if (o.c < 0 && guard && !guard->tick()) return NAN;
+                ip += o.c - 1;
+                break;
+            case 'F': if (!truth(r[o.a])) ip += o.c - 1; break;
+            case 'T': if (truth(r[o.a])) ip += o.c - 1; break;
+            case 'b': if (!compare(r[o.a], r[o.b], o.cmp)) ip += o.c - 1; break;
+            case 'P': {
+                double step = r[o.b + 1];
+                if (!(step > 0 ? r[o.a] <= r[o.b] : step < 0 && r[o.a] >= r[o.b])) ip += o.c - 1;
+                break;
+            }
+            case 'N': {
+                double step = r[o.b + 1];
+                r[o.a] += step;
+                if (step > 0 ? r[o.a] <= r[o.b] : r[o.a] >= r[o.b]) {
+                    if (guard && !guard->tick()) return NAN;
+                    ip += o.c - 1;
+                }
+                break;
+            }
+            case 'c': {
+                const ScriptFunction& callee = script.functions[o.b];
+                if (frames.size() >= maxScriptDepth || (guard && !guard->tick())) return NAN;
+                size_t next = base + fn->registers;
+                if (regs.size() < next + callee.registers) {
+                    regs.resize(next + callee.registers);
+                    if (guard && !guard->track(regs, charged)) return NAN;
+                }
+                r = regs.data() + base;
+                std::copy(r + o.c, r + o.c + callee.params, regs.data() + next);
+                std::fill(regs.data() + next + callee.params, regs.data() + next + callee.registers, NAN);
+                frames.push_back({fn, ip, base, o.a});
+                fn = &callee;
+                ip = callee.code.data();
+                base = next;
+                r = regs.data() + base;
+                break;
+            }
+            case 'r': {
+                double v = r[o.a];
+                if (frames.empty()) return v;
+                const Frame& f = frames.back();
+                fn = f.fn;
+                ip = f.ip;
+                base = f.base;
+                r = regs.data() + base;
+                r[f.dst] = v;
+                frames.pop_back();
+                break;
+            }
+        }
+    }
+}
+
+EvalResult evaluateScript(const std::string& source, const EvalBudget& budget, const SymbolTable* symbols,
+                          std::string* error) {
+    EvalResult result;
+    BudgetGuard guard(budget, result);
+    guard.beginStage("compile", source.size());
+    Script script;
+    if (!compileScript(source, script, symbols, error)) {
+        result.status = EVAL_ERROR;
+        result.value = NAN;
+        return result;
+    }
+    guard.beginStage("run", 0);
+    double v = runScript(script, &guard);
+    result.value = v;
+    if (guard.check() && std::isnan(v)) result.status = EVAL_ERROR;
+    result.seconds = guard.elapsed();
+    return result;
+}
+
+}
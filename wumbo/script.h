@@ -0,0 +1,76 @@
+#pragma once
+
+// Scripts: statements, loops and functions over real numbers, for what one
+// expression cannot say.
+//
+//   def f(n) { if n < 2 { return n } return f(n - 1) + f(n - 2) }
+//   s = 0
+//   for k = 1, 1000 { s = s + 1/k^2 }
+//   while s > 1 { s = s / 2 }
+//
+// Statements are separated by new lines or ";". for runs its variable from
+// the first bound to the second inclusive, by a step of 1 or the third
+// expression. Comparisons, and, or and not give 1 or 0; a condition holds
+// when it is neither zero nor NaN. Variables belong to the function that
+// assigns them: functions see their parameters, their own variables and
+// named values, and are defined at the top level only. A script's value,
+// like a function's, is the one it returns, or else that of the last
+// expression or assignment it ran; a script with none of these outside its
+// functions does not compile.
+// Everything is real, so "i" and "x" are ordinary names here; functions
+// without a double form (such as fft and exact) cannot be called.
+//
+// A script compiles to register code: every variable and temporary is an
+// unboxed double in a slot of its function's frame, constants and named
+// values are loaded once per call, and arithmetic on parts of an expression
+// that no assignment in a loop can change is moved out in front of it.
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "engine.h"
+
+namespace wumbo {
+
+// One instruction; script.c++ lists what each op does with a, b and c.
+struct ScriptOp {
+    char op;
+    char cmp = 0;
+    int32_t a = 0, b = 0, c = 0;
+};
+
+struct ScriptFunction {
+    int params = 0;
+    int registers = 0;
+    std::vector<ScriptOp> code;
+};
+
+// functions[0] is the top level. Like a Program, a Script refers to the
+// functions and values of the table it was compiled against.
+struct Script {
+    std::vector<ScriptFunction> functions;
+    std::vector<double> constants;
+    std::vector<const Function*> calls;
+    std::vector<const Binding*> values;
+};
+
+// True if text uses anything only a script can: statement separators,
+// braces, assignment or comparison.
+bool isScript(const std::string& text);
+
+// Returns false and describes the first problem, with its line, in error if
+// source is not a valid script.
+bool compileScript(const std::string& source, Script& out, const SymbolTable* symbols = nullptr,
+                   std::string* error = nullptr);
+// NaN for a script that fails, including one recursing deeper than
+// maxScriptDepth calls or stopped by guard, which is ticked once per loop
+// iteration and call.
+double runScript(const Script& script, BudgetGuard* guard = nullptr);
+
+constexpr size_t maxScriptDepth = 1 << 14;
+
+EvalResult evaluateScript(const std::string& source, const EvalBudget& budget, const SymbolTable* symbols = nullptr,
+                          std::string* error = nullptr);
+
+}
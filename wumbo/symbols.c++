@@ -0,0 +1,516 @@
+#include "symbols.h"
+#include "plugin.h"
+#include "fft.h"
+#include "numtheory.h"
+#include "bigint.h"
+#include "engine.h"
+
+#include <dlfcn.h>
+#include <cctype>
+#include <cmath>
+#include <algorithm>
+#include <filesystem>
+
+namespace wumbo {
+
+namespace fs = std::filesystem;
+
+double Function::call(const double* a) const {
+    switch (scalar ? arity : -1) {
+        case 0: return ((double (*)())scalar)();
+        case 1: return ((double (*)(double))scalar)(a[0]);
+        case 2: return ((double (*)(double, double))scalar)(a[0], a[1]);
+        case 3: return ((double (*)(double, double, double))scalar)(a[0], a[1], a[2]);
+        case 4: return ((double (*)(double, double, double, double))scalar)(a[0], a[1], a[2], a[3]);
+    }
+    return NAN;
+}
+
+void Function::callBatch(const double* const* a, double* out, size_t n) const {
+    typedef const double* col;
+    switch (batch ? arity : -1) {
+        case 0: ((void (*)(double*, size_t))batch)(out, n); return;
+        case 1: ((void (*)(col, double*, size_t))batch)(a[0], out, n); return;
+        case 2: ((void (*)(col, col, double*, size_t))batch)(a[0], a[1], out, n); return;
+        case 3: ((void (*)(col, col, col, double*, size_t))batch)(a[0], a[1], a[2], out, n); return;
+        case 4: ((void (*)(col, col, col, col, double*, size_t))batch)(a[0], a[1], a[2], a[3], out, n); return;
+    }
+    double args[maxArity];
+    for (size_t i = 0; i < n; ++i) {
+        for (int j = 0; j < arity; ++j) args[j] = a[j][i];
+        out[i] = call(args);
+    }
+}
+
+Value Function::callValues(const Value* args, BudgetGuard* guard) const {
+    if (generic) return generic(args, guard);
+    double a[maxArity] = {};
+    bool complex = false;
+    for (int j = 0; j < arity; ++j) {
+        a[j] = args[j].toDouble();
+        complex |= args[j].isComplex();
+    }
+    double r = call(a);
+    return complex ? Value(std::complex<double>(r, 0)) : Value(r);
+}
+
+namespace {
+
+template <double (*F)(double)>
+void mapN(const double* a, double* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) out[i] = F(a[i]);
+}
+
+// Real arguments go through the real function, so sqrt(-1) stays NaN in real
+// expressions; complex ones (anything in an expression using i) take the
+// principal complex branch, and exact ones the exact function, if there is
+// one. Lists are mapped element by element.
+template <double (*F)(double), std::complex<double> (*C)(std::complex<double>), ExactReal (*E)(const ExactReal&)>
+Value generic1(const Value* a, BudgetGuard*) {
+    if (a[0].isList()) {
+        std::vector<Value> out;
+        out.reserve(a[0].items().size());
+        for (auto& x : a[0].items()) out.push_back(generic1<F, C, E>(&x, nullptr));
+        return out;
+    }
+    if (a[0].isExact() && E) return Value(E(a[0].exact()));
+    if (a[0].isReal() || a[0].isInteger() || a[0].isExact()) return F(a[0].real());
+    return C(a[0].complex());
+}
+
+double sqrtReal(double x) { return std::sqrt(x); }
+double expReal(double x) { return std::exp(x); }
+double logReal(double x) { return x > 0 ? std::log(x) : x == 0 ? -INFINITY : NAN; }
+double absReal(double x) { return std::fabs(x); }
+double reReal(double x) { return x; }
+double imReal(double) { return 0; }
+double argReal(double x) { return x < 0 ? M_PI : 0; }
+
+std::complex<double> sqrtComplex(std::complex<double> z) { return std::sqrt(z); }
+std::complex<double> expComplex(std::complex<double> z) { return std::exp(z); }
+std::complex<double> logComplex(std::complex<double> z) { return z == 0.0 ? std::complex<double>(-INFINITY, 0) : std::log(z); }
+std::complex<double> absComplex(std::complex<double> z) { return std::abs(z); }
+std::complex<double> reComplex(std::complex<double> z) { return z.real(); }
+std::complex<double> imComplex(std::complex<double> z) { return z.imag(); }
+std::complex<double> argComplex(std::complex<double> z) { return std::arg(z); }
+std::complex<double> conjComplex(std::complex<double> z) { return std::conj(z); }
+
+ExactReal reExact(const ExactReal& x) { return x; }
+ExactReal imExact(const ExactReal&) { return ExactReal(); }
+
+template <double (*F)(double), std::complex<double> (*C)(std::complex<double>), ExactReal (*E)(const ExactReal&) = nullptr>
+Function builtin1(const char* name) {
+    return {name, 1, (void (*)(void))F, (void (*)(void))mapN<F>, generic1<F, C, E>};
+}
+
+// exact() puts its whole expression in exact mode (see exactMode()); on
+// its own it makes a real or integer exact and leaves anything else as is.
+Value exactValue(const Value* a, BudgetGuard*) {
+    if (a[0].isList()) {
+        std::vector<Value> out;
+        out.reserve(a[0].items().size());
+        for (auto& x : a[0].items()) out.push_back(exactValue(&x, nullptr));
+        return out;
+    }
+    if (a[0].isInteger() || (a[0].isReal() && std::isfinite(a[0].real()))) return Value(a[0].exact());
+    return a[0];
+}
+
+// The list functions only have a generic form. Transforms work on split
+// real/imaginary arrays; a list holding anything but numbers is an error.
+bool splitList(const Value& v, std::vector<double>& re, std::vector<double>& im, bool& complex) {
+    if (!v.isList()) return false;
+    complex = false;
+    re.resize(v.items().size());
+    im.resize(v.items().size());
+    for (size_t i = 0; i < re.size(); ++i) {
+        const Value& x = v.items()[i];
+        if (x.isList()) return false;
+        re[i] = x.real();
+        im[i] = x.imag();
+        complex |= x.isComplex();
+    }
+    return true;
+}
+
+// Ticks guard once per element of a list of n about to be built, and charges
+// it bytes per element for the list and the scratch behind it.
+bool reserveList(BudgetGuard* guard, size_t n, size_t bytes) {
+    return !guard || guard->reserve(n, n * bytes);
+}
+
+Value joinList(const std::vector<double>& re, const std::vector<double>* im) {
+    std::vector<Value> out;
+    out.reserve(re.size());
+    for (size_t i = 0; i < re.size(); ++i) {
+        if (im) out.push_back(std::complex<double>(re[i], (*im)[i]));
+        else out.push_back(re[i]);
+    }
+    return out;
+}
+
+Value fftList(const Value* a, BudgetGuard* guard) {
+    std::vector<double> re, im;
+    bool complex;
+    if (a[0].isList() && !reserveList(guard, a[0].items().size(), 4 * sizeof(double) + sizeof(Value))) return NAN;
+    if (!splitList(a[0], re, im, complex)) return NAN;
+    size_t n = re.size();
+    fft(re.data(), im.data(), n);
+    // The transform of a real list is conjugate-symmetric; making it exactly
+    // so lets ifft recognise it and return a real list again.
+    if (!complex && n) {
+        im[0] = 0;
+        for (size_t k = 1; k < n - k; ++k) {
+            re[n - k] = re[k];
+            im[n - k] = -im[k];
+        }
+        if (n % 2 == 0) im[n / 2] = 0;
+    }
+    return joinList(re, &im);
+}
+
+Value ifftList(const Value* a, BudgetGuard* guard) {
+    std::vector<double> re, im;
+    bool complex;
+    if (a[0].isList() && !reserveList(guard, a[0].items().size(), 4 * sizeof(double) + sizeof(Value))) return NAN;
+    if (!splitList(a[0], re, im, complex)) return NAN;
+    size_t n = re.size();
+    bool symmetric = n && im[0] == 0;
+    for (size_t k = 1; symmetric && k < n; ++k) symmetric = re[n - k] == re[k] && im[n - k] == -im[k];
+    ifft(re.data(), im.data(), n);
+    return joinList(re, symmetric ? nullptr : &im);
+}
+
+Value convList(const Value* a, BudgetGuard* guard) {
+    std::vector<double> ar, ai, br, bi;
+    bool ac, bc;
+    // Split operands, the result's parts and the transforms, per point of the result.
+    if (a[0].isList() && a[1].isList() &&
+        !reserveList(guard, a[0].items().size() + a[1].items().size(), 12 * sizeof(double) + sizeof(Value)))
+        return NAN;
+    if (!splitList(a[0], ar, ai, ac) || !splitList(a[1], br, bi, bc)) return NAN;
+    if (ar.empty() || br.empty()) return std::vector<Value>();
+    std::vector<double> re(ar.size() + br.size() - 1), im(re.size());
+    if (!ac && !bc) {
+        convolveReal(ar.data(), ar.size(), br.data(), br.size(), re.data());
+        return joinList(re, nullptr);
+    }
+    convolve(ar.data(), ai.data(), ar.size(), br.data(), bi.data(), br.size(), re.data(), im.data());
+    return joinList(re, &im);
+}
+
+Value lenList(const Value* a, BudgetGuard*) {
+    return a[0].isList() ? (double)a[0].items().size() : NAN;
+}
+
+Value sumList(const Value* a, BudgetGuard* guard) {
+    if (!a[0].isList()) return NAN;
+    Value sum = 0.0;
+    for (auto& x : a[0].items()) sum = applyOp(sum, x, '+', guard);
+    return sum;
+}
+
+// poly_div gives [quotient, remainder]; the polynomial functions accept
+// real numbers as constant polynomials, but not NaN, which is how a power
+// too large to expand comes back.
+bool polyArg(const Value& v) {
+    return v.isPoly() || (v.isReal() && !v.isError());
+}
+
+Value polyMulValues(const Value* a, BudgetGuard* guard) {
+    Coeffs p;
+    if (!polyArg(a[0]) || !polyArg(a[1]) || !polyMul(a[0].coeffs(), a[1].coeffs(), p, guard)) return NAN;
+    return Value::poly(std::move(p));
+}
+
+Value polyDivValues(const Value* a, BudgetGuard* guard) {
+    Coeffs q, r;
+    if (!polyArg(a[0]) || !polyArg(a[1]) || !polyDivMod(a[0].coeffs(), a[1].coeffs(), q, r, guard)) return NAN;
+    return std::vector<Value>{Value::poly(std::move(q)), Value::poly(std::move(r))};
+}
+
+Value polyGcdValues(const Value* a, BudgetGuard* guard) {
+    Coeffs g;
+    if (!polyArg(a[0]) || !polyArg(a[1]) || !polyGcd(a[0].coeffs(), a[1].coeffs(), g, guard)) return NAN;
+    return Value::poly(std::move(g));
+}
+
+// The coefficients as a list, lowest power first.
+Value coeffsList(const Value* a, BudgetGuard*) {
+    if (!polyArg(a[0])) return NAN;
+    Coeffs c = a[0].coeffs();
+    return joinList(c.empty() ? Coeffs{0} : c, nullptr);
+}
+
+// range and primes refuse to build longer lists, so a mistyped bound cannot
+// allocate without limit before any budget check sees it.
+constexpr double maxListLength = 1 << 24;
+
+// range(n) is [0, 1, ..., n-1].
+Value rangeList(const Value* a, BudgetGuard* guard) {
+    double n = a[0].toDouble();
+    if (!(n >= 0 && n <= maxListLength) || n != std::floor(n)) return NAN;
+    if (!reserveList(guard, (size_t)n, sizeof(Value))) return NAN;
+    std::vector<Value> out;
+    out.reserve((size_t)n);
+    for (size_t i = 0; i < (size_t)n; ++i) out.push_back((double)i);
+    return out;
+}
+
+// The number-theory functions work on integers up to 2^53, below which
+// every integer is an exact double.
+constexpr double maxExact = 0x1p53;
+// primepi's O(n^(3/4)) count takes about a second at this bound.
+constexpr double maxPrimePi = 1e12;
+
+double isprimeReal(double x) {
+    if (!(std::fabs(x) <= maxExact)) return NAN;
+    return x >= 2 && x == std::floor(x) && isPrime((uint64_t)x);
+}
+
+double nextprimeReal(double x) {
+    if (!(x < maxExact)) return NAN;
+    double p = x < 2 ? 2 : (double)nextPrime((uint64_t)std::floor(x));
+    return p <= maxExact ? p : NAN;
+}
+
+double primepiReal(double x) {
+    if (!(x <= maxPrimePi)) return NAN;
+    return x < 2 ? 0 : (double)primePi((uint64_t)x);
+}
+
+// Number-theory functions take numbers on the real axis, complex-mode ones
+// included, and map over lists.
+template <double (*F)(double)>
+Value genericInteger(const Value* a, BudgetGuard*) {
+    if (a[0].isList()) {
+        std::vector<Value> out;
+        out.reserve(a[0].items().size());
+        for (auto& x : a[0].items()) out.push_back(genericInteger<F>(&x, nullptr));
+        return out;
+    }
+    return F(a[0].isPoly() ? NAN : a[0].toDouble());
+}
+
+template <double (*F)(double)>
+Function builtinInteger(const char* name) {
+    return {name, 1, (void (*)(void))F, (void (*)(void))mapN<F>, genericInteger<F>};
+}
+
+Value factorList(const Value* a, BudgetGuard*) {
+    double n = a[0].isPoly() ? NAN : a[0].toDouble();
+    if (!(n >= 1 && n <= maxExact) || n != std::floor(n)) return NAN;
+    std::vector<Value> out;
+    for (uint64_t p : factorize((uint64_t)n)) out.push_back((double)p);
+    return out;
+}
+
+// primes(a, b) lists the primes in [a, b]. An interval of length y holds at
+// most 2y / log y of them (Brun-Titchmarsh); only when that exceeds
+// maxListLength are they counted exactly, so the list stays under it.
+Value primesList(const Value* a, BudgetGuard* guard) {
+    double lo = a[0].isPoly() ? NAN : std::ceil(a[0].toDouble());
+    double hi = a[1].isPoly() ? NAN : std::floor(a[1].toDouble());
+    if (!(hi <= maxExact) || std::isnan(lo)) return NAN;
+    lo = std::max(lo, 0.0);
+    if (hi < lo) return std::vector<Value>();
+    double y = hi - lo + 1;
+    double count = y < 3 ? y : 2 * y / std::log(y);
+    if (count > maxListLength && hi <= maxPrimePi)
+        count = (double)(primePi((uint64_t)hi) - primePi(lo >= 1 ? (uint64_t)lo - 1 : 0));
+    if (count > maxListLength || !reserveList(guard, (size_t)count, sizeof(uint64_t) + sizeof(Value))) return NAN;
+    std::vector<uint64_t> primes = primesBetween((uint64_t)lo, (uint64_t)hi);
+    std::vector<Value> out;
+    out.reserve(primes.size());
+    for (uint64_t p : primes) out.push_back((double)p);
+    return out;
+}
+
+// factorial(n), also written n!, and binom(n, k) are exact in the general
+// evaluator, giving an integer Value once past 2^53. The double forms used
+// by evalPostfix and the lanes round them, and overflow to infinity.
+double factorialReal(double x) {
+    if (!(x >= 0) || x != std::floor(x)) return NAN;
+    if (x > 170) return INFINITY;
+    static const std::vector<double> table = [] {
+        std::vector<double> t;
+        BigInt f;
+        for (uint64_t n = 0; n <= 170; ++n) t.push_back(factorial(n, f) ? f.toDouble() : NAN);
+        return t;
+    }();
+    return table[(size_t)x];
+}
+
+// The result's digits, 9 to a 32-bit limb, are charged before the work starts.
+Value factorialValue(const Value* a, BudgetGuard* guard) {
+    if (a[0].isList()) {
+        std::vector<Value> out;
+        out.reserve(a[0].items().size());
+        for (auto& x : a[0].items()) out.push_back(factorialValue(&x, guard));
+        return out;
+    }
+    double n = a[0].isPoly() ? NAN : a[0].toDouble();
+    if (!(n >= 0) || n != std::floor(n)) return NAN;
+    double digits = std::lgamma(n + 1) / M_LN10;
+    if (digits > maxBigDigits) return INFINITY;
+    if (guard && !guard->charge((size_t)(digits / 9 + 1) * sizeof(uint32_t))) return NAN;
+    BigInt f;
+    if (!factorial((uint64_t)n, f, guard)) return NAN;
+    return Value::integer(std::move(f));
+}
+
+// log C(n, k) for whole 0 <= k <= n.
+double logBinomial(double n, double k) {
+    return std::lgamma(n + 1) - std::lgamma(k + 1) - std::lgamma(n - k + 1);
+}
+
+double binomReal(double n, double k) {
+    if (!(n >= 0 && n <= maxExact && k >= 0) || n != std::floor(n) || k != std::floor(k)) return NAN;
+    if (k > n) return 0;
+    k = std::min(k, n - k);
+    double logC = logBinomial(n, k);
+    if (logC > 710) return INFINITY;
+    // Results below e^36 < 2^53 are built up exactly: every C(n, i - 1)
+    // (n - k + i) fits in 128 bits and divides by i.
+    if (logC < 36) {
+        unsigned __int128 r = 1;
+        for (uint64_t i = 1; i <= (uint64_t)k; ++i) r = r * (uint64_t)(n - k + i) / i;
+        return (double)r;
+    }
+    double r = 1;
+    for (double i = 1; i <= k; ++i) r = r * (n - k + i) / i;
+    return r;
+}
+
+Value binomValue(const Value* a, BudgetGuard*) {
+    double n = a[0].isPoly() ? NAN : a[0].toDouble(), k = a[1].isPoly() ? NAN : a[1].toDouble();
+    double r = binomReal(n, k);
+    if (!(r > maxExact) || logBinomial(n, std::min(k, n - k)) / M_LN10 > maxBigDigits) return r;
+    BigInt c;
+    if (!binomial((uint64_t)n, (uint64_t)k, c)) return r;
+    return Value::integer(std::move(c));
+}
+
+const Function builtins[] = {
+    builtin1<sqrtReal, sqrtComplex, exactSqrt>("sqrt"),
+    builtin1<expReal, expComplex, exactExp>("exp"),
+    builtin1<logReal, logComplex, exactLog>("log"),
+    builtin1<absReal, absComplex, exactAbs>("abs"),
+    builtin1<reReal, reComplex, reExact>("re"),
+    builtin1<imReal, imComplex, imExact>("im"),
+    builtin1<argReal, argComplex>("arg"),
+    builtin1<reReal, conjComplex, reExact>("conj"),
+    {"exact", 1, nullptr, nullptr, exactValue},
+    {"fft", 1, nullptr, nullptr, fftList},
+    {"ifft", 1, nullptr, nullptr, ifftList},
+    {"conv", 2, nullptr, nullptr, convList},
+    {"len", 1, nullptr, nullptr, lenList},
+    {"sum", 1, nullptr, nullptr, sumList},
+    {"range", 1, nullptr, nullptr, rangeList},
+    {"poly_mul", 2, nullptr, nullptr, polyMulValues},
+    {"poly_div", 2, nullptr, nullptr, polyDivValues},
+    {"poly_gcd", 2, nullptr, nullptr, polyGcdValues},
+    {"coeffs", 1, nullptr, nullptr, coeffsList},
+    builtinInteger<isprimeReal>("isprime"),
+    builtinInteger<nextprimeReal>("nextprime"),
+    builtinInteger<primepiReal>("primepi"),
+    {"factor", 1, nullptr, nullptr, factorList},
+    {"primes", 2, nullptr, nullptr, primesList},
+    {"factorial", 1, (void (*)(void))factorialReal, (void (*)(void))mapN<factorialReal>, factorialValue},
+    {"binom", 2, (void (*)(void))binomReal, nullptr, binomValue},
+};
+
+}
+
+const Function* findBuiltin(const std::string& name) {
+    for (auto& f : builtins)
+        if (f.name == name) return &f;
+    return nullptr;
+}
+
+bool reservedName(const std::string& name) {
+    return name == "i" || name == "x";
+}
+
+SymbolTable::~SymbolTable() {
+    functions.clear();
+    for (void* lib : libraries) dlclose(lib);
+}
+
+static bool validName(const std::string& name) {
+    if (name.empty() || !(isalpha((unsigned char)name[0]) || name[0] == '_')) return false;
+    for (char c : name)
+        if (!(isalnum((unsigned char)c) || c == '_')) return false;
+    return true;
+}
+
+bool SymbolTable::addFunction(const std::string& name, int arity, void (*scalar)(void), void (*batch)(void)) {
+    if (!scalar || arity < 0 || arity > maxArity || !validName(name) || reservedName(name) || findBuiltin(name) ||
+        byName.count(name) || values.count(name))
+        return false;
+    functions.push_back({name, arity, scalar, batch});
+    byName[name] = &functions.back();
+    return true;
+}
+
+const Function* SymbolTable::findFunction(const std::string& name) const {
+    if (const Function* f = findBuiltin(name)) return f;
+    auto it = byName.find(name);
+    return it == byName.end() ? nullptr : it->second;
+}
+
+bool SymbolTable::setValue(const std::string& name, Value v) {
+    if (!validName(name) || reservedName(name) || findFunction(name)) return false;
+    values[name].set(std::move(v));
+    return true;
+}
+
+const Binding* SymbolTable::findValue(const std::string& name) const {
+    auto it = values.find(name);
+    return it == values.end() ? nullptr : &it->second;
+}
+
+bool SymbolTable::loadPlugin(const std::string& path, std::string* error) {
+    void* lib = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!lib) {
+        if (error) *error = dlerror();
+        return false;
+    }
+    auto init = (wumbo_plugin_init_fn)dlsym(lib, "wumbo_plugin_init");
+    if (!init) {
+        if (error) *error = path + ": no wumbo_plugin_init";
+        dlclose(lib);
+        return false;
+    }
+    wumbo_plugin_api api;
+    api.abi_version = WUMBO_PLUGIN_ABI_VERSION;
+    api.context = this;
+    api.register_function = [](void* context, const char* name, int arity, wumbo_fn scalar, wumbo_fn batch) {
+        return ((SymbolTable*)context)->addFunction(name ? name : "", arity, scalar, batch) ? 0 : 1;
+    };
+    // Functions registered before a failing init stay, so the library must too.
+    libraries.push_back(lib);
+    if (init(&api) != 0) {
+        if (error) *error = path + ": wumbo_plugin_init failed";
+        return false;
+    }
+    return true;
+}
+
+size_t SymbolTable::loadPlugins(const std::string& dir, std::vector<std::string>* errors) {
+    std::error_code ec;
+    std::vector<fs::path> paths;
+    for (auto& entry : fs::directory_iterator(dir, ec))
+        if (entry.is_regular_file() && entry.path().extension() == ".so") paths.push_back(entry.path());
+    // Directory order is arbitrary; sorting makes name clashes resolve the same way every run.
+    std::sort(paths.begin(), paths.end());
+    size_t loaded = 0;
+    for (auto& path : paths) {
+        std::string error;
+        if (loadPlugin(path.string(), &error)) loaded++;
+        else if (errors) errors->push_back(error);
+    }
+    return loaded;
+}
+
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+// The identifiers an expression may use: named functions, including those
+// loaded from plugin libraries (see plugin.h), and named values.
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <cstddef>
+
+#include "plugin.h"
+#include "value.h"
+
+namespace wumbo {
+
+constexpr int maxArity = WUMBO_MAX_ARITY;
+
+class BudgetGuard;
+
+// A function callable from expressions. scalar takes arity doubles and
+// returns a double; batch, if set, evaluates n calls at once from arity
+// argument arrays into out. Built-in functions also have generic, which takes
+// any Value, and those on lists have nothing else; plugin functions only
+// accept arguments on the real axis. Those whose work grows with their
+// arguments tick and charge guard, if given, before building their result.
+struct Function {
+    std::string name;
+    int arity = 0;
+    void (*scalar)(void) = nullptr;
+    void (*batch)(void) = nullptr;
+    Value (*generic)(const Value* args, BudgetGuard* guard) = nullptr;
+
+    double call(const double* args) const;
+    void callBatch(const double* const* args, double* out, size_t n) const;
+    Value callValues(const Value* args, BudgetGuard* guard = nullptr) const;
+};
+
+// The built-in functions (sqrt, exp, log, abs, re, im, arg, conj, exact; on
+// lists fft, ifft, conv, len, sum, range; on polynomials poly_mul, poly_div,
+// poly_gcd, coeffs; on integers isprime, nextprime, primepi, factor, primes,
+// factorial, binom), available with or without a SymbolTable; null if name
+// is not one of them.
+const Function* findBuiltin(const std::string& name);
+
+// Identifiers that are neither built-ins nor registrable: "i", the imaginary
+// unit, and "x", the polynomial variable.
+bool reservedName(const std::string& name);
+
+// A named value. Rebinding it is safe while other threads evaluate
+// expressions that read it; each read takes a reference to the value bound
+// at that moment.
+class Binding {
+public:
+    Value get() const { return *std::atomic_load(&value); }
+    void set(Value v) { std::atomic_store(&value, std::make_shared<const Value>(std::move(v))); }
+
+private:
+    std::shared_ptr<const Value> value = std::make_shared<const Value>();
+};
+
+// Identifiers are bound when an expression is compiled, so a table must
+// outlive every program compiled against it. Functions keep their addresses
+// for the table's lifetime, and a table that is no longer being added to may
+// be shared between threads.
+class SymbolTable {
+public:
+    SymbolTable() = default;
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+    ~SymbolTable();
+
+    // Returns false if the name is taken, reserved or a built-in, or arity is
+    // out of range. Lookups see built-ins first.
+    bool addFunction(const std::string& name, int arity, void (*scalar)(void), void (*batch)(void) = nullptr);
+    const Function* findFunction(const std::string& name) const;
+
+    // Binds name to v, the name becoming a value whose type and precision
+    // expressions get exactly as given; false if it is a function, reserved
+    // or not an identifier. A new name is an addition to the table, but
+    // rebinding one is safe while the table is shared.
+    bool setValue(const std::string& name, Value v);
+    const Binding* findValue(const std::string& name) const;
+
+    // Loads one plugin library, describing any failure in error.
+    bool loadPlugin(const std::string& path, std::string* error = nullptr);
+    // Loads every shared library in dir and returns how many loaded.
+    size_t loadPlugins(const std::string& dir, std::vector<std::string>* errors = nullptr);
+
+private:
+    std::deque<Function> functions;
+    std::unordered_map<std::string, const Function*> byName;
+    std::unordered_map<std::string, Binding> values;
+    std::vector<void*> libraries;
+};
+
+}
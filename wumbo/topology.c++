@@ -0,0 +1,122 @@
+#include "topology.h"
+
+#include <set>
+#include <cerrno>
+#include <cctype>
+#include <map>
+#include <string>
+#include <fstream>
+#include <utility>
+#include <thread>
+
+#ifdef __linux__
+#include <sched.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+namespace wumbo {
+
+namespace {
+
+#ifdef __linux__
+// The first integer in a /sys file, or fallback.
+int readInt(const std::string& path, int fallback) {
+    std::ifstream in(path);
+    int v;
+    return in >> v ? v : fallback;
+}
+
+// The node a CPU belongs to, from the nodeN link in its /sys directory.
+int cpuNode(const std::string& dir) {
+    int node = 0;
+    if (DIR* d = opendir(dir.c_str())) {
+        while (dirent* e = readdir(d)) {
+            std::string name = e->d_name;
+            if (name.size() > 4 && name.compare(0, 4, "node") == 0 && isdigit((unsigned char)name[4])) {
+                node = std::stoi(name.substr(4));
+                break;
+            }
+        }
+        closedir(d);
+    }
+    return node;
+}
+#endif
+
+}
+
+std::vector<Cpu> usableCpus() {
+    std::vector<Cpu> cpus;
+#ifdef __linux__
+    cpu_set_t mask;
+    if (sched_getaffinity(0, sizeof mask, &mask) == 0) {
+        // Cores are told apart by package and core id.
+        std::set<std::pair<int, int>> cores;
+        for (int id = 0; id < CPU_SETSIZE; id++) {
+            if (!CPU_ISSET(id, &mask)) continue;
+            std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(id);
+            Cpu cpu;
+            cpu.id = id;
+            cpu.node = cpuNode(dir);
+            int package = readInt(dir + "/topology/physical_package_id", 0);
+            int core = readInt(dir + "/topology/core_id", id);
+            cpu.sibling = !cores.insert({package, core}).second;
+            cpus.push_back(cpu);
+        }
+    }
+#endif
+    if (cpus.empty()) {
+        unsigned n = std::thread::hardware_concurrency();
+        for (unsigned id = 0; id < (n ? n : 1); id++) cpus.push_back({(int)id, 0, false});
+    }
+    return cpus;
+}
+
+std::vector<int> workerCpus(bool physicalOnly) {
+    // Whole cores, then siblings, each by node.
+    std::map<int, std::vector<int>> tiers[2];
+    for (const Cpu& cpu : usableCpus())
+        if (!cpu.sibling || !physicalOnly) tiers[cpu.sibling][cpu.node].push_back(cpu.id);
+    std::vector<int> order;
+    for (auto& tier : tiers) {
+        for (size_t i = 0;; i++) {
+            size_t before = order.size();
+            for (auto& entry : tier)
+                if (i < entry.second.size()) order.push_back(entry.second[i]);
+            if (order.size() == before) break;
+        }
+    }
+    return order;
+}
+
+bool pinThread(int cpu) {
+#ifdef __linux__
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+    return pthread_setaffinity_np(pthread_self(), sizeof mask, &mask) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+bool lowerThreadPriority() {
+#ifdef __linux__
+    // On Linux a nice value belongs to the thread, named by its id.
+    id_t tid = (id_t)syscall(SYS_gettid);
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, tid);
+    if (errno) return false;
+    return nice >= 10 || setpriority(PRIO_PROCESS, tid, 10) == 0;
+#else
+    return false;
+#endif
+}
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+// Which processors the calculator may use and how they are laid out, for
+// placing long-lived worker threads. On Linux this comes from the affinity
+// mask and /sys; elsewhere every CPU is taken as its own core on one node
+// and threads can be neither pinned nor deprioritized.
+
+#include <vector>
+
+namespace wumbo {
+
+// A logical CPU. It is a sibling if an earlier CPU shares its physical core
+// (a second hardware thread under SMT).
+struct Cpu {
+    int id = 0, node = 0;
+    bool sibling = false;
+};
+
+// The CPUs this process may run on, in id order.
+std::vector<Cpu> usableCpus();
+
+// CPUs to pin worker threads to, worker i taking the i-th. NUMA nodes take
+// turns so that workers spread evenly over them, and within a node whole
+// cores come before SMT siblings, which physicalOnly leaves out.
+std::vector<int> workerCpus(bool physicalOnly);
+
+// Pins the calling thread to cpu. Memory it touches first is then placed
+// on that CPU's node by the kernel's default policy.
+bool pinThread(int cpu);
+
+// Gives the calling thread a lower scheduling priority, so that the kernel
+// preempts it whenever a normal thread is ready to run.
+bool lowerThreadPriority();
+
+}
@@ -0,0 +1,335 @@
+#include "value.h"
+
+#include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+namespace wumbo {
+
+static_assert(sizeof(Value) == 16, "Value should stay two words");
+
+std::complex<double> complexPow(std::complex<double> a, std::complex<double> b) {
+    if (b == 0.0) return 1.0;
+    if (a == 0.0) return b.real() > 0 ? std::complex<double>(0.0) : std::complex<double>(NAN, NAN);
+    // Small integer powers by repeated multiplication, so i^2 is exactly -1
+    // rather than what exp(2 log i) rounds to.
+    if (b.imag() == 0 && b.real() == std::floor(b.real()) && std::fabs(b.real()) <= 64) {
+        int n = (int)std::fabs(b.real());
+        double rr = 1, ri = 0, xr = a.real(), xi = a.imag();
+        for (; n; n >>= 1) {
+            if (n & 1) complexMul(rr, ri, xr, xi, rr, ri);
+            complexMul(xr, xi, xr, xi, xr, xi);
+        }
+        if (b.real() < 0) complexDiv(1, 0, rr, ri, rr, ri);
+        return {rr, ri};
+    }
+    return std::pow(a, b);
+}
+
+static std::complex<double> complexOp(std::complex<double> a, std::complex<double> b, char op) {
+    double re, im;
+    switch (op) {
+        case '+': return a + b;
+        case '-': return a - b;
+        case '*': complexMul(a.real(), a.imag(), b.real(), b.imag(), re, im); return {re, im};
+        case '/': complexDiv(a.real(), a.imag(), b.real(), b.imag(), re, im); return {re, im};
+        case '^': return complexPow(a, b);
+        default: return {NAN, NAN};
+    }
+}
+
+struct Value::Heap {
+    std::atomic<uint32_t> refs{1};
+};
+
+struct Value::ListHeap : Heap {
+    explicit ListHeap(std::vector<Value> items) : items(std::move(items)) {}
+    std::vector<Value> items;
+};
+
+struct Value::PolyHeap : Heap {
+    explicit PolyHeap(Coeffs coeffs) : coeffs(std::move(coeffs)) {}
+    Coeffs coeffs;
+};
+
+struct Value::IntegerHeap : Heap {
+    explicit IntegerHeap(BigInt n) : nearest(n.toDouble()), n(std::move(n)) {}
+    double nearest;
+    BigInt n;
+};
+
+struct Value::ExactHeap : Heap {
+    explicit ExactHeap(ExactReal x) : x(std::move(x)) {}
+    ExactReal x;
+    std::once_flag approximated;
+    double nearest = NAN;
+};
+
+void Value::retain() const {
+    heap()->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Value::release() {
+    if (heap()->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    if (isList()) delete static_cast<ListHeap*>(heap());
+    else if (isPoly()) delete static_cast<PolyHeap*>(heap());
+    else if (isExact()) delete static_cast<ExactHeap*>(heap());
+    else delete static_cast<IntegerHeap*>(heap());
+}
+
+Value::Value(std::vector<Value> items)
+    : word_(reinterpret_cast<uint64_t>(new ListHeap(std::move(items)))), tag_(boxed(listTag)) {}
+
+Value Value::poly(Coeffs coeffs) {
+    trimPoly(coeffs);
+    if (coeffs.size() <= 1) return coeffs.empty() ? 0.0 : coeffs[0];
+    Value v;
+    v.word_ = reinterpret_cast<uint64_t>(new PolyHeap(std::move(coeffs)));
+    v.tag_ = boxed(polyTag);
+    return v;
+}
+
+Value Value::integer(__int128 n) {
+    unsigned __int128 mag = n < 0 ? -(unsigned __int128)n : (unsigned __int128)n;
+    if (mag <= (uint64_t)1 << 53) return (double)n;
+    if (mag >> 111) return integer(BigInt(mag, n < 0));
+    Value v;
+    v.word_ = (uint64_t)mag;
+    v.tag_ = boxed(smallIntegerTag) | (uint64_t)(n < 0) << 47 | (uint64_t)(mag >> 64);
+    return v;
+}
+
+Value Value::integer(BigInt n) {
+    unsigned __int128 mag;
+    if (n.smallMagnitude(mag) && !(mag >> 111)) return integer(n.negative() ? -(__int128)mag : (__int128)mag);
+    Value v;
+    v.word_ = reinterpret_cast<uint64_t>(new IntegerHeap(std::move(n)));
+    v.tag_ = boxed(bigIntegerTag);
+    return v;
+}
+
+Value::Value(ExactReal x)
+    : word_(reinterpret_cast<uint64_t>(new ExactHeap(std::move(x)))), tag_(boxed(exactTag)) {}
+
+Value::Kind Value::kind() const {
+    if (!isBoxed()) return COMPLEX;
+    switch (tag_ >> payloadBits & 7) {
+        case realTag: return REAL;
+        case listTag: return LIST;
+        case polyTag: return POLY;
+        case exactTag: return EXACT;
+        default: return INTEGER;
+    }
+}
+
+double Value::real() const {
+    if (isReal() || isComplex()) return number(word_);
+    if (tag_ == boxed(bigIntegerTag)) return static_cast<IntegerHeap*>(heap())->nearest;
+    if (isExact()) {
+        ExactHeap* h = static_cast<ExactHeap*>(heap());
+        std::call_once(h->approximated, [h] { h->nearest = h->x.toDouble(); });
+        return h->nearest;
+    }
+    __int128 n;
+    return smallInteger(n) ? (double)n : NAN;
+}
+
+double Value::imag() const {
+    if (isComplex()) return number(tag_);
+    return isList() || isPoly() ? NAN : 0;
+}
+
+const std::vector<Value>& Value::items() const {
+    static const std::vector<Value> none;
+    return isList() ? static_cast<ListHeap*>(heap())->items : none;
+}
+
+Coeffs Value::coeffs() const {
+    if (isPoly()) return static_cast<PolyHeap*>(heap())->coeffs;
+    if ((isReal() || isExact()) && real() != 0) return {real()};
+    return {};
+}
+
+bool Value::smallInteger(__int128& n) const {
+    if ((tag_ & tagMask) == boxed(smallIntegerTag)) {
+        uint64_t payload = tag_ & ~tagMask;
+        unsigned __int128 mag = (unsigned __int128)(payload & (((uint64_t)1 << 47) - 1)) << 64 | word_;
+        n = payload >> 47 ? -(__int128)mag : (__int128)mag;
+        return true;
+    }
+    double x = number(word_);
+    if (!isReal() || !(std::fabs(x) < 0x1p111) || x != std::floor(x)) return false;
+    n = (__int128)x;
+    return true;
+}
+
+ExactReal Value::exact() const {
+    if (isExact()) return static_cast<ExactHeap*>(heap())->x;
+    if (isInteger()) return ExactReal(bigInt());
+    return std::isfinite(real()) ? ExactReal::fromDouble(real()) : ExactReal();
+}
+
+BigInt Value::bigInt() const {
+    if (tag_ == boxed(bigIntegerTag)) return static_cast<IntegerHeap*>(heap())->n;
+    __int128 n;
+    if (smallInteger(n)) return BigInt(n < 0 ? -(unsigned __int128)n : (unsigned __int128)n, n < 0);
+    return BigInt::fromDouble(real());
+}
+
+size_t Value::heapBytes() const {
+    if (isList()) return items().size() * sizeof(Value);
+    if (isPoly()) return static_cast<PolyHeap*>(heap())->coeffs.size() * sizeof(double);
+    if (tag_ == boxed(bigIntegerTag)) return static_cast<IntegerHeap*>(heap())->n.bytes();
+    return 0;
+}
+
+// Exact reals take part as their nearest doubles.
+static Value polyOp(const Value& a, const Value& b, char op, BudgetGuard* guard) {
+    if (!(a.isPoly() || a.isReal() || a.isExact()) || !(b.isPoly() || b.isReal() || b.isExact())) return NAN;
+    Coeffs x = a.coeffs(), y = b.coeffs(), q, r;
+    switch (op) {
+        case '+':
+        case '-':
+            x.resize(std::max(x.size(), y.size()), 0.0);
+            for (size_t i = 0; i < y.size(); ++i) x[i] += op == '+' ? y[i] : -y[i];
+            return Value::poly(std::move(x));
+        case '*':
+            if (!polyMul(x, y, q, guard)) return NAN;
+            return Value::poly(std::move(q));
+        case '/':
+            if (!polyDivMod(x, y, q, r, guard) || !r.empty()) return NAN;
+            return Value::poly(std::move(q));
+        case '^': {
+            double n = b.isReal() || b.isExact() ? b.real() : NAN;
+            if (!(n >= 0) || n != std::floor(n) || !polyPow(x, (unsigned long)n, q, guard)) return NAN;
+            return Value::poly(std::move(q));
+        }
+        default: return NAN;
+    }
+}
+
+static bool wholeNumber(const Value& v) {
+    return v.isInteger() || (v.isReal() && std::isfinite(v.real()) && v.real() == std::floor(v.real()));
+}
+
+// Decimal digits before the point, roughly.
+static double magnitudeDigits(const Value& v) {
+    double x = std::fabs(v.real());
+    if (std::isinf(x)) return v.bigInt().digits();
+    return x == 0 ? 1 : std::log10(x) + 1;
+}
+
+static Value integerOp(const Value& a, const Value& b, char op) {
+    // Below 2^111 sums and differences cannot overflow 128 bits, and
+    // products are checked, so small integers stay off the heap.
+    __int128 x, y, r;
+    if (a.smallInteger(x) && b.smallInteger(y)) {
+        if (op == '+') return Value::integer(x + y);
+        if (op == '-') return Value::integer(x - y);
+        if (op == '*' && !__builtin_mul_overflow(x, y, &r)) return Value::integer(r);
+    }
+    if (wholeNumber(a) && wholeNumber(b)) {
+        switch (op) {
+            case '+': return Value::integer(a.bigInt() + b.bigInt());
+            case '-': return Value::integer(a.bigInt() - b.bigInt());
+            case '*':
+                if (magnitudeDigits(a) + magnitudeDigits(b) <= maxBigDigits) return Value::integer(a.bigInt() * b.bigInt());
+                break;
+            case '^':
+                if (b.isReal() && b.real() >= 0 && magnitudeDigits(a) * b.real() <= maxBigDigits)
+                    return Value::integer(bigIntPow(a.bigInt(), (uint64_t)b.real()));
+                break;
+        }
+    }
+    return applyOp(Value(a.real()), Value(b.real()), op);
+}
+
+// Whole powers up to this are built by repeated squaring; others, and
+// powers of exact reals, go through exp and log.
+constexpr long maxExactPower = 1 << 20;
+
+static Value exactOp(const Value& a, const Value& b, char op) {
+    if ((a.isReal() && !std::isfinite(a.real())) || (b.isReal() && !std::isfinite(b.real())))
+        return applyOp(Value(a.real()), Value(b.real()), op);
+    ExactReal x = a.exact(), y = b.exact();
+    long n;
+    switch (op) {
+        case '+': return Value(x + y);
+        case '-': return Value(x - y);
+        case '*': return Value(x * y);
+        case '/': return y.isZero() ? Value(NAN) : Value(x / y);
+        case '^':
+            if (x.isZero()) return pow(0.0, b.real());
+            if (y.wholeConstant(n) && n >= -maxExactPower && n <= maxExactPower) return Value(exactPow(x, n));
+            return Value(exactExp(y * exactLog(x)));
+        default: return NAN;
+    }
+}
+
+Value applyOp(const Value& a, const Value& b, char op, BudgetGuard* guard) {
+    if (a.isList() || b.isList()) {
+        if (a.isList() && b.isList() && a.items().size() != b.items().size()) return NAN;
+        size_t n = a.isList() ? a.items().size() : b.items().size();
+        std::vector<Value> out;
+        out.reserve(n);
+        for (size_t i = 0; i < n; ++i)
+            out.push_back(applyOp(a.isList() ? a.items()[i] : a, b.isList() ? b.items()[i] : b, op, guard));
+        return out;
+    }
+    if (a.isPoly() || b.isPoly()) return polyOp(a, b, op, guard);
+    if (a.isComplex() || b.isComplex()) return complexOp(a.complex(), b.complex(), op);
+    if (a.isExact() || b.isExact()) return exactOp(a, b, op);
+    if (a.isInteger() || b.isInteger()) return integerOp(a, b, op);
+    double x = a.real(), y = b.real();
+    switch (op) {
+        case '+': return x + y;
+        case '-': return x - y;
+        case '*': return x * y;
+        case '/': return y != 0 ? x / y : NAN;
+        case '^': return pow(x, y);
+        default: return NAN;
+    }
+}
+
+std::string formatValue(const Value& v, int precision) {
+    if (v.isList()) {
+        std::string s = "[";
+        for (size_t i = 0; i < v.items().size(); ++i) {
+            if (i) s += ", ";
+            s += formatValue(v.items()[i], precision);
+        }
+        return s + "]";
+    }
+    if (v.isPoly()) {
+        // Highest power first, in a form the parser reads back.
+        Coeffs c = v.coeffs();
+        std::string s;
+        for (size_t k = c.size(); k-- > 0;) {
+            if (c[k] == 0) continue;
+            double mag = std::fabs(c[k]);
+            if (!s.empty() || c[k] < 0) s += c[k] < 0 ? "-" : "+";
+            if (mag != 1 || k == 0) {
+                s += formatValue(mag, precision);
+                if (k) s += "*";
+            }
+            if (k) s += "x";
+            if (k > 1) s += "^" + std::to_string(k);
+        }
+        return s;
+    }
+    if (v.isInteger()) return v.bigInt().toString();
+    std::string digits;
+    if (v.isExact()) return v.exact().format(precision, digits) ? digits : "nan";
+    char buf[128];
+    if (v.isReal() || v.imag() == 0) {
+        snprintf(buf, sizeof(buf), "%.*g", precision, v.real());
+    } else if (v.real() == 0) {
+        snprintf(buf, sizeof(buf), "%.*gi", precision, v.imag());
+    } else {
+        snprintf(buf, sizeof(buf), "%.*g%+.*gi", precision, v.real(), precision, v.imag());
+    }
+    return buf;
+}
+
+}
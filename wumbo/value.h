@@ -0,0 +1,171 @@
+#pragma once
+
+// The values the general evaluator computes with. Plain real expressions
+// never need more than a double and go through the double-only paths
+// (evalPostfix, the lane interpreter); a Value carries everything else.
+
+#include <complex>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "poly.h"
+#include "bigint.h"
+#include "exact.h"
+
+namespace wumbo {
+
+// Sixteen bytes, so the evaluator's stack stays dense, and nothing on the
+// heap for numbers below 2^111. A complex number is its two parts as they
+// are. Every other kind puts a tag in the second word, a signalling NaN no
+// arithmetic produces (it only makes quiet ones), and its payload in the
+// first: a real's double, the low 64 bits of a small integer's magnitude
+// (the tag holding its sign and the high 47 bits), or a pointer to a
+// reference-counted block for lists, polynomials, larger integers and
+// exact reals.
+class Value {
+public:
+    enum Kind : uint8_t { REAL, COMPLEX, LIST, POLY, INTEGER, EXACT };
+
+    Value(double x = NAN) : word_(bits(x)), tag_(boxed(realTag)) {}
+    Value(std::complex<double> z)
+        : word_(bits(z.real())), tag_(bits(std::isnan(z.imag()) ? NAN : z.imag())) {}
+    // Lists are immutable and share their elements between copies. As a
+    // number a list is NaN, so code that does not expect one fails cleanly.
+    Value(std::vector<Value> items);
+    // A polynomial in x, shared like a list. One of degree zero or less is
+    // just its constant term.
+    static Value poly(Coeffs coeffs);
+    // An exact integer. As a number it is its nearest double, so real() and
+    // toDouble() approximate it; one small enough to be an exact double is
+    // just that double.
+    static Value integer(BigInt n);
+    static Value integer(__int128 n);
+    // An exact real, which as a number is its nearest double, worked out
+    // when first asked for.
+    explicit Value(ExactReal x);
+
+    Value(const Value& o) : word_(o.word_), tag_(o.tag_) {
+        if (onHeap()) retain();
+    }
+    Value(Value&& o) noexcept : word_(o.word_), tag_(o.tag_) {
+        o.tag_ = boxed(realTag);
+    }
+    Value& operator=(Value o) noexcept {
+        std::swap(word_, o.word_);
+        std::swap(tag_, o.tag_);
+        return *this;
+    }
+    ~Value() {
+        if (onHeap()) release();
+    }
+
+    Kind kind() const;
+    bool isReal() const { return tag_ == boxed(realTag); }
+    bool isComplex() const { return !isBoxed(); }
+    bool isList() const { return tag_ == boxed(listTag); }
+    bool isPoly() const { return tag_ == boxed(polyTag); }
+    bool isInteger() const { return (tag_ & tagMask) == boxed(smallIntegerTag) || tag_ == boxed(bigIntegerTag); }
+    bool isExact() const { return tag_ == boxed(exactTag); }
+    // NaN in either part marks a failed computation, as does an exact real
+    // that cannot be approximated; lists, polynomials and integers are never
+    // errors themselves, though what a list holds may be.
+    bool isError() const {
+        return (isReal() || isComplex() || isExact()) && (std::isnan(real()) || std::isnan(imag()));
+    }
+
+    double real() const;
+    double imag() const;
+    std::complex<double> complex() const { return {real(), imag()}; }
+    // The value as a plain double: NaN unless it lies on the real axis.
+    double toDouble() const { return imag() == 0 ? real() : NAN; }
+    // The elements of a list; empty for anything else.
+    const std::vector<Value>& items() const;
+    // The coefficients of a polynomial, lowest power first; a real number
+    // is a constant polynomial, and anything else has none.
+    Coeffs coeffs() const;
+    // The exact value of an integer, or of a real that is a whole number.
+    BigInt bigInt() const;
+    // Sets n to an integer, or a whole real, below 2^111 in magnitude.
+    bool smallInteger(__int128& n) const;
+    // An exact real as it is, and a real (through its shortest decimal) or
+    // an integer converted exactly; only meaningful for those kinds.
+    ExactReal exact() const;
+    // Memory held beyond the Value itself by a list, polynomial or integer.
+    size_t heapBytes() const;
+
+private:
+    struct Heap;
+    struct ListHeap;
+    struct PolyHeap;
+    struct IntegerHeap;
+    struct ExactHeap;
+    enum Tag : uint64_t { realTag = 1, listTag, polyTag, smallIntegerTag, bigIntegerTag, exactTag };
+    // The tag's top 16 bits are the sign, exponent and clear quiet bit of a
+    // negative signalling NaN, then a nonzero three-bit Tag; the low 48 are
+    // payload.
+    static constexpr uint64_t nanBits = 0xFFF0000000000000, tagMask = 0xFFFF000000000000;
+    static constexpr int payloadBits = 48;
+
+    static uint64_t bits(double x) {
+        uint64_t b;
+        std::memcpy(&b, &x, sizeof b);
+        return b;
+    }
+    static double number(uint64_t b) {
+        double x;
+        std::memcpy(&x, &b, sizeof x);
+        return x;
+    }
+    static constexpr uint64_t boxed(Tag t) { return nanBits | (uint64_t)t << payloadBits; }
+    bool isBoxed() const {
+        uint64_t top = tag_ >> payloadBits;
+        return top > nanBits >> payloadBits && top < (nanBits >> payloadBits) + 8;
+    }
+    bool onHeap() const {
+        return tag_ == boxed(listTag) || tag_ == boxed(polyTag) || tag_ == boxed(bigIntegerTag) || tag_ == boxed(exactTag);
+    }
+    Heap* heap() const { return reinterpret_cast<Heap*>(word_); }
+    void retain() const;
+    void release();
+
+    uint64_t word_, tag_;
+};
+
+// Complex product and quotient spelled out on parts, so the scalar evaluator
+// and the SoA lane kernels round identically. A zero divisor gives NaN.
+inline void complexMul(double ar, double ai, double br, double bi, double& re, double& im) {
+    re = ar * br - ai * bi;
+    im = ar * bi + ai * br;
+}
+
+inline void complexDiv(double ar, double ai, double br, double bi, double& re, double& im) {
+    double d = br * br + bi * bi;
+    re = d != 0 ? (ar * br + ai * bi) / d : NAN;
+    im = d != 0 ? (ai * br - ar * bi) / d : NAN;
+}
+
+// Principal value of a^b, with 0^b defined only for Re b > 0.
+std::complex<double> complexPow(std::complex<double> a, std::complex<double> b);
+
+// Arithmetic on two values. Mixing a real and a complex operand computes in
+// complex; division by zero is an error in both. Lists combine elementwise,
+// with a number applied to every element and lists of different lengths an
+// error. Polynomials take real numbers and each other; dividing two is an
+// error unless it leaves no remainder, and powers must be whole numbers.
+// Integers add, subtract and multiply exactly with each other and with
+// whole reals, and raise to whole powers; anything else, division included,
+// computes with their nearest doubles. An exact real makes the result exact
+// for any operation with reals and integers, a power through exp and log
+// unless the exponent is a whole number. Polynomial products and powers are
+// stopped by guard, if given, as in poly.h.
+Value applyOp(const Value& a, const Value& b, char op, BudgetGuard* guard = nullptr);
+
+// precision significant digits, %g style; complex values as "a+bi", lists as
+// "[a, b, c]" and polynomials as "x^2+2*x+1". Integers print every digit,
+// and exact reals as many as precision asks for, computed then.
+std::string formatValue(const Value& v, int precision = 6);
+
+}
@@ -0,0 +1,178 @@
+#include "wumbo.h"
+#include "engine.h"
+#include "batch.h"
+#include "script.h"
+
+#include <new>
+#include <cstring>
+#include <algorithm>
+
+// No exception may cross the C boundary, so every entry point catches
+// everything and reports it as a status instead.
+
+struct wumbo_program {
+    wumbo::Program program;
+};
+
+struct wumbo_symbols {
+    wumbo::SymbolTable table;
+};
+
+static void setStatus(int* status, int value) {
+    if (status) *status = value;
+}
+
+extern "C" {
+
+int wumbo_abi_version(void) {
+    return WUMBO_ABI_VERSION;
+}
+
+wumbo_symbols* wumbo_symbols_new(void) {
+    try {
+        return new wumbo_symbols;
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void wumbo_symbols_free(wumbo_symbols* symbols) {
+    delete symbols;
+}
+
+size_t wumbo_symbols_load_plugins(wumbo_symbols* symbols, const char* dir) {
+    if (!symbols || !dir) return 0;
+    try {
+        return symbols->table.loadPlugins(dir);
+    } catch (...) {
+        return 0;
+    }
+}
+
+wumbo_program* wumbo_compile(const char* expr) {
+    return wumbo_compile_with(expr, nullptr);
+}
+
+wumbo_program* wumbo_compile_with(const char* expr, const wumbo_symbols* symbols) {
+    if (!expr) return nullptr;
+    try {
+        auto* p = new wumbo_program{wumbo::compile(expr, symbols ? &symbols->table : nullptr)};
+        if (!wumbo::wellFormed(p->program.postfix)) { delete p; return nullptr; }
+        return p;
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void wumbo_free(wumbo_program* program) {
+    delete program;
+}
+
+double wumbo_run(const wumbo_program* program, int* status) {
+    if (!program) { setStatus(status, WUMBO_ERROR); return NAN; }
+    try {
+        double v = wumbo::run(program->program);
+        setStatus(status, std::isnan(v) ? WUMBO_ERROR : WUMBO_OK);
+        return v;
+    } catch (const std::bad_alloc&) {
+        setStatus(status, WUMBO_OUT_OF_MEMORY);
+    } catch (...) {
+        setStatus(status, WUMBO_ERROR);
+    }
+    return NAN;
+}
+
+double wumbo_evaluate(const char* expr, int* status) {
+    if (!expr) { setStatus(status, WUMBO_ERROR); return NAN; }
+    try {
+        double v = wumbo::evaluate(expr);
+        setStatus(status, std::isnan(v) ? WUMBO_ERROR : WUMBO_OK);
+        return v;
+    } catch (const std::bad_alloc&) {
+        setStatus(status, WUMBO_OUT_OF_MEMORY);
+    } catch (...) {
+        setStatus(status, WUMBO_ERROR);
+    }
+    return NAN;
+}
+
+size_t wumbo_evaluate_text(const char* expr, int digits, char* buf, size_t size, int* status) {
+    std::string text;
+    try {
+        if (!expr || digits < 1) {
+            setStatus(status, WUMBO_ERROR);
+        } else {
+            wumbo::EvalResult r = wumbo::evaluate(expr, wumbo::EvalBudget());
+            setStatus(status, r.status);
+            if (r.status == wumbo::EVAL_OK) text = wumbo::formatValue(r.value, digits);
+        }
+    } catch (const std::bad_alloc&) {
+        setStatus(status, WUMBO_OUT_OF_MEMORY);
+    } catch (...) {
+        setStatus(status, WUMBO_ERROR);
+    }
+    if (buf && size) {
+        size_t n = std::min(text.size(), size - 1);
+        memcpy(buf, text.data(), n);
+        buf[n] = 0;
+    }
+    return text.size();
+}
+
+double wumbo_evaluate_script(const char* source, const wumbo_symbols* symbols, int* status) {
+    if (!source) { setStatus(status, WUMBO_ERROR); return NAN; }
+    try {
+        wumbo::Script script;
+        if (!wumbo::compileScript(source, script, symbols ? &symbols->table : nullptr)) {
+            setStatus(status, WUMBO_ERROR);
+            return NAN;
+        }
+        double v = wumbo::runScript(script);
+        setStatus(status, std::isnan(v) ? WUMBO_ERROR : WUMBO_OK);
+        return v;
+    } catch (const std::bad_alloc&) {
+        setStatus(status, WUMBO_OUT_OF_MEMORY);
+    } catch (...) {
+        setStatus(status, WUMBO_ERROR);
+    }
+    return NAN;
+}
+
+void wumbo_evaluate_array(const char* const* exprs, size_t count, double* results, int* statuses) {
+    wumbo_evaluate_array_with(exprs, count, results, statuses, nullptr);
+}
+
+void wumbo_evaluate_array_with(const char* const* exprs, size_t count, double* results, int* statuses,
+                               const wumbo_symbols* symbols) {
+    const wumbo::SymbolTable* table = symbols ? &symbols->table : nullptr;
+    try {
+        std::vector<std::string> batch(exprs, exprs + count);
+        wumbo::evaluateMany(batch, results, table);
+        if (statuses)
+            for (size_t i = 0; i < count; ++i) statuses[i] = std::isnan(results[i]) ? WUMBO_ERROR : WUMBO_OK;
+    } catch (...) {
+        for (size_t i = 0; i < count; ++i) {
+            results[i] = NAN;
+            setStatus(statuses ? &statuses[i] : nullptr, WUMBO_OUT_OF_MEMORY);
+        }
+    }
+}
+
+void wumbo_evaluate_array_complex(const char* const* exprs, size_t count, double* real, double* imag,
+                                  int* statuses, const wumbo_symbols* symbols) {
+    const wumbo::SymbolTable* table = symbols ? &symbols->table : nullptr;
+    try {
+        std::vector<std::string> batch(exprs, exprs + count);
+        wumbo::evaluateMany(batch, real, table, imag);
+        if (statuses)
+            for (size_t i = 0; i < count; ++i)
+                statuses[i] = std::isnan(real[i]) || std::isnan(imag[i]) ? WUMBO_ERROR : WUMBO_OK;
+    } catch (...) {
+        for (size_t i = 0; i < count; ++i) {
+            real[i] = imag[i] = NAN;
+            setStatus(statuses ? &statuses[i] : nullptr, WUMBO_OUT_OF_MEMORY);
+        }
+    }
+}
+
+}
@@ -0,0 +1,88 @@
+#ifndef WUMBO_H
+#define WUMBO_H
+
+/* C ABI for the Wumbo evaluation engine. Every function is reentrant and may
+ * be called from any thread; a compiled program is immutable once returned and
+ * can be evaluated concurrently. Nothing here allocates memory the caller has
+ * to free except the results of wumbo_compile and wumbo_compile_with, freed
+ * with wumbo_free, and of wumbo_symbols_new, freed with wumbo_symbols_free. */
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#define WUMBO_API __declspec(dllexport)
+#elif defined(__GNUC__)
+#define WUMBO_API __attribute__((visibility("default")))
+#else
+#define WUMBO_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WUMBO_ABI_VERSION 1
+
+/* Values match wumbo::EvalStatus. */
+enum {
+    WUMBO_OK = 0,
+    WUMBO_ERROR = 1,
+    WUMBO_TIMEOUT = 2,
+    WUMBO_OUT_OF_MEMORY = 3,
+    WUMBO_CANCELLED = 4
+};
+
+typedef struct wumbo_program wumbo_program;
+typedef struct wumbo_symbols wumbo_symbols;
+
+WUMBO_API int wumbo_abi_version(void);
+
+/* A table of functions expressions may call, filled from plugin libraries
+ * (see plugin.h). Programs compiled against a table hold on to its functions,
+ * so it must outlive them. Loading returns how many libraries loaded. */
+WUMBO_API wumbo_symbols* wumbo_symbols_new(void);
+WUMBO_API void wumbo_symbols_free(wumbo_symbols* symbols);
+WUMBO_API size_t wumbo_symbols_load_plugins(wumbo_symbols* symbols, const char* dir);
+
+/* Parses expr once for repeated evaluation. Returns NULL if it is not a
+ * well-formed expression or memory runs out. */
+WUMBO_API wumbo_program* wumbo_compile(const char* expr);
+WUMBO_API wumbo_program* wumbo_compile_with(const char* expr, const wumbo_symbols* symbols);
+WUMBO_API void wumbo_free(wumbo_program* program);
+
+/* Runs a compiled program. status, if not NULL, receives a WUMBO_* code; the
+ * result is NaN whenever it is not WUMBO_OK. */
+WUMBO_API double wumbo_run(const wumbo_program* program, int* status);
+
+/* Compiles and runs expr in one step. */
+WUMBO_API double wumbo_evaluate(const char* expr, int* status);
+
+/* Evaluates count expressions into results[0..count). statuses may be NULL. */
+WUMBO_API void wumbo_evaluate_array(const char* const* exprs, size_t count, double* results, int* statuses);
+WUMBO_API void wumbo_evaluate_array_with(const char* const* exprs, size_t count, double* results, int* statuses,
+                                         const wumbo_symbols* symbols);
+
+/* Like wumbo_evaluate_array_with, but complex results (expressions using the
+ * imaginary unit i) keep their imaginary part in imag[0..count) instead of
+ * being NaN off the real axis. symbols may be NULL. */
+WUMBO_API void wumbo_evaluate_array_complex(const char* const* exprs, size_t count, double* real, double* imag,
+                                            int* statuses, const wumbo_symbols* symbols);
+
+/* Evaluates expr and writes its value as text with digits significant digits
+ * into buf, truncated to size bytes including the terminator, returning the
+ * length of the whole text. Exact reals (expressions calling exact) are
+ * worked out to as many digits as asked for; lists, complex numbers and the
+ * rest print as the calculator shows them. */
+WUMBO_API size_t wumbo_evaluate_text(const char* expr, int digits, char* buf, size_t size, int* status);
+
+/* Runs a script: statements separated by new lines or ";", with variables,
+ * if, while, for and functions (def), over real numbers. Its value is that
+ * of its last expression or assignment, or what it returns. symbols may be
+ * NULL. */
+WUMBO_API double wumbo_evaluate_script(const char* source, const wumbo_symbols* symbols, int* status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif